@@ -377,6 +377,58 @@ int printSecs(void *N,
   return 0;
 }
 
+void printFingerprints(parsed_pe *p) {
+  pe_fingerprints fp;
+  GetFingerprints(p, FINGERPRINT_ALL, fp);
+
+  if ((fp.computed & FINGERPRINT_IMPORT_HASH) != 0) {
+    std::cout << "import hash: " << DigestToHex(fp.importHash) << "\n";
+  }
+  if ((fp.computed & FINGERPRINT_EXPHASH) != 0) {
+    std::cout << "exphash: " << DigestToHex(fp.exphash) << "\n";
+  }
+  if ((fp.computed & FINGERPRINT_RICH_HASH) != 0) {
+    std::cout << "Rich header hash: " << DigestToHex(fp.richHash) << "\n";
+  }
+  for (const section_fingerprint &s : fp.sections) {
+    std::cout << "Sec Name: " << s.name << "\n";
+    std::cout << "Sec MD5: " << DigestToHex(s.md5) << "\n";
+    std::cout << "Sec SHA-256: " << DigestToHex(s.sha256) << "\n";
+  }
+}
+
+int printString(void *N, const string_entry &s) {
+  static_cast<void>(N);
+
+  std::cout << "0x" << std::hex << s.fileOffset << " ";
+  if (s.sectionName.empty()) {
+    std::cout << "overlay - ";
+  } else {
+    std::cout << s.sectionName << " 0x" << s.va << " ";
+  }
+  std::cout << (s.encoding == STRING_ASCII ? "A" : "W") << " " << s.value
+            << "\n";
+  return 0;
+}
+
+void printOverlay(parsed_pe *p) {
+  pe_overlay overlay;
+  if (!GetOverlay(p, overlay)) {
+    return;
+  }
+
+  section_entropy e;
+  GetOverlayEntropy(p, entropy_options(), e);
+  std::cout << "Overlay Offset: 0x" << std::hex << overlay.data.offset
+            << "\n";
+  std::cout << "Overlay Size: 0x" << overlay.data.length << "\n";
+  if (overlay.appended.length != 0) {
+    std::cout << "Appended Offset: 0x" << overlay.appended.offset << "\n";
+    std::cout << "Appended Size: 0x" << overlay.appended.length << "\n";
+  }
+  std::cout << "Overlay Entropy: " << std::dec << e.entropy << "\n";
+}
+
 #define DUMP_FIELD(x)           \
   std::cout << "" #x << ": 0x"; \
   std::cout << std::hex << static_cast<std::uint64_t>(p->peHeader.x) << "\n";
@@ -394,7 +446,18 @@ int main(int argc, char *argv[]) {
   if (cmdl[{"-h", "--help"}] || argc <= 1) {
     std::cout << "dump-pe utility from Trail of Bits\n";
     std::cout << "Repository: https://github.com/trailofbits/pe-parse\n\n";
-    std::cout << "Usage:\n\tdump-pe /path/to/executable.exe\n";
+    std::cout << "Usage:\n\tdump-pe [--fingerprints] [--strings] "
+                 "[--overlay] /path/to/executable.exe\n";
+    std::cout << "\n\t-f, --fingerprints\n";
+    std::cout << "\t\talso print the import hash, exphash, Rich header hash\n";
+    std::cout << "\t\tand the MD5 and SHA-256 of each section\n";
+    std::cout << "\n\t-s, --strings\n";
+    std::cout << "\t\talso print the ASCII (A) and UTF-16LE (W) strings of\n";
+    std::cout << "\t\tat least 4 characters in the sections and overlay,\n";
+    std::cout << "\t\twith their file offset, section and VA\n";
+    std::cout << "\n\t-o, --overlay\n";
+    std::cout << "\t\talso print where the data past the last section is,\n";
+    std::cout << "\t\tleaving out the certificate table, and its entropy\n";
     return 0;
   } else if (cmdl[{"-v", "--version"}]) {
     std::cout << "dump-pe (pe-parse) version " << PEPARSE_VERSION << "\n";
@@ -558,6 +621,24 @@ int main(int argc, char *argv[]) {
               << "\n";
     IterRsrc(p, printRsrc, NULL);
 
+    if (cmdl[{"-f", "--fingerprints"}]) {
+      std::cout << "Fingerprints: "
+                << "\n";
+      printFingerprints(p);
+    }
+
+    if (cmdl[{"-s", "--strings"}]) {
+      std::cout << "Strings: "
+                << "\n";
+      IterStrings(p, 4, STRING_ASCII | STRING_UTF16LE, printString, NULL);
+    }
+
+    if (cmdl[{"-o", "--overlay"}]) {
+      std::cout << "Overlay: "
+                << "\n";
+      printOverlay(p);
+    }
+
     DestructParsedPE(p);
 
     return 0;
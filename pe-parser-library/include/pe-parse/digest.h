@@ -0,0 +1,107 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace peparse {
+
+constexpr std::size_t SHA256_DIGEST_LEN = 32;
+typedef std::array<std::uint8_t, SHA256_DIGEST_LEN> sha256_digest;
+
+// Incremental SHA-256. On x86 CPUs with the SHA extensions the compression
+// function runs on them; otherwise, or if accelerated is cleared before the
+// first update, a portable implementation is used.
+struct sha256_ctx {
+  std::uint32_t state[8];
+  std::uint64_t length;
+  std::uint8_t block[64];
+  std::uint32_t blockLen;
+  bool accelerated;
+};
+
+void Sha256Init(sha256_ctx &ctx);
+void Sha256Update(sha256_ctx &ctx, const std::uint8_t *data, std::size_t len);
+void Sha256Final(sha256_ctx &ctx, sha256_digest &out);
+
+// hash a buffer in one call
+sha256_digest Sha256(const std::uint8_t *data, std::size_t len);
+
+// true if this CPU has the SHA extensions used by Sha256Update
+bool Sha256Accelerated();
+
+constexpr std::size_t MD5_DIGEST_LEN = 16;
+typedef std::array<std::uint8_t, MD5_DIGEST_LEN> md5_digest;
+
+// Incremental MD5, for fingerprints such as the import hash that are defined in
+// terms of it. It is not suitable for anything security sensitive.
+struct md5_ctx {
+  std::uint32_t state[4];
+  std::uint64_t length;
+  std::uint8_t block[64];
+  std::uint32_t blockLen;
+};
+
+void Md5Init(md5_ctx &ctx);
+void Md5Update(md5_ctx &ctx, const std::uint8_t *data, std::size_t len);
+void Md5Final(md5_ctx &ctx, md5_digest &out);
+md5_digest Md5(const std::uint8_t *data, std::size_t len);
+
+// XXH64, a fast non-cryptographic 64-bit hash. it is meant for keying caches
+// and hash tables by content, and is easily forged
+std::uint64_t Xxh64(const std::uint8_t *data,
+                    std::size_t len,
+                    std::uint64_t seed = 0);
+
+// the XXH64 of the same data under two seeds, as two Xxh64 calls would
+// return them, but reading the data once. together they make a 128-bit
+// content hash, which is no harder to forge than XXH64 itself but won't
+// collide by chance
+struct xxh64_pair {
+  std::uint64_t first;
+  std::uint64_t second;
+};
+
+xxh64_pair Xxh64Pair(const std::uint8_t *data,
+                     std::size_t len,
+                     std::uint64_t seed1,
+                     std::uint64_t seed2);
+
+// lower-case hex representation of a digest
+template <std::size_t N>
+std::string DigestToHex(const std::array<std::uint8_t, N> &digest) {
+  static const char hex[] = "0123456789abcdef";
+  std::string out(N * 2, '0');
+  for (std::size_t i = 0; i < N; i++) {
+    out[2 * i] = hex[digest[i] >> 4];
+    out[2 * i + 1] = hex[digest[i] & 0xF];
+  }
+  return out;
+}
+
+} // namespace peparse
@@ -0,0 +1,63 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace peparse {
+
+// occurrences of each byte value
+typedef std::array<std::uint64_t, 256> byte_histogram;
+
+// add the bytes of [data, data + len) to h. the counting loop keeps several
+// sub-histograms so that runs of one byte value, such as zero padding, don't
+// serialize on a single counter, and skips through uniform runs a vector at
+// a time
+void AddByteHistogram(byte_histogram &h,
+                      const std::uint8_t *data,
+                      std::size_t len);
+
+// Shannon entropy of the counted bytes, in bits per byte (0 to 8)
+double ShannonEntropy(const byte_histogram &h);
+
+// Pearson's chi-square statistic of the counted bytes against a uniform
+// distribution (255 degrees of freedom). encrypted or compressed data stays
+// close to 255; text, code and padding are orders of magnitude above it
+double ChiSquare(const byte_histogram &h);
+
+// the Shannon entropy of each windowSize-byte window of [data, data + len),
+// starting every step bytes. a trailing partial window is not reported, so
+// the result is empty if len < windowSize. overlapping windows are updated
+// incrementally, at a cost proportional to step rather than windowSize
+std::vector<double> EntropyProfile(const std::uint8_t *data,
+                                   std::size_t len,
+                                   std::uint32_t windowSize,
+                                   std::uint32_t step);
+
+} // namespace peparse
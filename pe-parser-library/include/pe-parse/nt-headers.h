@@ -445,6 +445,21 @@ struct import_dir_entry {
   std::uint32_t AddressRVA;
 };
 
+// Attributes bit set when the descriptor holds RVAs. Descriptors from
+// before VC7 leave it clear and store VAs instead.
+constexpr std::uint32_t DELAY_IMPORT_RVA_BASED = 0x1;
+
+struct delay_import_dir_entry {
+  std::uint32_t Attributes;
+  std::uint32_t NameRVA;
+  std::uint32_t ModuleHandleRVA;
+  std::uint32_t AddressRVA;
+  std::uint32_t NameTableRVA;
+  std::uint32_t BoundAddressRVA;
+  std::uint32_t UnloadInformationRVA;
+  std::uint32_t TimeStamp;
+};
+
 struct export_dir_table {
   std::uint32_t ExportFlags;
   std::uint32_t TimeDateStamp;
@@ -495,6 +510,24 @@ struct reloc_block {
   std::uint32_t BlockSize;
 };
 
+struct image_tls_directory_32 {
+  std::uint32_t StartAddressOfRawData;
+  std::uint32_t EndAddressOfRawData;
+  std::uint32_t AddressOfIndex;
+  std::uint32_t AddressOfCallBacks;
+  std::uint32_t SizeOfZeroFill;
+  std::uint32_t Characteristics;
+};
+
+struct image_tls_directory_64 {
+  std::uint64_t StartAddressOfRawData;
+  std::uint64_t EndAddressOfRawData;
+  std::uint64_t AddressOfIndex;
+  std::uint64_t AddressOfCallBacks;
+  std::uint32_t SizeOfZeroFill;
+  std::uint32_t Characteristics;
+};
+
 struct image_load_config_code_integrity {
   std::uint16_t Flags;
   std::uint16_t Catalog;
@@ -591,4 +624,36 @@ struct image_load_config_64 {
   std::uint64_t EnclaveConfigurationPointer;
   std::uint64_t VolatileMetadataPointer;
 };
+
+// GuardFlags bits in the load config
+constexpr std::uint32_t IMAGE_GUARD_CF_INSTRUMENTED = 0x00000100;
+constexpr std::uint32_t IMAGE_GUARD_CFW_INSTRUMENTED = 0x00000200;
+constexpr std::uint32_t IMAGE_GUARD_CF_FUNCTION_TABLE_PRESENT = 0x00000400;
+constexpr std::uint32_t IMAGE_GUARD_SECURITY_COOKIE_UNUSED = 0x00000800;
+constexpr std::uint32_t IMAGE_GUARD_PROTECT_DELAYLOAD_IAT = 0x00001000;
+constexpr std::uint32_t IMAGE_GUARD_DELAYLOAD_IAT_IN_ITS_OWN_SECTION = 0x00002000;
+constexpr std::uint32_t IMAGE_GUARD_CF_EXPORT_SUPPRESSION_INFO_PRESENT = 0x00004000;
+constexpr std::uint32_t IMAGE_GUARD_CF_ENABLE_EXPORT_SUPPRESSION = 0x00008000;
+constexpr std::uint32_t IMAGE_GUARD_CF_LONGJUMP_TABLE_PRESENT = 0x00010000;
+// number of metadata bytes that follow each RVA in the guard tables
+constexpr std::uint32_t IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK = 0xF0000000;
+constexpr std::uint32_t IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT = 28;
+
+// Flags in the first metadata byte of a GuardCF function table entry
+constexpr std::uint8_t IMAGE_GUARD_FLAG_FID_SUPPRESSED = 0x01;
+constexpr std::uint8_t IMAGE_GUARD_FLAG_EXPORT_SUPPRESSED = 0x02;
+
+// header of each entry in the attribute certificate table
+struct win_certificate {
+  std::uint32_t dwLength;
+  std::uint16_t wRevision;
+  std::uint16_t wCertificateType;
+};
+
+constexpr std::uint16_t WIN_CERT_REVISION_1_0 = 0x0100;
+constexpr std::uint16_t WIN_CERT_REVISION_2_0 = 0x0200;
+constexpr std::uint16_t WIN_CERT_TYPE_X509 = 0x0001;
+constexpr std::uint16_t WIN_CERT_TYPE_PKCS_SIGNED_DATA = 0x0002;
+constexpr std::uint16_t WIN_CERT_TYPE_RESERVED_1 = 0x0003;
+constexpr std::uint16_t WIN_CERT_TYPE_TS_STACK_SIGNED = 0x0004;
 } // namespace peparse
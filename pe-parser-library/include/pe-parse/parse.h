@@ -27,18 +27,24 @@ THE SOFTWARE.
 #include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
+#include "digest.h"
+#include "entropy.h"
 #include "nt-headers.h"
+#include "string_scan.h"
 #include "to_string.h"
 
 #ifdef _MSC_VER
 #define __typeof__(x) std::remove_reference<decltype(x)>::type
 #endif
 
+// Records an error code and where it was raised. Only the address of
+// __func__ and the line are stored; GetPEErrLoc formats them on demand, so
+// failing on malformed input does not allocate.
 #define PE_ERR(x)               \
   err = static_cast<pe_err>(x); \
-  err_loc.assign(__func__);     \
-  err_loc += ":" + to_string<std::uint32_t>(__LINE__, std::dec);
+  err_loc = error_location{__func__, __LINE__};
 
 #define READ_WORD(b, o, inst, member)                                          \
   if (!readWord(b,                                                             \
@@ -82,12 +88,19 @@ namespace peparse {
 typedef std::uint32_t RVA;
 typedef std::uint64_t VA;
 
+struct error_location {
+  const char *func;
+  std::uint32_t line;
+};
+
 struct buffer_detail;
 
 typedef struct _bounded_buffer {
   std::uint8_t *buf;
   std::uint32_t bufLen;
   bool copy;
+  // Unused: byte order is now chosen per read (see byte_order below). Kept so
+  // that code which initializes bounded_buffer by hand still compiles.
   bool swapBytes;
   buffer_detail *detail;
 } bounded_buffer;
@@ -150,8 +163,48 @@ enum pe_err {
   PEERR_BUFFER = 10,
   PEERR_ADDRESS = 11,
   PEERR_SIZE = 12,
+  PEERR_PATTERN = 13,
+  PEERR_WRITE = 14,
 };
 
+/*
+ * Byte order of the value being read. PE images are always little-endian, so
+ * the plain readWord/readDword/readQword/readChar16 read little-endian data
+ * and compile down to unaligned loads on little-endian hosts. The big-endian
+ * instantiations are for tools that read other formats through the same
+ * bounded_buffer API.
+ */
+enum class byte_order { little, big };
+
+template <byte_order Order>
+bool readWord(bounded_buffer *b, std::uint32_t offset, std::uint16_t &out);
+template <byte_order Order>
+bool readDword(bounded_buffer *b, std::uint32_t offset, std::uint32_t &out);
+template <byte_order Order>
+bool readQword(bounded_buffer *b, std::uint32_t offset, std::uint64_t &out);
+template <byte_order Order>
+bool readChar16(bounded_buffer *b, std::uint32_t offset, char16_t &out);
+
+extern template bool readWord<byte_order::little>(bounded_buffer *,
+                                                  std::uint32_t,
+                                                  std::uint16_t &);
+extern template bool
+readWord<byte_order::big>(bounded_buffer *, std::uint32_t, std::uint16_t &);
+extern template bool readDword<byte_order::little>(bounded_buffer *,
+                                                   std::uint32_t,
+                                                   std::uint32_t &);
+extern template bool
+readDword<byte_order::big>(bounded_buffer *, std::uint32_t, std::uint32_t &);
+extern template bool readQword<byte_order::little>(bounded_buffer *,
+                                                   std::uint32_t,
+                                                   std::uint64_t &);
+extern template bool
+readQword<byte_order::big>(bounded_buffer *, std::uint32_t, std::uint64_t &);
+extern template bool
+readChar16<byte_order::little>(bounded_buffer *, std::uint32_t, char16_t &);
+extern template bool
+readChar16<byte_order::big>(bounded_buffer *, std::uint32_t, char16_t &);
+
 bool readByte(bounded_buffer *b, std::uint32_t offset, std::uint8_t &out);
 bool readWord(bounded_buffer *b, std::uint32_t offset, std::uint16_t &out);
 bool readDword(bounded_buffer *b, std::uint32_t offset, std::uint32_t &out);
@@ -211,13 +264,376 @@ void IterRich(parsed_pe *pe, iterRich cb, void *cbd);
 typedef int (*iterRsrc)(void *, const resource &);
 void IterRsrc(parsed_pe *pe, iterRsrc cb, void *cbd);
 
-// iterate over the imports by RVA and string
+// Matches any language in FindRsrc
+constexpr std::uint32_t RSRC_LANG_ANY = 0xFFFFFFFF;
+
+// find a resource by type, name and language ID, without walking every
+// resource. only ID directory entries match; look named ones up by string.
+// With RSRC_LANG_ANY, the resource with the lowest language ID is returned.
+// Returns nullptr if there is no match; the resource is owned by pe.
+const resource *FindRsrc(parsed_pe *pe,
+                         std::uint32_t type,
+                         std::uint32_t name,
+                         std::uint32_t lang = RSRC_LANG_ANY);
+
+// find a resource by type and name where either is a string, as for
+// custom resource types. these compare the directory strings, decoding
+// them as they go, so they walk the resources of the type, or every
+// resource for a type string
+const resource *FindRsrc(parsed_pe *pe,
+                         std::uint32_t type,
+                         const std::string &name,
+                         std::uint32_t lang = RSRC_LANG_ANY);
+const resource *FindRsrc(parsed_pe *pe,
+                         const std::string &type,
+                         std::uint32_t name,
+                         std::uint32_t lang = RSRC_LANG_ANY);
+const resource *FindRsrc(parsed_pe *pe,
+                         const std::string &type,
+                         const std::string &name,
+                         std::uint32_t lang = RSRC_LANG_ANY);
+
+// iterate over the imports by RVA and string, including delay-load imports
 typedef int (*iterVAStr)(void *,
                          const VA &,
                          const std::string &,
                          const std::string &);
 void IterImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd);
 
+// an import as reported by IterImpRefs. addr is the VA of its IAT slot.
+// imports by ordinal have a symbolName of the form ORDINAL_<module>_<n>
+struct import_ref {
+  VA addr;
+  std::string moduleName;
+  std::string symbolName;
+  bool byOrdinal;
+  std::uint16_t ordinal; // only set if byOrdinal
+  bool delayLoad; // from the delay-load import directory
+};
+
+// iterate over the imports as import_ref, in import table order
+typedef int (*iterImpRef)(void *, const import_ref &);
+void IterImpRefs(parsed_pe *pe, iterImpRef cb, void *cbd);
+
+// find the import whose IAT slot is at slot, e.g. the target of an
+// indirect call. the index is built on first use; the result stays valid
+// until the parsed_pe is destroyed
+const import_ref *FindImportByIAT(parsed_pe *pe, VA slot);
+
+// look up many IAT slots at once; out[i] is the import for slots[i] or
+// null. returns the number found
+std::size_t FindImportsByIAT(parsed_pe *pe,
+                             const std::vector<VA> &slots,
+                             std::vector<const import_ref *> &out);
+
+// a function from the exception directory (.pdata). end is exclusive.
+// unwindData is the RVA of the unwind information, or on ARM and ARM64 the
+// packed unwind data if either of its low two bits is set
+struct runtime_function {
+  RVA begin;
+  RVA end;
+  std::uint32_t unwindData;
+};
+
+// find the function containing rva with a binary search over the exception
+// directory, which is parsed on first use (x64, ARM64 and ARMNT images)
+const runtime_function *FindFunctionForRva(parsed_pe *pe, RVA rva);
+
+// look up many RVAs at once; out[i] is the function containing rvas[i] or
+// null. an ascending list is resolved in a single pass over the table.
+// returns the number found
+std::size_t FindFunctionsForRvas(parsed_pe *pe,
+                                 const std::vector<RVA> &rvas,
+                                 std::vector<const runtime_function *> &out);
+
+// iterate over the functions in the exception directory, sorted by begin
+typedef int (*iterFunc)(void *, const runtime_function &);
+void IterFunctions(parsed_pe *pe, iterFunc cb, void *cbd);
+
+// where a symbol_entry came from, in order of precedence when several
+// sources name the same address
+enum class symbol_source {
+  exports,
+  coff,
+  entry,
+  function, // a .pdata function with no name from any other source
+};
+
+struct symbol_entry {
+  VA addr;
+  VA size; // 0 if unknown
+  std::string name; // empty for unnamed .pdata functions
+  symbol_source source;
+};
+
+// find the nearest symbol at or below va among the exports, COFF symbols,
+// entry point and .pdata functions, and va's offset from it. a symbol only
+// covers addresses up to its end if its size is known, otherwise up to the
+// end of its section. the index is built once, on first use, and may then
+// be queried from several threads
+const symbol_entry *Symbolize(parsed_pe *pe, VA va, VA &offset);
+
+// symbolize many addresses; out[i] and offsets[i] are the result for
+// vas[i]. an ascending list is resolved in a single pass. returns the
+// number found
+std::size_t SymbolizeSorted(parsed_pe *pe,
+                            const std::vector<VA> &vas,
+                            std::vector<const symbol_entry *> &out,
+                            std::vector<VA> &offsets);
+
+// get the load config directory, decoded on first use. PE32 images are
+// widened to the PE32+ layout. fields past the structure's own Size are
+// zero. returns false if the image has no load config
+bool GetLoadConfig(parsed_pe *pe, image_load_config_64 &out);
+
+// get the VA of the /GS security cookie named by the load config
+bool GetSecurityCookie(parsed_pe *pe, VA &cookie);
+
+// true if rva is a valid indirect call target under Control Flow Guard: it
+// is in the GuardCF function table and not marked
+// IMAGE_GUARD_FLAG_FID_SUPPRESSED. the table is decoded into a sorted array
+// on first use, so each query is a binary search
+bool IsCFGTarget(parsed_pe *pe, RVA rva);
+
+// find rva in the GuardCF function table, including suppressed entries, and
+// get its IMAGE_GUARD_FLAG_* metadata (zero if the table has none)
+bool FindGuardCFFunction(parsed_pe *pe, RVA rva, std::uint8_t &flags);
+
+// iterate over the GuardCF function table, sorted by RVA
+typedef int (*iterGuardCF)(void *, const RVA &, std::uint8_t);
+void IterGuardCFFunctions(parsed_pe *pe, iterGuardCF cb, void *cbd);
+
+// true if rva is in the SafeSEH handler table of a PE32 image
+bool IsSEHandler(parsed_pe *pe, RVA rva);
+
+// iterate over the SafeSEH handler table, sorted by RVA
+typedef int (*iterRVA)(void *, const RVA &);
+void IterSEHandlers(parsed_pe *pe, iterRVA cb, void *cbd);
+
+// get the TLS directory. it is decoded on every call rather than at parse
+// time; PE32 images are widened to the PE32+ layout. returns false if the
+// image has no TLS directory
+bool GetTlsDirectory(parsed_pe *pe, image_tls_directory_64 &out);
+
+// iterate over the TLS callback VAs, in array order, up to the terminating
+// null pointer, the end of the section holding the array or
+// TLS_MAX_CALLBACKS entries, whichever comes first. the array is read in
+// place, so this does not allocate
+constexpr std::uint32_t TLS_MAX_CALLBACKS = 4096;
+typedef int (*iterVA)(void *, const VA &);
+void IterTlsCallbacks(parsed_pe *pe, iterVA cb, void *cbd);
+
+// compute the Authenticode SHA-256 image digest: the whole file except the
+// optional header CheckSum, the DIR_SECURITY data directory entry and the
+// certificate table, with the section contents hashed in file order. the
+// file is hashed in place in a single pass. returns false if the headers
+// cannot be located
+bool GetAuthenticodeDigest(parsed_pe *pe, sha256_digest &out);
+
+// an entry of the attribute certificate table. data points at the
+// certificate itself (bCertificate), inside the file buffer, and stays valid
+// for as long as pe does
+struct certificate_entry {
+  std::uint32_t offset; // file offset of the WIN_CERTIFICATE header
+  std::uint16_t revision;
+  std::uint16_t type;
+  const std::uint8_t *data;
+  std::uint32_t length;
+};
+
+// iterate over the attribute certificate table, which DIR_SECURITY locates
+// by file offset. entries are returned as views into the file buffer, with
+// nothing copied or decoded. the walk stops at the first entry that is
+// shorter than its header or runs past the table or the end of the file
+typedef int (*iterCert)(void *, const certificate_entry &);
+void IterCertificates(parsed_pe *pe, iterCert cb, void *cbd);
+
+// recompute the optional header CheckSum the way the loader and imagehlp
+// do: the 16-bit one's complement sum of the file, with the CheckSum field
+// taken as zero, plus the file size. compare it with the stored CheckSum to
+// detect modified images. the sum is vectorized with AVX2 or SSE2 when the
+// CPU has them. returns 0 for a null pe
+std::uint32_t ComputePEChecksum(parsed_pe *pe);
+
+// fingerprints GetFingerprints can compute; or them together to request
+// several at once
+constexpr std::uint32_t FINGERPRINT_IMPORT_HASH = 0x01;
+constexpr std::uint32_t FINGERPRINT_EXPHASH = 0x02;
+constexpr std::uint32_t FINGERPRINT_RICH_HASH = 0x04;
+constexpr std::uint32_t FINGERPRINT_SECTION_MD5 = 0x08;
+constexpr std::uint32_t FINGERPRINT_SECTION_SHA256 = 0x10;
+constexpr std::uint32_t FINGERPRINT_ALL = 0x1F;
+
+struct section_fingerprint {
+  std::string name;
+  md5_digest md5;
+  sha256_digest sha256;
+};
+
+// computed holds the FINGERPRINT_* bits of the fingerprints that were
+// requested and that the image has: there is no import hash without imports,
+// for example. fields whose bit is clear are left zeroed
+struct pe_fingerprints {
+  std::uint32_t computed;
+  md5_digest importHash;
+  md5_digest exphash;
+  md5_digest richHash;
+  std::vector<section_fingerprint> sections;
+};
+
+// compute the requested fingerprints in one pass over the parsed imports,
+// exports and Rich header and the raw section data, hashing names and data
+// in place:
+//  - import hash: the MD5 of "module.function" for each non-delay-loaded
+//    import, lowercased and comma separated, with the module's .dll, .ocx or
+//    .sys extension removed and ordinal imports named "ordN", or by name for
+//    the fixed Winsock ordinals of ws2_32/wsock32. this is not pefile's
+//    imphash, which also names the ordinals of oleaut32 and so differs for
+//    the VB6, Delphi and COM binaries that import from it by ordinal, but
+//    is otherwise computed the same way
+//  - exphash: the MD5 of the exported names, lowercased and comma separated
+//    in the sorted order of the export name table
+//  - rich hash: the MD5 of the decoded Rich header, from "DanS" up to but
+//    not including "Rich", as pefile and YARA compute it
+//  - the MD5 and SHA-256 of each section's raw data, in section table order
+// returns false if none of the requested fingerprints could be computed
+bool GetFingerprints(parsed_pe *pe, std::uint32_t which, pe_fingerprints &out);
+
+struct entropy_options {
+  // sections of at least this many bytes also get an entropy profile of
+  // windowSize-byte windows every windowStep bytes; 0 disables profiles
+  std::size_t profileThreshold = 64 * 1024;
+  std::uint32_t windowSize = 4096;
+  std::uint32_t windowStep = 4096;
+  // sections of at least parallelThreshold bytes are counted by up to this
+  // many threads, each taking a slice of the section
+  unsigned threads = 1;
+  std::size_t parallelThreshold = 8 * 1024 * 1024;
+};
+
+struct section_entropy {
+  std::string name;
+  byte_histogram histogram;
+  double entropy;
+  double chiSquare;
+  std::vector<double> profile;
+};
+
+// compute the byte histogram, Shannon entropy and chi-square of each
+// section's raw data, in section table order, counting the data in place.
+// packed or encrypted sections show up as an entropy close to 8 and a
+// chi-square close to 255
+bool GetSectionEntropy(parsed_pe *pe,
+                       const entropy_options &opts,
+                       std::vector<section_entropy> &out);
+
+// a stretch of the file, viewed in place in the file buffer
+struct file_span {
+  std::uint64_t offset;
+  const std::uint8_t *data;
+  std::size_t length;
+};
+
+// the overlay: whatever the file holds past the headers and the last
+// section's raw data, which the loader does not map, less the attribute
+// certificate table that DIR_SECURITY places there. data is the part in
+// front of the table, or all of it if there is no table; appended is the
+// part behind the table, such as a payload added to a file after it was
+// signed. when nothing is in front of the table but its alignment padding,
+// the part behind it is reported as data
+struct pe_overlay {
+  file_span data;
+  file_span appended;
+};
+
+// locate the overlay from the section table and DIR_SECURITY. this only
+// reads the headers: the overlay itself is left untouched, so a file
+// mapping is not paged in until the spans are read. returns false if the
+// file has no overlay
+bool GetOverlay(parsed_pe *pe, pe_overlay &out);
+
+// compute the byte histogram, Shannon entropy and chi-square of both parts
+// of the overlay, as GetSectionEntropy does for sections. the profile
+// covers data and then appended, without windows spanning the two. name is
+// left empty. returns false if the file has no overlay
+bool GetOverlayEntropy(parsed_pe *pe,
+                       const entropy_options &opts,
+                       section_entropy &out);
+
+struct string_entry {
+  // STRING_ASCII or STRING_UTF16LE
+  std::uint32_t encoding;
+  // the section the string is in; empty for a string in the overlay, which
+  // isn't mapped and so has no RVA or VA either
+  std::string sectionName;
+  RVA rva;
+  VA va;
+  std::uint64_t fileOffset;
+  std::string value;
+};
+
+// iterate over the strings of at least minLength characters, in the given
+// STRING_* encodings, in each section's raw data in section table order and
+// then in the two parts of the overlay that GetOverlay finds, which leave
+// out the certificate table. see FindStrings for what makes a string
+typedef int (*iterString)(void *, const string_entry &);
+void IterStrings(parsed_pe *pe,
+                 std::size_t minLength,
+                 std::uint32_t encodings,
+                 iterString cb,
+                 void *cbd);
+
+// a compiled set of byte signatures, such as PEiD's packer signatures. a set
+// is not modified once compiled, so any number of threads can scan with the
+// same set at once
+struct signature_set;
+
+// compile hex patterns such as "60 E8 ?? ?? ?? ?? 5D 81 ED": pairs of hex
+// digits, optionally separated by spaces, where either digit may be a ?
+// wildcard. each pattern needs at least one byte without wildcards. returns
+// nullptr with PEERR_PATTERN if a pattern is malformed
+signature_set *CompileSignatures(const std::vector<std::string> &patterns);
+void DestructSignatureSet(signature_set *set);
+
+struct signature_hit {
+  // index of the pattern in the list the set was compiled from
+  std::size_t pattern;
+  std::size_t offset;
+};
+
+// find every occurrence of each pattern in [data, data + len), in order of
+// offset. candidates are found with an Aho-Corasick automaton over a
+// literal stretch of each pattern and then checked in full
+void FindSignatures(const signature_set *set,
+                    const std::uint8_t *data,
+                    std::size_t len,
+                    std::vector<signature_hit> &out);
+
+struct signature_match {
+  std::size_t pattern;
+  std::string sectionName;
+  VA va;
+  std::uint64_t fileOffset;
+};
+
+// iterate over the signature matches in the raw data of the named sections,
+// or of every section if sections is empty, in section table order
+typedef int (*iterSignature)(void *, const signature_match &);
+void IterSectionSignatures(parsed_pe *pe,
+                           const signature_set *set,
+                           const std::vector<std::string> &sections,
+                           iterSignature cb,
+                           void *cbd);
+
+// iterate over the signature matches in the window bytes of raw data
+// starting at the entry point. signatures that must match at the entry
+// point itself are the ones whose va is the entry point's
+void IterEntryPointSignatures(parsed_pe *pe,
+                              const signature_set *set,
+                              std::uint32_t window,
+                              iterSignature cb,
+                              void *cbd);
+
 // iterate over relocations in the PE file
 typedef int (*iterReloc)(void *, const VA &, const reloc_type &);
 void IterRelocs(parsed_pe *pe, iterReloc cb, void *cbd);
@@ -244,7 +660,8 @@ typedef int (*iterExp)(void *,
 void IterExpVA(parsed_pe *pe, iterExp cb, void *cbd);
 
 // iterate over the exports, including forwarded exports
-// export ordinal is also provided as the third argument.
+// the export's index in the EAT is also provided as the third argument;
+// this is its ordinal less OrdinalBase, unlike export_ref::ordinal.
 // VA will be zero if the current export is forwarded,
 // in this case, the last argument (forward string) will be non-empty
 typedef int (*iterExpFull)(void *,
@@ -255,6 +672,32 @@ typedef int (*iterExpFull)(void *,
                            const std::string &);
 void IterExpFull(parsed_pe *pe, iterExpFull cb, void *cbd);
 
+// a single export, as returned by FindExportByName and FindExportByOrdinal.
+// addr is zero and forwardName is set if the export is forwarded.
+struct export_ref {
+  VA addr;
+  // the biased ordinal, OrdinalBase + EAT index, that imports and the
+  // loader use; IterExpFull reports the unbiased EAT index instead
+  std::uint32_t ordinal;
+  std::string symbolName;
+  std::string moduleName;
+  std::string forwardName;
+};
+
+// iterate over all exports as export_ref, in EAT order
+typedef int (*iterExpRef)(void *, const export_ref &);
+void IterExpRefs(parsed_pe *pe, iterExpRef cb, void *cbd);
+
+// find an export by name with a binary search over the export name table
+bool FindExportByName(parsed_pe *pe,
+                      const std::string &name,
+                      export_ref &out);
+
+// find an export by ordinal, reading its EAT entry directly
+bool FindExportByOrdinal(parsed_pe *pe,
+                         std::uint32_t ordinal,
+                         export_ref &out);
+
 // iterate over sections
 typedef int (*iterSec)(void *,
                        const VA &,
@@ -279,4 +722,67 @@ const char *GetSubsystemAsString(parsed_pe *pe);
 bool GetDataDirectoryEntry(parsed_pe *pe,
                            data_directory_kind dirnum,
                            std::vector<std::uint8_t> &raw_entry);
+
+struct section_summary {
+  std::string name;
+  VA base;
+  image_section_header header;
+};
+
+// the parts of a parse that describe a file without pointing into it: the
+// headers, the section table, the imports and exports as IterImpRefs and
+// IterExpRefs report them, and the resource directory. resources have their
+// ids, names, RVA and size, but their buf is nullptr
+struct pe_summary {
+  pe_header header;
+  std::vector<section_summary> sections;
+  std::vector<import_ref> imports;
+  std::vector<export_ref> exports;
+  std::vector<resource> resources;
+};
+
+bool SummarizePE(parsed_pe *pe, pe_summary &out);
+
+// an on-disk store of pe_summary records, named by the XXH64 of the file
+// they were made from, so that files seen before are not parsed again. a
+// record is only used if the file's length and a second XXH64 under
+// another seed match too, so files don't share a record by chance. the
+// hashes are not cryptographic, though: a file crafted to collide with
+// another under both seeds gets its summary, so don't share a cache
+// between files from sources that would do that. records are trusted
+// otherwise: anyone who can write to dir can make the cache return any
+// summary. records are files in dir, which must exist; the least recently
+// used ones are deleted to keep their total size within maxBytes. the
+// recency order is kept in an index file that CloseParseCache writes, and
+// records of a cache that wasn't closed are not tracked, and so not
+// evicted, afterwards. a cache can be shared by threads, but not by
+// processes. looking a file up hashes all of it once, whereas a parse only
+// reads its headers and tables, so the cache pays off for files that are
+// small for what they hold rather than for large installers
+struct parse_cache;
+
+parse_cache *OpenParseCache(const char *dir, std::uint64_t maxBytes);
+void CloseParseCache(parse_cache *cache);
+
+struct parse_cache_stats {
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t evictions;
+  std::uint64_t entries;
+  std::uint64_t bytes;
+};
+
+parse_cache_stats GetParseCacheStats(parse_cache *cache);
+
+// summarize the file in [data, data + len), or the file at filePath, from
+// the cache if it has it, and otherwise by parsing it and storing the
+// summary. files that don't parse are cached too, and fail again with the
+// same error. cache may be nullptr, in which case the file is always parsed
+bool GetPESummary(parse_cache *cache,
+                  std::uint8_t *data,
+                  std::uint32_t len,
+                  pe_summary &out);
+bool GetPESummaryFromFile(parse_cache *cache,
+                          const char *filePath,
+                          pe_summary &out);
 } // namespace peparse
@@ -0,0 +1,110 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "parse.h"
+
+namespace peparse {
+
+// A set of DLLs (e.g. a copy of a Windows system directory) whose export
+// tables are indexed once and then shared by every lookup. Modules are
+// parsed lazily, the first time a query reaches them.
+struct export_db;
+
+enum class resolve_status {
+  ok,
+  missing_module, // no module with that name was added, or it failed to parse
+  missing_export, // the module has no such export
+  loop, // the forwarder chain revisits an export or is too long
+};
+
+struct resolved_export {
+  resolve_status status;
+  // on success, the module and export the chain ended in; otherwise the
+  // link that could not be resolved
+  std::string moduleName;
+  std::string symbolName;
+  std::uint32_t ordinal;
+  VA addr; // relative to the module's preferred image base
+  std::uint32_t hops; // number of forwarders followed
+};
+
+export_db *CreateExportDb();
+void DestroyExportDb(export_db *db);
+
+// register a DLL under its file name. if a module with the same name was
+// already added, the earlier one is kept, as in a DLL search order
+bool ExportDbAddFile(export_db *db, const char *path);
+
+// register every .dll in a directory (not recursively), returning the
+// number of them that ExportDbAddFile accepted
+std::size_t ExportDbAddDirectory(export_db *db, const char *path);
+
+// resolve an export of a module, following forwarders. symbol is either
+// an export name or "#<ordinal>"
+bool ResolveExport(export_db *db,
+                   const std::string &module,
+                   const std::string &symbol,
+                   resolved_export &out);
+
+// resolve a forwarder string as found in exportent::forwardName, e.g.
+// "NTDLL.RtlAllocateHeap" or "NTDLL.#12"
+bool ResolveForwarder(export_db *db,
+                      const std::string &forwardName,
+                      resolved_export &out);
+
+// resolve many forwarder strings; out[i] holds the result for
+// forwardNames[i]. returns the number that resolved
+std::size_t ResolveForwarders(export_db *db,
+                              const std::vector<std::string> &forwardNames,
+                              std::vector<resolved_export> &out);
+
+struct import_binding {
+  VA iatAddr;
+  std::string moduleName; // as imported
+  std::string symbolName; // as imported
+  resolved_export target;
+};
+
+// bind every import of pe to the export it resolves to. out[i] describes
+// the i-th import reported by IterImpRefs; returns the number that bound
+std::size_t ResolveImports(export_db *db,
+                           parsed_pe *pe,
+                           std::vector<import_binding> &out);
+
+// write the export indexes parsed so far to a file. fails with PEERR_OPEN
+// if the file can't be created and PEERR_WRITE if writing it fails
+bool SaveExportDb(export_db *db, const char *path);
+
+// read indexes written by SaveExportDb. a cached module is only used while
+// its file still has the size and modification time it was indexed with;
+// otherwise it is parsed again
+bool LoadExportDb(export_db *db, const char *path);
+
+} // namespace peparse
@@ -0,0 +1,58 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace peparse {
+
+// encodings FindStrings looks for; or them together to find both
+constexpr std::uint32_t STRING_ASCII = 0x1;
+constexpr std::uint32_t STRING_UTF16LE = 0x2;
+
+struct string_match {
+  // byte offset of the first character
+  std::size_t offset;
+  // length in characters; a UTF-16LE match spans twice as many bytes
+  std::size_t length;
+  // STRING_ASCII or STRING_UTF16LE
+  std::uint32_t encoding;
+};
+
+// find the runs of at least minLength printable ASCII characters (0x20 to
+// 0x7E, and tab) in [data, data + len), stored as bytes or as UTF-16LE code
+// units, which may start at odd offsets. the bytes are classified 64 at a
+// time with SSE2 where available. out is replaced with the matches, in
+// order of offset
+void FindStrings(const std::uint8_t *data,
+                 std::size_t len,
+                 std::size_t minLength,
+                 std::uint32_t encodings,
+                 std::vector<string_match> &out);
+
+} // namespace peparse
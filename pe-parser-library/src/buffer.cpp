@@ -68,12 +68,43 @@ inline uint64_t byteSwapUint64(std::uint64_t val) {
 #endif
 }
 
+inline std::uint16_t byteSwap(std::uint16_t val) {
+  return byteSwapUint16(val);
+}
+
+inline std::uint32_t byteSwap(std::uint32_t val) {
+  return byteSwapUint32(val);
+}
+
+inline std::uint64_t byteSwap(std::uint64_t val) {
+  return byteSwapUint64(val);
+}
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr peparse::byte_order hostByteOrder = peparse::byte_order::big;
+#else
+constexpr peparse::byte_order hostByteOrder = peparse::byte_order::little;
+#endif
+
+// Loads an unaligned T stored in byte order Order. When Order matches the
+// host this is a single load; otherwise it is a load and a byte swap.
+template <peparse::byte_order Order, typename T>
+inline T loadUnaligned(const std::uint8_t *p) {
+  T tmp;
+  memcpy(&tmp, p, sizeof(T));
+  if constexpr (Order != hostByteOrder) {
+    tmp = byteSwap(tmp);
+  }
+  return tmp;
+}
+
 } // anonymous namespace
 
 namespace peparse {
 
 extern std::uint32_t err;
-extern std::string err_loc;
+extern error_location err_loc;
 
 struct buffer_detail {
 #ifdef _WIN32
@@ -101,6 +132,7 @@ bool readByte(bounded_buffer *b, std::uint32_t offset, std::uint8_t &out) {
   return true;
 }
 
+template <byte_order Order>
 bool readWord(bounded_buffer *b, std::uint32_t offset, std::uint16_t &out) {
   if (b == nullptr) {
     PE_ERR(PEERR_BUFFER);
@@ -112,17 +144,12 @@ bool readWord(bounded_buffer *b, std::uint32_t offset, std::uint16_t &out) {
     return false;
   }
 
-  std::uint16_t tmp;
-  memcpy(&tmp, (b->buf + offset), sizeof(std::uint16_t));
-  if (b->swapBytes) {
-    out = byteSwapUint16(tmp);
-  } else {
-    out = tmp;
-  }
+  out = loadUnaligned<Order, std::uint16_t>(b->buf + offset);
 
   return true;
 }
 
+template <byte_order Order>
 bool readDword(bounded_buffer *b, std::uint32_t offset, std::uint32_t &out) {
   if (b == nullptr) {
     PE_ERR(PEERR_BUFFER);
@@ -134,17 +161,12 @@ bool readDword(bounded_buffer *b, std::uint32_t offset, std::uint32_t &out) {
     return false;
   }
 
-  std::uint32_t tmp;
-  memcpy(&tmp, (b->buf + offset), sizeof(std::uint32_t));
-  if (b->swapBytes) {
-    out = byteSwapUint32(tmp);
-  } else {
-    out = tmp;
-  }
+  out = loadUnaligned<Order, std::uint32_t>(b->buf + offset);
 
   return true;
 }
 
+template <byte_order Order>
 bool readQword(bounded_buffer *b, std::uint32_t offset, std::uint64_t &out) {
   if (b == nullptr) {
     PE_ERR(PEERR_BUFFER);
@@ -156,17 +178,12 @@ bool readQword(bounded_buffer *b, std::uint32_t offset, std::uint64_t &out) {
     return false;
   }
 
-  std::uint64_t tmp;
-  memcpy(&tmp, (b->buf + offset), sizeof(std::uint64_t));
-  if (b->swapBytes) {
-    out = byteSwapUint64(tmp);
-  } else {
-    out = tmp;
-  }
+  out = loadUnaligned<Order, std::uint64_t>(b->buf + offset);
 
   return true;
 }
 
+template <byte_order Order>
 bool readChar16(bounded_buffer *b, std::uint32_t offset, char16_t &out) {
   if (b == nullptr) {
     PE_ERR(PEERR_BUFFER);
@@ -178,20 +195,48 @@ bool readChar16(bounded_buffer *b, std::uint32_t offset, char16_t &out) {
     return false;
   }
 
-  char16_t tmp;
-  if (b->swapBytes) {
-    std::uint8_t tmpBuf[2];
-    tmpBuf[0] = *(b->buf + offset + 1);
-    tmpBuf[1] = *(b->buf + offset);
-    memcpy(&tmp, tmpBuf, sizeof(std::uint16_t));
-  } else {
-    memcpy(&tmp, (b->buf + offset), sizeof(std::uint16_t));
-  }
-  out = tmp;
+  out = static_cast<char16_t>(
+      loadUnaligned<Order, std::uint16_t>(b->buf + offset));
 
   return true;
 }
 
+template bool readWord<byte_order::little>(bounded_buffer *,
+                                           std::uint32_t,
+                                           std::uint16_t &);
+template bool
+readWord<byte_order::big>(bounded_buffer *, std::uint32_t, std::uint16_t &);
+template bool readDword<byte_order::little>(bounded_buffer *,
+                                            std::uint32_t,
+                                            std::uint32_t &);
+template bool
+readDword<byte_order::big>(bounded_buffer *, std::uint32_t, std::uint32_t &);
+template bool readQword<byte_order::little>(bounded_buffer *,
+                                            std::uint32_t,
+                                            std::uint64_t &);
+template bool
+readQword<byte_order::big>(bounded_buffer *, std::uint32_t, std::uint64_t &);
+template bool
+readChar16<byte_order::little>(bounded_buffer *, std::uint32_t, char16_t &);
+template bool
+readChar16<byte_order::big>(bounded_buffer *, std::uint32_t, char16_t &);
+
+bool readWord(bounded_buffer *b, std::uint32_t offset, std::uint16_t &out) {
+  return readWord<byte_order::little>(b, offset, out);
+}
+
+bool readDword(bounded_buffer *b, std::uint32_t offset, std::uint32_t &out) {
+  return readDword<byte_order::little>(b, offset, out);
+}
+
+bool readQword(bounded_buffer *b, std::uint32_t offset, std::uint64_t &out) {
+  return readQword<byte_order::little>(b, offset, out);
+}
+
+bool readChar16(bounded_buffer *b, std::uint32_t offset, char16_t &out) {
+  return readChar16<byte_order::little>(b, offset, out);
+}
+
 bounded_buffer *readFileToFileBuffer(const char *filePath) {
 #ifdef _WIN32
   HANDLE h = CreateFileA(filePath,
@@ -0,0 +1,195 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include <pe-parse/parse.h>
+
+/*
+ * As with the SHA extensions in sha256.cpp, the vector paths are compiled
+ * with per-function target attributes and picked at run time.
+ */
+#include "simd.h"
+
+namespace peparse {
+
+extern std::uint32_t err;
+extern error_location err_loc;
+
+namespace {
+
+static_assert(offsetof(optional_header_32, CheckSum) ==
+                  offsetof(optional_header_64, CheckSum),
+              "CheckSum is at the same offset in PE32 and PE32+");
+
+/*
+ * The checksum is a 16-bit one's complement sum, which is the sum of the
+ * words modulo 0xFFFF. The words can therefore be added up in any order in
+ * wide accumulators and the carries folded back in once, at the end.
+ */
+std::uint64_t sumWordsPortable(const std::uint8_t *data, std::size_t len) {
+  std::uint64_t sum = 0;
+  std::size_t i = 0;
+  for (; i + 1 < len; i += 2) {
+    sum += static_cast<std::uint32_t>(data[i]) |
+           static_cast<std::uint32_t>(data[i + 1]) << 8;
+  }
+  // an odd trailing byte is summed as if the file were padded with a zero
+  if (i < len) {
+    sum += data[i];
+  }
+  return sum;
+}
+
+#if defined(PEPARSE_HAVE_X86_DISPATCH)
+// each 32-bit lane takes two words per vector, so this many vectors can be
+// summed before the lanes have to be widened
+constexpr std::size_t LANE_VECTORS = 32768;
+
+PEPARSE_TARGET("sse2") std::uint64_t sumWordsSse2(const std::uint8_t *data,
+                                                  std::size_t vectors) {
+  const __m128i lowWords = _mm_set1_epi32(0xFFFF);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i total = zero;
+
+  while (vectors != 0) {
+    std::size_t n = std::min(vectors, LANE_VECTORS);
+    vectors -= n;
+
+    __m128i acc = zero;
+    for (; n != 0; n--, data += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+      acc = _mm_add_epi32(acc, _mm_and_si128(v, lowWords));
+      acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+    }
+    total = _mm_add_epi64(total, _mm_unpacklo_epi32(acc, zero));
+    total = _mm_add_epi64(total, _mm_unpackhi_epi32(acc, zero));
+  }
+
+  alignas(16) std::uint64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i *>(lanes), total);
+  return lanes[0] + lanes[1];
+}
+
+PEPARSE_TARGET("avx2") std::uint64_t sumWordsAvx2(const std::uint8_t *data,
+                                                  std::size_t vectors) {
+  const __m256i lowWords = _mm256_set1_epi32(0xFFFF);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i total = zero;
+
+  while (vectors != 0) {
+    std::size_t n = std::min(vectors, LANE_VECTORS);
+    vectors -= n;
+
+    __m256i acc = zero;
+    for (; n != 0; n--, data += 32) {
+      __m256i v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+      acc = _mm256_add_epi32(acc, _mm256_and_si256(v, lowWords));
+      acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+    }
+    total = _mm256_add_epi64(total, _mm256_unpacklo_epi32(acc, zero));
+    total = _mm256_add_epi64(total, _mm256_unpackhi_epi32(acc, zero));
+  }
+
+  alignas(32) std::uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), total);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+bool detectAvx2() {
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0);
+  if (regs[0] < 7) {
+    return false;
+  }
+  // the OS must also save the YMM registers
+  __cpuid(regs, 1);
+  if ((regs[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// sum the words of [data, data + len); data must start on a word boundary
+// of the file
+std::uint64_t sumWords(const std::uint8_t *data, std::size_t len) {
+  std::uint64_t sum = 0;
+#if defined(PEPARSE_HAVE_X86_DISPATCH)
+  static const bool avx2 = detectAvx2();
+  std::size_t width = avx2 ? 32 : 16;
+  std::size_t vectors = len / width;
+  sum = avx2 ? sumWordsAvx2(data, vectors) : sumWordsSse2(data, vectors);
+  data += vectors * width;
+  len -= vectors * width;
+#endif
+  return sum + sumWordsPortable(data, len);
+}
+
+} // namespace
+
+std::uint32_t ComputePEChecksum(parsed_pe *pe) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return 0;
+  }
+
+  const std::uint8_t *file = pe->fileBuffer->buf;
+  const std::size_t fileSize = pe->fileBuffer->bufLen;
+
+  const std::size_t checkSumOff =
+      static_cast<std::size_t>(pe->peHeader.dos.e_lfanew) +
+      sizeof(std::uint32_t) + sizeof(file_header) +
+      offsetof(optional_header_32, CheckSum);
+
+  // the words that overlap the CheckSum field are summed with the field
+  // zeroed; it is usually, but not necessarily, word aligned
+  std::size_t from = std::min(checkSumOff & ~std::size_t{1}, fileSize);
+  std::size_t to = std::min((checkSumOff + 5) & ~std::size_t{1}, fileSize);
+
+  std::uint8_t field[6] = {};
+  for (std::size_t i = from; i < to; i++) {
+    if (i < checkSumOff || i >= checkSumOff + 4) {
+      field[i - from] = file[i];
+    }
+  }
+
+  std::uint64_t sum = sumWords(file, from) + sumWordsPortable(field, 6) +
+                      sumWords(file + to, fileSize - to);
+  while (sum > 0xFFFF) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+
+  return static_cast<std::uint32_t>(sum + fileSize);
+}
+
+} // namespace peparse
@@ -0,0 +1,223 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <pe-parse/entropy.h>
+
+#include "simd.h"
+
+namespace peparse {
+
+namespace {
+
+/*
+ * Incrementing a single table stalls on runs of one value, where each
+ * increment has to wait for the store of the previous one. Spreading
+ * consecutive bytes over several tables breaks that dependency, and blocks
+ * of a single value (padding, mostly) are counted with one add.
+ */
+constexpr std::size_t TABLES = 4;
+typedef std::uint32_t sub_histograms[TABLES][256];
+
+// each table receives at most this many counts between flushes into the
+// 64-bit histogram, well short of overflowing
+constexpr std::size_t FLUSH_BYTES = std::size_t{1} << 30;
+
+inline void countWord(sub_histograms &c, std::uint64_t w) {
+  c[0][w & 0xFF]++;
+  c[1][(w >> 8) & 0xFF]++;
+  c[2][(w >> 16) & 0xFF]++;
+  c[3][(w >> 24) & 0xFF]++;
+  c[0][(w >> 32) & 0xFF]++;
+  c[1][(w >> 40) & 0xFF]++;
+  c[2][(w >> 48) & 0xFF]++;
+  c[3][w >> 56]++;
+}
+
+constexpr std::size_t BLOCK = 64;
+
+// true if all BLOCK bytes at data are equal to data[0]
+inline bool uniformBlock(const std::uint8_t *data) {
+#if defined(PEPARSE_HAVE_SSE2)
+  const __m128i *p = reinterpret_cast<const __m128i *>(data);
+  const __m128i first = _mm_set1_epi8(static_cast<char>(data[0]));
+  __m128i eq = _mm_and_si128(
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(p), first),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(p + 1), first)),
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), first),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(p + 3), first)));
+  return _mm_movemask_epi8(eq) == 0xFFFF;
+#else
+  std::uint64_t first = data[0] * UINT64_C(0x0101010101010101);
+  std::uint64_t diff = 0;
+  for (std::size_t i = 0; i < BLOCK; i += 8) {
+    std::uint64_t w;
+    std::memcpy(&w, data + i, sizeof(w));
+    diff |= w ^ first;
+  }
+  return diff == 0;
+#endif
+}
+
+void countBytes(sub_histograms &c, const std::uint8_t *data, std::size_t len) {
+  std::size_t i = 0;
+  for (; i + BLOCK <= len; i += BLOCK) {
+    if (uniformBlock(data + i)) {
+      c[0][data[i]] += BLOCK;
+      continue;
+    }
+    for (std::size_t k = 0; k < BLOCK; k += 8) {
+      std::uint64_t w;
+      std::memcpy(&w, data + i + k, sizeof(w));
+      countWord(c, w);
+    }
+  }
+  for (; i < len; i++) {
+    c[0][data[i]]++;
+  }
+}
+
+} // namespace
+
+void AddByteHistogram(byte_histogram &h,
+                      const std::uint8_t *data,
+                      std::size_t len) {
+  sub_histograms c;
+  while (len != 0) {
+    std::size_t n = std::min(len, FLUSH_BYTES);
+    std::memset(c, 0, sizeof(c));
+    countBytes(c, data, n);
+    for (std::size_t b = 0; b < 256; b++) {
+      h[b] += static_cast<std::uint64_t>(c[0][b]) + c[1][b] + c[2][b] +
+              c[3][b];
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+double ShannonEntropy(const byte_histogram &h) {
+  std::uint64_t total = 0;
+  for (std::uint64_t n : h) {
+    total += n;
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+
+  // H = log2(N) - sum(n * log2(n)) / N
+  double sum = 0.0;
+  for (std::uint64_t n : h) {
+    if (n > 1) {
+      double d = static_cast<double>(n);
+      sum += d * std::log2(d);
+    }
+  }
+  double t = static_cast<double>(total);
+  return std::max(0.0, std::log2(t) - sum / t);
+}
+
+double ChiSquare(const byte_histogram &h) {
+  std::uint64_t total = 0;
+  for (std::uint64_t n : h) {
+    total += n;
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+
+  double expected = static_cast<double>(total) / 256.0;
+  double chi = 0.0;
+  for (std::uint64_t n : h) {
+    double d = static_cast<double>(n) - expected;
+    chi += d * d;
+  }
+  return chi / expected;
+}
+
+std::vector<double> EntropyProfile(const std::uint8_t *data,
+                                   std::size_t len,
+                                   std::uint32_t windowSize,
+                                   std::uint32_t step) {
+  std::vector<double> out;
+  if (windowSize == 0 || step == 0 || len < windowSize) {
+    return out;
+  }
+  out.reserve((len - windowSize) / step + 1);
+
+  // with f(n) = n * log2(n), a window's entropy is log2(W) - sum(f) / W, and
+  // moving one byte into or out of the window changes the sum by a
+  // difference of two table entries
+  std::vector<double> f(std::size_t{windowSize} + 1);
+  for (std::size_t n = 2; n < f.size(); n++) {
+    double d = static_cast<double>(n);
+    f[n] = d * std::log2(d);
+  }
+  const double w = static_cast<double>(windowSize);
+  const double logW = std::log2(w);
+
+  std::uint32_t counts[256];
+  double sum = 0.0;
+  auto fill = [&](const std::uint8_t *window) {
+    std::memset(counts, 0, sizeof(counts));
+    for (std::size_t i = 0; i < windowSize; i++) {
+      counts[window[i]]++;
+    }
+    sum = 0.0;
+    for (std::uint32_t n : counts) {
+      sum += f[n];
+    }
+  };
+
+  fill(data);
+  for (std::size_t pos = 0;;) {
+    out.push_back(std::max(0.0, logW - sum / w));
+    if (len - pos - windowSize < step) {
+      break;
+    }
+
+    if (step >= windowSize) {
+      // no overlap to reuse
+      fill(data + pos + step);
+    } else {
+      for (std::size_t i = pos; i < pos + step; i++) {
+        std::uint32_t &leaving = counts[data[i]];
+        sum += f[leaving - 1] - f[leaving];
+        leaving--;
+        std::uint32_t &entering = counts[data[i + windowSize]];
+        sum += f[entering + 1] - f[entering];
+        entering++;
+      }
+    }
+    pos += step;
+  }
+
+  return out;
+}
+
+} // namespace peparse
@@ -0,0 +1,176 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <pe-parse/digest.h>
+
+namespace peparse {
+
+namespace {
+
+const std::uint32_t K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+    0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+    0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+    0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+    0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+    0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+
+// per-round left rotations, four for each group of sixteen rounds
+const std::uint32_t S[16] = {
+    7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+inline std::uint32_t rotl(std::uint32_t x, std::uint32_t n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+inline std::uint32_t loadLE32(const std::uint8_t *p) {
+  return static_cast<std::uint32_t>(p[0]) |
+         static_cast<std::uint32_t>(p[1]) << 8 |
+         static_cast<std::uint32_t>(p[2]) << 16 |
+         static_cast<std::uint32_t>(p[3]) << 24;
+}
+
+void compress(std::uint32_t state[4],
+              const std::uint8_t *data,
+              std::size_t blocks) {
+  for (; blocks != 0; blocks--, data += 64) {
+    std::uint32_t m[16];
+    for (std::size_t i = 0; i < 16; i++) {
+      m[i] = loadLE32(data + 4 * i);
+    }
+
+    std::uint32_t a = state[0];
+    std::uint32_t b = state[1];
+    std::uint32_t c = state[2];
+    std::uint32_t d = state[3];
+
+    for (std::uint32_t i = 0; i < 64; i++) {
+      std::uint32_t f;
+      std::uint32_t g;
+      if (i < 16) {
+        f = (b & c) | (~b & d);
+        g = i;
+      } else if (i < 32) {
+        f = (d & b) | (~d & c);
+        g = (5 * i + 1) & 15;
+      } else if (i < 48) {
+        f = b ^ c ^ d;
+        g = (3 * i + 5) & 15;
+      } else {
+        f = c ^ (b | ~d);
+        g = (7 * i) & 15;
+      }
+
+      std::uint32_t t = d;
+      d = c;
+      c = b;
+      b += rotl(a + f + K[i] + m[g], S[(i >> 4) * 4 + (i & 3)]);
+      a = t;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+  }
+}
+
+} // namespace
+
+void Md5Init(md5_ctx &ctx) {
+  ctx.state[0] = 0x67452301;
+  ctx.state[1] = 0xefcdab89;
+  ctx.state[2] = 0x98badcfe;
+  ctx.state[3] = 0x10325476;
+  ctx.length = 0;
+  ctx.blockLen = 0;
+}
+
+void Md5Update(md5_ctx &ctx, const std::uint8_t *data, std::size_t len) {
+  ctx.length += len;
+
+  if (ctx.blockLen != 0) {
+    std::size_t take = std::min<std::size_t>(len, 64 - ctx.blockLen);
+    std::memcpy(ctx.block + ctx.blockLen, data, take);
+    ctx.blockLen += static_cast<std::uint32_t>(take);
+    data += take;
+    len -= take;
+    if (ctx.blockLen < 64) {
+      return;
+    }
+    compress(ctx.state, ctx.block, 1);
+    ctx.blockLen = 0;
+  }
+
+  if (len >= 64) {
+    compress(ctx.state, data, len / 64);
+    data += len & ~static_cast<std::size_t>(63);
+    len &= 63;
+  }
+
+  if (len != 0) {
+    std::memcpy(ctx.block, data, len);
+    ctx.blockLen = static_cast<std::uint32_t>(len);
+  }
+}
+
+void Md5Final(md5_ctx &ctx, md5_digest &out) {
+  std::uint64_t bits = ctx.length * 8;
+
+  ctx.block[ctx.blockLen++] = 0x80;
+  if (ctx.blockLen > 56) {
+    std::memset(ctx.block + ctx.blockLen, 0, 64 - ctx.blockLen);
+    compress(ctx.state, ctx.block, 1);
+    ctx.blockLen = 0;
+  }
+  std::memset(ctx.block + ctx.blockLen, 0, 56 - ctx.blockLen);
+  for (std::size_t i = 0; i < 8; i++) {
+    ctx.block[56 + i] = static_cast<std::uint8_t>(bits >> (8 * i));
+  }
+  compress(ctx.state, ctx.block, 1);
+
+  for (std::size_t i = 0; i < 16; i++) {
+    out[i] = static_cast<std::uint8_t>(ctx.state[i / 4] >> (8 * (i % 4)));
+  }
+}
+
+md5_digest Md5(const std::uint8_t *data, std::size_t len) {
+  md5_ctx ctx;
+  Md5Init(ctx);
+  Md5Update(ctx, data, len);
+  md5_digest out;
+  Md5Final(ctx, out);
+  return out;
+}
+
+} // namespace peparse
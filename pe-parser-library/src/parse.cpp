@@ -24,16 +24,23 @@ THE SOFTWARE.
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 #include <pe-parse/nt-headers.h>
 #include <pe-parse/parse.h>
 #include <pe-parse/to_string.h>
 
+#include "simd.h"
+
 namespace peparse {
 
 struct section {
@@ -41,17 +48,21 @@ struct section {
   std::uint64_t sectionBase;
   bounded_buffer *sectionData;
   image_section_header sec;
+  std::uint32_t tableIndex; // position in the section table
 };
 
 struct importent {
   VA addr;
   std::string symbolName;
   std::string moduleName;
+  bool byOrdinal;
+  std::uint16_t ordinal;
+  bool delayLoad;
 };
 
 struct exportent {
   VA addr;
-  std::uint16_t ordinal;
+  std::uint16_t eatIdx; // the ordinal less OrdinalBase
   std::string symbolName;
   std::string moduleName;
   std::string forwardName;
@@ -122,16 +133,257 @@ struct symbol {
   std::vector<aux_symbol_f5> aux_symbols_f5;
 };
 
+// A table of fixed-size entries inside a section, such as the EAT
+struct table_view {
+  bounded_buffer *buf = nullptr;
+  std::uint32_t off = 0;
+
+  bool locate(const std::vector<section> &secs, VA va);
+
+  template <typename E>
+  bool read(std::uint32_t i, E &out) const {
+    std::uint64_t at = off + static_cast<std::uint64_t>(i) * sizeof(E);
+    if (buf == nullptr || at > UINT32_MAX) {
+      return false;
+    }
+
+    if constexpr (sizeof(E) == sizeof(std::uint16_t)) {
+      return readWord(buf, static_cast<std::uint32_t>(at), out);
+    } else {
+      return readDword(buf, static_cast<std::uint32_t>(at), out);
+    }
+  }
+};
+
+// Ordinals, and so the ordinal table's EAT indexes, are 16 bits wide: no
+// EAT entry past this many can be exported
+constexpr std::uint32_t EAT_MAX_ENTRIES = 0x10000;
+
+struct export_name {
+  std::uint16_t eatIdx;
+  std::uint32_t nameIdx;
+};
+
+/*
+ * Where the export directory's tables live, recorded by getExports so that
+ * single exports can be looked up without going through the exports vector.
+ */
+struct export_table {
+  std::uint32_t dirRva = 0;
+  std::uint32_t dirSize = 0;
+  std::uint32_t ordinalBase = 0;
+  // The EAT entries getExports walked, which lookups are held to as well
+  std::uint32_t numFunctions = 0;
+  std::uint32_t numNames = 0;
+  std::string moduleName;
+  table_view eat;
+  table_view names;
+  table_view ordinals;
+  // Inverse of the ordinal table, sorted by EAT index
+  std::vector<export_name> nameByIndex;
+
+  // EAT entries that point back into the export directory are forwarders
+  bool isForwarded(std::uint32_t rva) const {
+    return rva >= dirRva && rva < dirRva + dirSize;
+  }
+};
+
+// Bits in rsrc_index::named and rsrc_index::decodedLevels
+constexpr std::uint8_t RSRC_NAMED_TYPE = 1 << 0;
+constexpr std::uint8_t RSRC_NAMED_NAME = 1 << 1;
+constexpr std::uint8_t RSRC_NAMED_LANG = 1 << 2;
+constexpr std::uint8_t RSRC_NAMED_ALL =
+    RSRC_NAMED_TYPE | RSRC_NAMED_NAME | RSRC_NAMED_LANG;
+
+struct rsrc_key {
+  std::uint32_t type;
+  std::uint32_t name;
+  std::uint32_t lang;
+  std::uint32_t idx;
+};
+
+/*
+ * Lookup structures over parsed_pe_internal::rsrcs. Directory strings are
+ * only bounds-checked while walking the tree and decoded from data, under
+ * lock, when a lookup first looks at them: named records which levels of
+ * each resource were named entries, and decodedLevels which of those have
+ * been decoded. decoded is set once the first iteration has decoded them
+ * all.
+ */
+struct rsrc_index {
+  std::atomic<bool> decoded{false};
+  std::mutex lock;
+  bounded_buffer *data = nullptr;
+  std::vector<std::uint8_t> named;
+  std::vector<std::atomic<std::uint8_t>> decodedLevels;
+  std::vector<rsrc_key> keys;
+};
+
+/*
+ * Reverse index from IAT slot VA to import, built under lock on the first
+ * lookup and read-only afterwards. refs is sorted by addr. When the slots
+ * are dense enough, which they are unless the image spreads its IATs across
+ * distant sections, dense maps each 4-byte slot offset from base to an
+ * index into refs, so that a lookup needs no search.
+ */
+struct iat_index {
+  std::atomic<bool> built{false};
+  std::mutex lock;
+  std::vector<import_ref> refs;
+  VA base = 0;
+  std::vector<std::uint32_t> dense;
+};
+
+// Function ranges from the exception directory, sorted by begin. Parsed on
+// first use.
+struct function_table {
+  std::atomic<bool> built{false};
+  std::mutex lock;
+  std::vector<runtime_function> funcs;
+};
+
+/*
+ * Every address-bearing symbol source merged into one list sorted by addr,
+ * for Symbolize. limits[i] is where syms[i] stops covering addresses: its
+ * end if its size is known, otherwise the end of its section. Built once,
+ * under lock, and read-only afterwards.
+ */
+struct symbol_index {
+  std::atomic<bool> built{false};
+  std::mutex lock;
+  std::vector<symbol_entry> syms;
+  std::vector<VA> limits;
+};
+
+/*
+ * A sorted array of RVAs plus, for every 4 KB page from base on, the index
+ * of the first RVA at or above it. A lookup only binary searches the
+ * entries of its own page, which keeps it to a few cache lines even for
+ * tables with tens of thousands of entries. The directory is left empty if
+ * the RVAs are too sparse for it to pay off.
+ */
+struct rva_set {
+  std::vector<RVA> rvas;
+  RVA base = 0;
+  std::vector<std::uint32_t> pages;
+
+  void index();
+  // the position of rva in rvas, or rvas.size() if it is not there
+  std::size_t find(RVA rva) const;
+};
+
+/*
+ * The load config directory and the guard tables it points to, decoded on
+ * first use. cfFlags runs parallel to cfTargets.rvas.
+ */
+struct load_config_info {
+  std::atomic<bool> built{false};
+  std::mutex lock;
+  bool present = false;
+  image_load_config_64 cfg;
+  rva_set cfTargets;
+  std::vector<std::uint8_t> cfFlags;
+  rva_set sehHandlers;
+};
+
 struct parsed_pe_internal {
   std::vector<section> secs;
   std::vector<resource> rsrcs;
+  rsrc_index rsrcIdx;
   std::vector<importent> imports;
+  iat_index iatIdx;
+  function_table funcTbl;
+  symbol_index symIdx;
+  load_config_info loadCfg;
   std::vector<reloc> relocs;
   std::vector<exportent> exports;
+  export_table exportTbl;
   std::vector<symbol> symbols;
   std::vector<debugent> debugdirs;
 };
 
+// Runs build the first time it is called for a given flag, even if several
+// threads get here at once. std::call_once would do, but needs to be linked
+// with pthreads on older glibc.
+template <typename F>
+static void buildOnce(std::atomic<bool> &built, std::mutex &lock, F &&build) {
+  if (built.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (!built.load(std::memory_order_relaxed)) {
+    build();
+    built.store(true, std::memory_order_release);
+  }
+}
+
+/*
+ * PE32 and PE32+ images only differ in a handful of places that matter to
+ * the directory walkers: the width of ImageBase, of import thunks and of the
+ * pointers in the load config and TLS directory. The walkers are templated
+ * on the optional header type so that each variant is specialized at
+ * compile time, instead of re-checking OptionalMagic inside every loop.
+ */
+template <typename T>
+struct optional_header_traits;
+
+template <>
+struct optional_header_traits<optional_header_32> {
+  typedef std::uint32_t thunk_type;
+  typedef image_load_config_32 load_config_type;
+  typedef image_tls_directory_32 tls_directory_type;
+  static constexpr thunk_type ordinal_flag = 0x80000000;
+
+  static bool
+  readThunk(bounded_buffer *b, std::uint32_t offset, thunk_type &out) {
+    return readDword(b, offset, out);
+  }
+};
+
+template <>
+struct optional_header_traits<optional_header_64> {
+  typedef std::uint64_t thunk_type;
+  typedef image_load_config_64 load_config_type;
+  typedef image_tls_directory_64 tls_directory_type;
+  static constexpr thunk_type ordinal_flag = 0x8000000000000000;
+
+  static bool
+  readThunk(bounded_buffer *b, std::uint32_t offset, thunk_type &out) {
+    return readQword(b, offset, out);
+  }
+};
+
+// Converts an RVA (or any image-relative value) to a VA. The addition is done
+// at the width of the header's ImageBase, so PE32 addresses wrap at 32 bits.
+template <typename T, typename U>
+static inline VA toVA(const T &optHdr, U rva) {
+  return optHdr.ImageBase + rva;
+}
+
+// Invokes f with whichever optional header the magic selects. Returns false
+// if the magic is neither PE32 nor PE32+.
+template <typename F>
+static bool withOptionalHeader(const nt_header_32 &nt, F &&f) {
+  if (nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
+    f(nt.OptionalHeader);
+    return true;
+  } else if (nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
+    f(nt.OptionalHeader64);
+    return true;
+  }
+
+  return false;
+}
+
+// Converts an RVA to a VA using the header the image actually has
+static VA rvaToVA(parsed_pe *pe, RVA rva) {
+  VA v = 0;
+  withOptionalHeader(pe->peHeader.nt,
+                     [&](const auto &optHdr) { v = toVA(optHdr, rva); });
+  return v;
+}
+
 // String representation of Rich header object types
 static const std::string kProdId_C = "[ C ]";
 static const std::string kProdId_CPP = "[C++]";
@@ -481,7 +733,7 @@ const std::string &GetRichProductName(std::uint16_t buildNum) {
 }
 
 std::uint32_t err = 0;
-std::string err_loc;
+error_location err_loc = {nullptr, 0};
 
 static const char *pe_err_str[] = {
     "None",
@@ -497,6 +749,8 @@ static const char *pe_err_str[] = {
     "Invalid buffer",
     "Invalid address",
     "Invalid size",
+    "Invalid signature pattern",
+    "Unable to write data",
 };
 
 std::uint32_t GetPEErr() {
@@ -508,7 +762,12 @@ std::string GetPEErrString() {
 }
 
 std::string GetPEErrLoc() {
-  return err_loc;
+  if (err_loc.func == nullptr) {
+    return std::string();
+  }
+
+  return std::string(err_loc.func) + ":" +
+         to_string<std::uint32_t>(err_loc.line, std::dec);
 }
 
 const char *GetSymbolTableStorageClassName(std::uint8_t id) {
@@ -591,18 +850,39 @@ static bool readCString(const bounded_buffer &buffer,
   return false;
 }
 
-bool getSecForVA(const std::vector<section> &secs, VA v, section &sec) {
-  for (section s : secs) {
+// Like getSecForVA, but returns the section in place instead of a copy
+static const section *findSecForVA(const std::vector<section> &secs, VA v) {
+  for (const section &s : secs) {
     std::uint64_t low = s.sectionBase;
     std::uint64_t high = low + s.sec.Misc.VirtualSize;
 
     if (v >= low && v < high) {
-      sec = s;
-      return true;
+      return &s;
     }
   }
 
-  return false;
+  return nullptr;
+}
+
+bool getSecForVA(const std::vector<section> &secs, VA v, section &sec) {
+  const section *s = findSecForVA(secs, v);
+  if (s == nullptr) {
+    return false;
+  }
+
+  sec = *s;
+  return true;
+}
+
+bool table_view::locate(const std::vector<section> &secs, VA va) {
+  const section *s = findSecForVA(secs, va);
+  if (s == nullptr) {
+    return false;
+  }
+
+  buf = s->sectionData;
+  off = static_cast<std::uint32_t>(va - s->sectionBase);
+  return true;
 }
 
 void IterRich(parsed_pe *pe, iterRich cb, void *cbd) {
@@ -613,8 +893,92 @@ void IterRich(parsed_pe *pe, iterRich cb, void *cbd) {
   }
 }
 
+// Checks that a resource directory string lies entirely within data
+bool check_resource_id(bounded_buffer *data, std::uint32_t id) {
+  std::uint16_t len;
+  if (!readWord(data, id, len)) {
+    return false;
+  }
+
+  if (static_cast<std::uint64_t>(id) + 2 + len * 2U > data->bufLen) {
+    PE_ERR(PEERR_ADDRESS);
+    return false;
+  }
+
+  return true;
+}
+
+bool parse_resource_id(bounded_buffer *data,
+                       std::uint32_t id,
+                       std::string &result) {
+  if (!check_resource_id(data, id)) {
+    return false;
+  }
+
+  std::uint16_t len;
+  readWord(data, id, len);
+  id += 2;
+
+  // The whole string was checked above, so copy it in bulk rather than
+  // reading it one code unit at a time.
+  UCharString rawString(len, 0);
+  memcpy(&rawString[0], data->buf + id, len * 2U);
+
+  result = from_utf16(rawString);
+  return true;
+}
+
+// Fills in whichever of type_str, name_str and lang_str of resource i are
+// in levels, named and not decoded yet. The caller holds the index lock
+static void decodeRsrcLevels(parsed_pe_internal *pint,
+                             std::size_t i,
+                             std::uint8_t levels) {
+  rsrc_index &idx = pint->rsrcIdx;
+  std::uint8_t done = idx.decodedLevels[i].load(std::memory_order_relaxed);
+  levels &= static_cast<std::uint8_t>(idx.named[i] & ~done);
+
+  resource &r = pint->rsrcs[i];
+  if ((levels & RSRC_NAMED_TYPE) != 0) {
+    parse_resource_id(idx.data, r.type & 0x0FFFFFFF, r.type_str);
+  }
+  if ((levels & RSRC_NAMED_NAME) != 0) {
+    parse_resource_id(idx.data, r.name & 0x0FFFFFFF, r.name_str);
+  }
+  if ((levels & RSRC_NAMED_LANG) != 0) {
+    parse_resource_id(idx.data, r.lang & 0x0FFFFFFF, r.lang_str);
+  }
+
+  idx.decodedLevels[i].store(static_cast<std::uint8_t>(done | levels),
+                             std::memory_order_release);
+}
+
+// Decodes the strings of levels of resource i on first use
+static void decodeRsrcStrings(parsed_pe_internal *pint,
+                              std::size_t i,
+                              std::uint8_t levels) {
+  rsrc_index &idx = pint->rsrcIdx;
+  levels &= idx.named[i];
+  if ((idx.decodedLevels[i].load(std::memory_order_acquire) & levels) ==
+      levels) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(idx.lock);
+  decodeRsrcLevels(pint, i, levels);
+}
+
 void IterRsrc(parsed_pe *pe, iterRsrc cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
   parsed_pe_internal *pint = pe->internal;
+  buildOnce(pint->rsrcIdx.decoded, pint->rsrcIdx.lock, [&] {
+    for (std::size_t i = 0; i < pint->rsrcs.size(); i++) {
+      decodeRsrcLevels(pint, i, RSRC_NAMED_ALL);
+    }
+  });
 
   for (const resource &r : pint->rsrcs) {
     if (cb(cbd, r) != 0) {
@@ -623,27 +987,155 @@ void IterRsrc(parsed_pe *pe, iterRsrc cb, void *cbd) {
   }
 }
 
-bool parse_resource_id(bounded_buffer *data,
-                       std::uint32_t id,
-                       std::string &result) {
-  std::uint16_t len;
-  if (!readWord(data, id, len)) {
-    return false;
+static bool rsrcKeyLess(const rsrc_key &a, const rsrc_key &b) {
+  if (a.type != b.type) {
+    return a.type < b.type;
   }
-  id += 2;
+  if (a.name != b.name) {
+    return a.name < b.name;
+  }
+  return a.lang < b.lang;
+}
 
-  std::uint32_t rawSize = len * 2U;
-  UCharString rawString;
-  for (std::uint32_t i = 0; i < rawSize; i += 2) {
-    char16_t c;
-    if (!readChar16(data, id + i, c)) {
-      return false;
+const resource *FindRsrc(parsed_pe *pe,
+                         std::uint32_t type,
+                         std::uint32_t name,
+                         std::uint32_t lang) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return nullptr;
+  }
+
+  parsed_pe_internal *pint = pe->internal;
+  const rsrc_index &idx = pint->rsrcIdx;
+
+  // A named entry's raw ID is the offset of its string, which can equal
+  // the ID asked for, so skip over those
+  std::uint8_t mustBeID = RSRC_NAMED_TYPE | RSRC_NAMED_NAME;
+  if (lang != RSRC_LANG_ANY) {
+    mustBeID |= RSRC_NAMED_LANG;
+  }
+
+  rsrc_key k = {type, name, lang == RSRC_LANG_ANY ? 0 : lang, 0};
+  auto it = std::lower_bound(idx.keys.begin(), idx.keys.end(), k, rsrcKeyLess);
+  for (; it != idx.keys.end() && it->type == type && it->name == name; ++it) {
+    if (lang != RSRC_LANG_ANY && it->lang != lang) {
+      break;
+    }
+    if ((idx.named[it->idx] & mustBeID) == 0) {
+      decodeRsrcStrings(pint, it->idx, RSRC_NAMED_ALL);
+      return &pint->rsrcs[it->idx];
     }
-    rawString.push_back(c);
   }
 
-  result = from_utf16(rawString);
-  return true;
+  return nullptr;
+}
+
+// One level of a lookup by string: the ID to match if str is null
+struct rsrc_id {
+  std::uint32_t id;
+  const std::string *str;
+};
+
+static bool rsrcIdMatches(const rsrc_id &want,
+                          std::uint32_t id,
+                          const std::string &str,
+                          bool named) {
+  if (want.str == nullptr) {
+    return !named && id == want.id;
+  }
+  return named && str == *want.str;
+}
+
+/*
+ * Lookups where the type or name is a string. Names can't be compared
+ * through the sorted keys, so this walks the keys of the type if it is an
+ * ID, or every key otherwise, decoding only the strings it compares. Keys
+ * are still in (type, name, lang) order, so the first match has the lowest
+ * language ID for its name, and the resources of one type directory are
+ * adjacent, so a type string is compared once per directory.
+ */
+static const resource *findRsrcByString(parsed_pe *pe,
+                                        const rsrc_id &type,
+                                        const rsrc_id &name,
+                                        std::uint32_t lang) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return nullptr;
+  }
+
+  parsed_pe_internal *pint = pe->internal;
+  const rsrc_index &idx = pint->rsrcIdx;
+
+  // Named entries sort after IDs within a type, so only that tail is
+  // searched for a name
+  auto it = idx.keys.begin();
+  if (type.str == nullptr) {
+    rsrc_key k = {type.id, name.str == nullptr ? 0 : 0x80000000, 0, 0};
+    it = std::lower_bound(idx.keys.begin(), idx.keys.end(), k, rsrcKeyLess);
+  }
+
+  bool haveType = false;
+  std::uint32_t lastType = 0;
+  bool lastTypeNamed = false;
+  bool lastTypeMatched = false;
+  for (; it != idx.keys.end(); ++it) {
+    if (type.str == nullptr && it->type != type.id) {
+      break;
+    }
+
+    if (lang != RSRC_LANG_ANY && it->lang != lang) {
+      continue;
+    }
+
+    std::uint8_t named = idx.named[it->idx];
+    const resource &r = pint->rsrcs[it->idx];
+    bool typeNamed = (named & RSRC_NAMED_TYPE) != 0;
+    if (!haveType || it->type != lastType || typeNamed != lastTypeNamed) {
+      if (type.str != nullptr) {
+        decodeRsrcStrings(pint, it->idx, RSRC_NAMED_TYPE);
+      }
+      haveType = true;
+      lastType = it->type;
+      lastTypeNamed = typeNamed;
+      lastTypeMatched = rsrcIdMatches(type, it->type, r.type_str, typeNamed);
+    }
+    if (!lastTypeMatched) {
+      continue;
+    }
+
+    if (name.str != nullptr) {
+      decodeRsrcStrings(pint, it->idx, RSRC_NAMED_NAME);
+    }
+    if (rsrcIdMatches(
+            name, it->name, r.name_str, (named & RSRC_NAMED_NAME) != 0)) {
+      decodeRsrcStrings(pint, it->idx, RSRC_NAMED_ALL);
+      return &r;
+    }
+  }
+
+  return nullptr;
+}
+
+const resource *FindRsrc(parsed_pe *pe,
+                         std::uint32_t type,
+                         const std::string &name,
+                         std::uint32_t lang) {
+  return findRsrcByString(pe, {type, nullptr}, {0, &name}, lang);
+}
+
+const resource *FindRsrc(parsed_pe *pe,
+                         const std::string &type,
+                         std::uint32_t name,
+                         std::uint32_t lang) {
+  return findRsrcByString(pe, {0, &type}, {name, nullptr}, lang);
+}
+
+const resource *FindRsrc(parsed_pe *pe,
+                         const std::string &type,
+                         const std::string &name,
+                         std::uint32_t lang) {
+  return findRsrcByString(pe, {0, &type}, {0, &name}, lang);
 }
 
 bool parse_resource_table(bounded_buffer *sectionData,
@@ -651,7 +1143,9 @@ bool parse_resource_table(bounded_buffer *sectionData,
                           std::uint32_t virtaddr,
                           std::uint32_t depth,
                           resource_dir_entry *dirent,
-                          std::vector<resource> &rsrcs) {
+                          std::uint8_t named,
+                          std::vector<resource> &rsrcs,
+                          rsrc_index &idx) {
   resource_dir_table rdt;
 
   if (sectionData == nullptr) {
@@ -700,37 +1194,10 @@ bool parse_resource_table(bounded_buffer *sectionData,
 
     if (depth == 0) {
       rde->type = rde->ID;
-      if (i < rdt.NameEntries) {
-        if (!parse_resource_id(
-                sectionData, rde->ID & 0x0FFFFFFF, rde->type_str)) {
-          if (dirent == nullptr) {
-            delete rde;
-          }
-          return false;
-        }
-      }
     } else if (depth == 1) {
       rde->name = rde->ID;
-      if (i < rdt.NameEntries) {
-        if (!parse_resource_id(
-                sectionData, rde->ID & 0x0FFFFFFF, rde->name_str)) {
-          if (dirent == nullptr) {
-            delete rde;
-          }
-          return false;
-        }
-      }
     } else if (depth == 2) {
       rde->lang = rde->ID;
-      if (i < rdt.NameEntries) {
-        if (!parse_resource_id(
-                sectionData, rde->ID & 0x0FFFFFFF, rde->lang_str)) {
-          if (dirent == nullptr) {
-            delete rde;
-          }
-          return false;
-        }
-      }
     } else {
       /* .rsrc can accommodate up to 2**31 levels, but Windows only uses 3 by
        * convention. As such, any depth above 3 indicates potentially unchecked
@@ -742,6 +1209,19 @@ bool parse_resource_table(bounded_buffer *sectionData,
       return false;
     }
 
+    // Names are only checked here; decodeRsrcStrings decodes them on first
+    // use
+    std::uint8_t entNamed = named;
+    if (i < rdt.NameEntries) {
+      if (!check_resource_id(sectionData, rde->ID & 0x0FFFFFFF)) {
+        if (dirent == nullptr) {
+          delete rde;
+        }
+        return false;
+      }
+      entNamed |= static_cast<std::uint8_t>(1 << depth);
+    }
+
     // High bit 0 = RVA to RDT.
     // High bit 1 = RVA to RDE.
     if (rde->RVA & 0x80000000) {
@@ -750,7 +1230,9 @@ bool parse_resource_table(bounded_buffer *sectionData,
                                 virtaddr,
                                 depth + 1,
                                 rde,
-                                rsrcs)) {
+                                entNamed,
+                                rsrcs,
+                                idx)) {
         if (dirent == nullptr) {
           delete rde;
         }
@@ -809,9 +1291,6 @@ bool parse_resource_table(bounded_buffer *sectionData,
       }
 
       resource rsrc;
-      rsrc.type_str = rde->type_str;
-      rsrc.name_str = rde->name_str;
-      rsrc.lang_str = rde->lang_str;
       rsrc.type = rde->type;
       rsrc.name = rde->name;
       rsrc.lang = rde->lang;
@@ -845,14 +1324,7 @@ bool parse_resource_table(bounded_buffer *sectionData,
       }
 
       rsrcs.push_back(rsrc);
-    }
-
-    if (depth == 0) {
-      rde->type_str.clear();
-    } else if (depth == 1) {
-      rde->name_str.clear();
-    } else if (depth == 2) {
-      rde->lang_str.clear();
+      idx.named.push_back(entNamed);
     }
 
     if (dirent == nullptr) {
@@ -866,7 +1338,8 @@ bool parse_resource_table(bounded_buffer *sectionData,
 bool getResources(bounded_buffer *b,
                   bounded_buffer *fileBegin,
                   const std::vector<section> secs,
-                  std::vector<resource> &rsrcs) {
+                  std::vector<resource> &rsrcs,
+                  rsrc_index &idx) {
   static_cast<void>(fileBegin);
 
   if (b == nullptr)
@@ -877,27 +1350,46 @@ bool getResources(bounded_buffer *b,
       continue;
     }
 
-    if (!parse_resource_table(
-            s.sectionData, 0, s.sec.VirtualAddress, 0, nullptr, rsrcs)) {
+    idx.data = s.sectionData;
+    if (!parse_resource_table(s.sectionData,
+                              0,
+                              s.sec.VirtualAddress,
+                              0,
+                              nullptr,
+                              0,
+                              rsrcs,
+                              idx)) {
       return false;
     }
 
     break; // Because there should only be one .rsrc
   }
 
+  idx.keys.reserve(rsrcs.size());
+  for (std::size_t i = 0; i < rsrcs.size(); i++) {
+    idx.keys.push_back({rsrcs[i].type,
+                        rsrcs[i].name,
+                        rsrcs[i].lang,
+                        static_cast<std::uint32_t>(i)});
+  }
+  std::stable_sort(idx.keys.begin(), idx.keys.end(), rsrcKeyLess);
+  idx.decodedLevels = std::vector<std::atomic<std::uint8_t>>(rsrcs.size());
+
   return true;
 }
 
+template <typename T>
 bool getSections(bounded_buffer *b,
                  bounded_buffer *fileBegin,
-                 nt_header_32 &nthdr,
+                 const file_header &fileHdr,
+                 const T &optHdr,
                  std::vector<section> &secs) {
   if (b == nullptr) {
     return false;
   }
 
   // get each of the sections...
-  for (std::uint32_t i = 0; i < nthdr.FileHeader.NumberOfSections; i++) {
+  for (std::uint32_t i = 0; i < fileHdr.NumberOfSections; i++) {
     image_section_header curSec;
 
     std::uint32_t o = i * sizeof(image_section_header);
@@ -930,17 +1422,10 @@ bool getSections(bounded_buffer *b,
       thisSec.sectionName.push_back(static_cast<char>(c));
     }
 
-    if (nthdr.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      thisSec.sectionBase =
-          nthdr.OptionalHeader.ImageBase + curSec.VirtualAddress;
-    } else if (nthdr.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      thisSec.sectionBase =
-          nthdr.OptionalHeader64.ImageBase + curSec.VirtualAddress;
-    } else {
-      PE_ERR(PEERR_MAGIC);
-    }
+    thisSec.sectionBase = toVA(optHdr, curSec.VirtualAddress);
 
     thisSec.sec = curSec;
+    thisSec.tableIndex = i;
     std::uint32_t lowOff = curSec.PointerToRawData;
     std::uint32_t highOff = lowOff + curSec.SizeOfRawData;
     thisSec.sectionData = splitBuffer(fileBegin, lowOff, highOff);
@@ -1113,27 +1598,6 @@ bool readNtHeader(bounded_buffer *b, nt_header_32 &header) {
     return false;
   }
 
-  if (TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_AMD64, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_ARM, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_ARM64, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_ARMNT, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_I386, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_M32R, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_POWERPC, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_R4000, IMAGE_FILE_BYTES_REVERSED_HI) ||
-      TEST_MACHINE_CHARACTERISTICS(
-          header, IMAGE_FILE_MACHINE_WCEMIPSV2, IMAGE_FILE_BYTES_REVERSED_HI)) {
-    b->swapBytes = true;
-  }
-
   /*
    * The buffer is split using the OptionalHeader offset, even if it turns
    * out to be a PE32+. The start of the buffer is at the same spot in the
@@ -1467,247 +1931,173 @@ bool getHeader(bounded_buffer *file, pe_header &p, bounded_buffer *&rem) {
   return true;
 }
 
-bool getExports(parsed_pe *p) {
-  data_directory exportDir;
-  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    exportDir = p->peHeader.nt.OptionalHeader.DataDirectory[DIR_EXPORT];
-  } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    exportDir = p->peHeader.nt.OptionalHeader64.DataDirectory[DIR_EXPORT];
-  } else {
-    return false;
-  }
+template <typename T>
+bool getExports(parsed_pe *p, const T &optHdr) {
+  const data_directory &exportDir = optHdr.DataDirectory[DIR_EXPORT];
 
   if (exportDir.Size != 0) {
-    section s;
-    VA addr;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      addr = exportDir.VirtualAddress + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      addr =
-          exportDir.VirtualAddress + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
-      return false;
-    }
+    const std::vector<section> &secs = p->internal->secs;
+    VA addr = toVA(optHdr, exportDir.VirtualAddress);
+    const section *s = findSecForVA(secs, addr);
 
-    if (!getSecForVA(p->internal->secs, addr, s)) {
+    if (s == nullptr) {
       return false;
     }
 
-    auto rvaofft = static_cast<std::uint32_t>(addr - s.sectionBase);
+    auto rvaofft = static_cast<std::uint32_t>(addr - s->sectionBase);
+    export_dir_table edt;
+    READ_DWORD(s->sectionData, rvaofft, edt, NameRVA);
 
     // get the name of this module
-    std::uint32_t nameRva;
-    if (!readDword(s.sectionData,
-                   rvaofft + offsetof(export_dir_table, NameRVA),
-                   nameRva)) {
-      return false;
-    }
-
-    VA nameVA;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      nameVA = nameRva + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      nameVA = nameRva + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
-      return false;
-    }
-
-    section nameSec;
-    if (!getSecForVA(p->internal->secs, nameVA, nameSec)) {
+    const section *nameSec = findSecForVA(secs, toVA(optHdr, edt.NameRVA));
+    if (nameSec == nullptr) {
       return false;
     }
 
-    auto nameOff = static_cast<std::uint32_t>(nameVA - nameSec.sectionBase);
+    auto nameOff = static_cast<std::uint32_t>(toVA(optHdr, edt.NameRVA) -
+                                              nameSec->sectionBase);
     std::string modName;
-    if (!readCString(*nameSec.sectionData, nameOff, modName)) {
+    if (!readCString(*nameSec->sectionData, nameOff, modName)) {
       return false;
     }
 
-    // now, get all the named export symbols
-    std::uint32_t numNames;
-    if (!readDword(s.sectionData,
-                   rvaofft + offsetof(export_dir_table, NumberOfNamePointers),
-                   numNames)) {
+    READ_DWORD(s->sectionData, rvaofft, edt, OrdinalBase);
+    READ_DWORD(s->sectionData, rvaofft, edt, AddressTableEntries);
+    READ_DWORD(s->sectionData, rvaofft, edt, NumberOfNamePointers);
+
+    export_table &tbl = p->internal->exportTbl;
+    tbl.dirRva = exportDir.VirtualAddress;
+    tbl.dirSize = exportDir.Size;
+    tbl.ordinalBase = edt.OrdinalBase;
+    tbl.numFunctions = edt.AddressTableEntries;
+    tbl.moduleName = modName;
+
+    // Without names, the EAT is only needed by FindExportByOrdinal, so a
+    // bad EAT is not fatal here.
+    bool haveEat =
+        readDword(s->sectionData,
+                  rvaofft + offsetof(export_dir_table, ExportAddressTableRVA),
+                  edt.ExportAddressTableRVA) &&
+        tbl.eat.locate(secs, toVA(optHdr, edt.ExportAddressTableRVA));
+    if (!haveEat && edt.NumberOfNamePointers > 0) {
       return false;
     }
 
-    if (numNames > 0) {
-      // get the names section
-      std::uint32_t namesRVA;
-      if (!readDword(s.sectionData,
-                     rvaofft + offsetof(export_dir_table, NamePointerRVA),
-                     namesRVA)) {
-        return false;
-      }
+    // Read the names first, in name table order, and remember which EAT
+    // entry each one refers to. Several names may share an entry.
+    std::vector<std::string> names;
+    if (edt.NumberOfNamePointers > 0) {
+      READ_DWORD(s->sectionData, rvaofft, edt, NamePointerRVA);
+      READ_DWORD(s->sectionData, rvaofft, edt, OrdinalTableRVA);
 
-      VA namesVA;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        namesVA = namesRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        namesVA = namesRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
+      if (!tbl.names.locate(secs, toVA(optHdr, edt.NamePointerRVA)) ||
+          !tbl.ordinals.locate(secs, toVA(optHdr, edt.OrdinalTableRVA))) {
         return false;
       }
+      tbl.numNames = edt.NumberOfNamePointers;
 
-      section namesSec;
-      if (!getSecForVA(p->internal->secs, namesVA, namesSec)) {
-        return false;
-      }
+      for (std::uint32_t i = 0; i < tbl.numNames; i++) {
+        std::uint32_t curNameRVA;
+        if (!tbl.names.read(i, curNameRVA)) {
+          return false;
+        }
 
-      auto namesOff =
-          static_cast<std::uint32_t>(namesVA - namesSec.sectionBase);
+        VA curNameVA = toVA(optHdr, curNameRVA);
+        const section *curNameSec = findSecForVA(secs, curNameVA);
+        if (curNameSec == nullptr) {
+          return false;
+        }
 
-      // get the EAT section
-      std::uint32_t eatRVA;
-      if (!readDword(s.sectionData,
-                     rvaofft +
-                         offsetof(export_dir_table, ExportAddressTableRVA),
-                     eatRVA)) {
-        return false;
-      }
+        auto curNameOff =
+            static_cast<std::uint32_t>(curNameVA - curNameSec->sectionBase);
+        std::string symName;
+        if (!readCString(*curNameSec->sectionData, curNameOff, symName)) {
+          return false;
+        }
 
-      VA eatVA;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        eatVA = eatRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        eatVA = eatRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
-        return false;
-      }
+        std::uint16_t ordinal;
+        if (!tbl.ordinals.read(i, ordinal)) {
+          return false;
+        }
 
-      section eatSec;
-      if (!getSecForVA(p->internal->secs, eatVA, eatSec)) {
-        return false;
+        names.push_back(std::move(symName));
+        tbl.nameByIndex.push_back({ordinal, i});
       }
 
-      auto eatOff = static_cast<std::uint32_t>(eatVA - eatSec.sectionBase);
+      std::stable_sort(tbl.nameByIndex.begin(),
+                       tbl.nameByIndex.end(),
+                       [](const export_name &a, const export_name &b) {
+                         return a.eatIdx < b.eatIdx;
+                       });
+    }
 
-      // get the ordinal base
-      std::uint32_t ordinalBase;
-      if (!readDword(s.sectionData,
-                     rvaofft + offsetof(export_dir_table, OrdinalBase),
-                     ordinalBase)) {
-        return false;
-      }
+    /*
+     * Now make one pass over the EAT. AddressTableEntries is untrusted, so
+     * the walk is clamped to EAT_MAX_ENTRIES and to what is actually in the
+     * section, but it always covers every entry a name refers to, which
+     * the 16-bit ordinal table keeps under EAT_MAX_ENTRIES.
+     */
+    std::uint64_t count = std::min(tbl.numFunctions, EAT_MAX_ENTRIES);
+    if (!tbl.nameByIndex.empty()) {
+      count = std::max<std::uint64_t>(count,
+                                      tbl.nameByIndex.back().eatIdx + 1U);
+    }
+    if (haveEat) {
+      std::uint64_t avail =
+          (tbl.eat.buf->bufLen - std::min(tbl.eat.buf->bufLen, tbl.eat.off)) /
+          sizeof(std::uint32_t);
+      count = std::min(count, avail);
+    } else {
+      count = 0;
+    }
 
-      // get the ordinal table
-      std::uint32_t ordinalTableRVA;
-      if (!readDword(s.sectionData,
-                     rvaofft + offsetof(export_dir_table, OrdinalTableRVA),
-                     ordinalTableRVA)) {
-        return false;
-      }
+    if (!tbl.nameByIndex.empty() && tbl.nameByIndex.back().eatIdx >= count) {
+      return false;
+    }
+    tbl.numFunctions = static_cast<std::uint32_t>(count);
 
-      VA ordinalTableVA;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        ordinalTableVA =
-            ordinalTableRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        ordinalTableVA =
-            ordinalTableRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
+    auto nextName = tbl.nameByIndex.begin();
+    for (std::uint32_t idx = 0; idx < count; idx++) {
+      std::uint32_t symRVA;
+      if (!tbl.eat.read(idx, symRVA)) {
         return false;
       }
 
-      section ordinalTableSec;
-      if (!getSecForVA(p->internal->secs, ordinalTableVA, ordinalTableSec)) {
-        return false;
+      bool named = nextName != tbl.nameByIndex.end() && nextName->eatIdx == idx;
+      if (!named && symRVA == 0) {
+        continue; // unused slot
       }
 
-      auto ordinalOff = static_cast<std::uint32_t>(ordinalTableVA -
-                                                   ordinalTableSec.sectionBase);
-
-      for (std::uint32_t i = 0; i < numNames; i++) {
-        std::uint32_t curNameRVA;
-        if (!readDword(namesSec.sectionData,
-                       namesOff + (i * sizeof(std::uint32_t)),
-                       curNameRVA)) {
-          return false;
-        }
-
-        VA curNameVA;
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          curNameVA = curNameRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          curNameVA = curNameRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
-
-        section curNameSec;
-
-        if (!getSecForVA(p->internal->secs, curNameVA, curNameSec)) {
-          return false;
-        }
-
-        auto curNameOff =
-            static_cast<std::uint32_t>(curNameVA - curNameSec.sectionBase);
-        std::string symName;
-        std::uint8_t d;
+      exportent a;
+      a.eatIdx = static_cast<std::uint16_t>(idx);
+      a.moduleName = modName;
 
-        do {
-          if (!readByte(curNameSec.sectionData, curNameOff, d)) {
+      if (!tbl.isForwarded(symRVA)) {
+        a.addr = toVA(optHdr, symRVA);
+      } else {
+        VA symVA = toVA(optHdr, symRVA);
+        const section *fwdSec = findSecForVA(secs, symVA);
+        a.addr = 0;
+        if (fwdSec == nullptr ||
+            !readCString(*fwdSec->sectionData,
+                         static_cast<std::uint32_t>(symVA -
+                                                    fwdSec->sectionBase),
+                         a.forwardName)) {
+          if (named) {
             return false;
           }
-
-          if (d == 0) {
-            break;
-          }
-
-          symName.push_back(static_cast<char>(d));
-          curNameOff++;
-        } while (true);
-
-        // now, for this i, look it up in the ExportOrdinalTable
-        std::uint16_t ordinal;
-        if (!readWord(ordinalTableSec.sectionData,
-                      ordinalOff + (i * sizeof(std::uint16_t)),
-                      ordinal)) {
-          return false;
-        }
-
-        //::uint32_t  eatIdx = ordinal - ordinalBase;
-        std::uint32_t eatIdx = (ordinal * sizeof(std::uint32_t));
-
-        std::uint32_t symRVA;
-        if (!readDword(eatSec.sectionData, eatOff + eatIdx, symRVA)) {
-          return false;
-        }
-
-        bool isForwarded =
-            ((symRVA >= exportDir.VirtualAddress) &&
-             (symRVA < exportDir.VirtualAddress + exportDir.Size));
-
-        VA symVA;
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          symVA = symRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          symVA = symRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
+          continue; // a broken unnamed export is dropped, not fatal
         }
+      }
 
-        exportent a;
-        a.ordinal = ordinal;
-        a.symbolName = symName;
-        a.moduleName = modName;
-
-        if (!isForwarded) {
-          a.addr = symVA;
-          a.forwardName.clear();
-        } else {
-          section fwdSec;
-          if (!getSecForVA(p->internal->secs, symVA, fwdSec)) {
-            return false;
-          }
-          auto fwdOff = static_cast<std::uint32_t>(symVA - fwdSec.sectionBase);
-
-          a.addr = 0;
-          if (!readCString(*fwdSec.sectionData, fwdOff, a.forwardName)) {
-            return false;
-          }
-        }
+      if (!named) {
+        p->internal->exports.push_back(a);
+        continue;
+      }
 
+      for (; nextName != tbl.nameByIndex.end() && nextName->eatIdx == idx;
+           ++nextName) {
+        a.symbolName = names[nextName->nameIdx];
         p->internal->exports.push_back(a);
       }
     }
@@ -1716,28 +2106,13 @@ bool getExports(parsed_pe *p) {
   return true;
 }
 
-bool getRelocations(parsed_pe *p) {
-  data_directory relocDir;
-  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    relocDir = p->peHeader.nt.OptionalHeader.DataDirectory[DIR_BASERELOC];
-  } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    relocDir = p->peHeader.nt.OptionalHeader64.DataDirectory[DIR_BASERELOC];
-  } else {
-    return false;
-  }
+template <typename T>
+bool getRelocations(parsed_pe *p, const T &optHdr) {
+  const data_directory &relocDir = optHdr.DataDirectory[DIR_BASERELOC];
 
   if (relocDir.Size != 0) {
     section d;
-    VA vaAddr;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      vaAddr =
-          relocDir.VirtualAddress + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      vaAddr =
-          relocDir.VirtualAddress + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
-      return false;
-    }
+    VA vaAddr = toVA(optHdr, relocDir.VirtualAddress);
 
     if (!getSecForVA(p->internal->secs, vaAddr, d)) {
       return false;
@@ -1786,15 +2161,7 @@ bool getRelocations(parsed_pe *p) {
         offset = entry & static_cast<std::uint16_t>(~0xf000);
 
         // Produce the VA of the relocation
-        VA relocVA;
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          relocVA = pageRva + offset + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          relocVA =
-              pageRva + offset + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+        VA relocVA = toVA(optHdr, pageRva + offset);
 
         // Store in our list
         reloc r;
@@ -1812,28 +2179,13 @@ bool getRelocations(parsed_pe *p) {
   return true;
 }
 
-bool getDebugDir(parsed_pe *p) {
-  data_directory debugDir;
-  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    debugDir = p->peHeader.nt.OptionalHeader.DataDirectory[DIR_DEBUG];
-  } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    debugDir = p->peHeader.nt.OptionalHeader64.DataDirectory[DIR_DEBUG];
-  } else {
-    return false;
-  }
+template <typename T>
+bool getDebugDir(parsed_pe *p, const T &optHdr) {
+  const data_directory &debugDir = optHdr.DataDirectory[DIR_DEBUG];
 
   if (debugDir.Size != 0) {
     section d;
-    VA vaAddr;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      vaAddr =
-          debugDir.VirtualAddress + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      vaAddr =
-          debugDir.VirtualAddress + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
-      return false;
-    }
+    VA vaAddr = toVA(optHdr, debugDir.VirtualAddress);
 
     uint32_t numOfDebugEnts = debugDir.Size / sizeof(debug_dir_entry);
 
@@ -1873,18 +2225,7 @@ bool getDebugDir(parsed_pe *p) {
       //
       // Get the address of the data
       //
-      VA rawData;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        rawData =
-            curEnt.AddressOfRawData + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        rawData =
-            curEnt.AddressOfRawData + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
-        // Unrecognized optional header type. We can't process debug entries.
-        // Debug entries themselves are optional, so skip them.
-        break;
-      }
+      VA rawData = toVA(optHdr, curEnt.AddressOfRawData);
 
       //
       // Get the section for the data
@@ -1919,48 +2260,260 @@ bool getDebugDir(parsed_pe *p) {
   return true;
 }
 
-bool getImports(parsed_pe *p) {
-  data_directory importDir;
-  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    importDir = p->peHeader.nt.OptionalHeader.DataDirectory[DIR_IMPORT];
-  } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    importDir = p->peHeader.nt.OptionalHeader64.DataDirectory[DIR_IMPORT];
-  } else {
+/*
+ * Section lookups while walking the imports mostly land in the section of
+ * the previous lookup (the descriptors, lookup tables and hint/name entries
+ * usually all live in .idata or .rdata), so that one is checked first. If
+ * any sections overlap the cache is bypassed, since findSecForVA must then
+ * keep returning the first match.
+ */
+class section_cache {
+public:
+  explicit section_cache(const std::vector<section> &secs) : secs_(secs) {
+    for (std::size_t i = 0; i < secs.size() && usable_; i++) {
+      for (std::size_t j = i + 1; j < secs.size(); j++) {
+        if (overlaps(secs[i], secs[j])) {
+          usable_ = false;
+          break;
+        }
+      }
+    }
+  }
+
+  const section *find(VA v) {
+    if (last_ != nullptr && v >= last_->sectionBase &&
+        v < last_->sectionBase + last_->sec.Misc.VirtualSize) {
+      return last_;
+    }
+
+    const section *s = findSecForVA(secs_, v);
+    if (usable_ && s != nullptr) {
+      last_ = s;
+    }
+    return s;
+  }
+
+private:
+  static bool overlaps(const section &a, const section &b) {
+    return a.sectionBase < b.sectionBase + b.sec.Misc.VirtualSize &&
+           b.sectionBase < a.sectionBase + a.sec.Misc.VirtualSize;
+  }
+
+  const std::vector<section> &secs_;
+  const section *last_ = nullptr;
+  bool usable_ = true;
+};
+
+// ASCII upper-casing, as ::toupper does in the C locale
+static void asciiToUpper(std::string &str) {
+  std::size_t i = 0;
+  const std::size_t n = str.size();
+
+#if defined(PEPARSE_HAVE_SSE2)
+  const __m128i a = _mm_set1_epi8('a' - 1);
+  const __m128i z = _mm_set1_epi8('z' + 1);
+  const __m128i caseBit = _mm_set1_epi8(0x20);
+  for (; i + 16 <= n; i += 16) {
+    auto *ptr = reinterpret_cast<__m128i *>(&str[i]);
+    __m128i v = _mm_loadu_si128(ptr);
+    // signed compares leave bytes >= 0x80 untouched
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, a), _mm_cmplt_epi8(v, z));
+    _mm_storeu_si128(ptr, _mm_xor_si128(v, _mm_and_si128(lower, caseBit)));
+  }
+#endif
+
+  for (; i < n; i++) {
+    if (str[i] >= 'a' && str[i] <= 'z') {
+      str[i] = static_cast<char>(str[i] - 0x20);
+    }
+  }
+}
+
+// Index of the first zero thunk of the count at p, or count if there is
+// none. SSE2 checks 16 bytes at a time, and the scalar loop finishes the
+// vector that holds the terminator.
+template <typename thunk_type>
+static std::size_t findThunkTerminator(const std::uint8_t *p,
+                                       std::size_t count) {
+  std::size_t i = 0;
+
+#if defined(PEPARSE_HAVE_SSE2)
+  constexpr std::size_t perVector = 16 / sizeof(thunk_type);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + perVector <= count; i += perVector) {
+    __m128i v = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(p + i * sizeof(thunk_type)));
+    __m128i eq = _mm_cmpeq_epi32(v, zero);
+    if (sizeof(thunk_type) == sizeof(std::uint64_t)) {
+      // SSE2 has no 64-bit compare; both halves of a thunk must be zero
+      eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, 0xB1));
+    }
+    if (_mm_movemask_epi8(eq) != 0) {
+      break;
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    thunk_type val;
+    memcpy(&val, p + i * sizeof(thunk_type), sizeof(thunk_type));
+    if (val == 0) {
+      return i;
+    }
+  }
+  return count;
+}
+
+/*
+ * Reads the zero-terminated thunk array at off in one pass over the
+ * section's memory, instead of one bounds-checked read per thunk: the
+ * terminator is found first, and the thunks before it copied in bulk.
+ * Fails like readThunk would if the terminator is outside of the buffer.
+ */
+template <typename T>
+static bool readThunkArray(bounded_buffer *b,
+                           std::uint32_t off,
+                           std::vector<typename T::thunk_type> &out) {
+  typedef typename T::thunk_type thunk_type;
+  out.clear();
+
+  if (b == nullptr) {
+    PE_ERR(PEERR_BUFFER);
     return false;
   }
 
-  if (importDir.Size != 0) {
-    // get section for the RVA in importDir
-    section c;
-    VA addr;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      addr = importDir.VirtualAddress + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      addr =
-          importDir.VirtualAddress + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // big-endian hosts need each thunk byte-swapped; use the readers
+  thunk_type val;
+  for (std::uint32_t o = off;; o += sizeof(thunk_type)) {
+    if (!T::readThunk(b, o, val)) {
       return false;
     }
+    if (val == 0) {
+      return true;
+    }
+    out.push_back(val);
+  }
+#else
+  if (off < b->bufLen) {
+    const std::uint8_t *p = b->buf + off;
+    std::size_t count = (b->bufLen - off) / sizeof(thunk_type);
+    std::size_t n = findThunkTerminator<thunk_type>(p, count);
+    if (n < count) {
+      out.resize(n);
+      if (n != 0) {
+        memcpy(out.data(), p, n * sizeof(thunk_type));
+      }
+      return true;
+    }
+  }
+
+  PE_ERR(PEERR_ADDRESS);
+  return false;
+#endif
+}
+
+/*
+ * Turns one module's decoded lookup table into importents. iatRva is the
+ * module's IAT. For delay-load descriptors that are not RVA based, iatRva
+ * and the hint/name pointers in thunks are VAs instead of RVAs.
+ */
+template <typename T>
+static bool
+addImports(parsed_pe *p,
+           section_cache &secs,
+           const T &optHdr,
+           const std::string &modName,
+           const std::vector<typename optional_header_traits<T>::thunk_type>
+               &thunks,
+           std::uint32_t iatRva,
+           bool delayLoad,
+           bool rvaBased) {
+  typedef optional_header_traits<T> traits;
+  typedef typename traits::thunk_type thunk_type;
+
+  std::uint32_t offInTable = 0;
+  for (thunk_type val : thunks) {
+    importent ent;
+    ent.addr = rvaBased ? toVA(optHdr, offInTable + iatRva)
+                        : static_cast<VA>(offInTable + iatRva);
+    ent.moduleName = modName;
+    ent.byOrdinal = (val & traits::ordinal_flag) != 0;
+    ent.ordinal = 0;
+    ent.delayLoad = delayLoad;
+
+    if (!ent.byOrdinal) {
+      // import by name, skipping the hint
+      VA valVA = rvaBased ? toVA(optHdr, val) : static_cast<VA>(val);
+      const section *symNameSec = secs.find(valVA);
+
+      if (symNameSec == nullptr) {
+        return false;
+      }
+
+      std::uint32_t nameOffset =
+          static_cast<std::uint32_t>(valVA - symNameSec->sectionBase) +
+          sizeof(std::uint16_t);
+      if (symNameSec->sectionData == nullptr) {
+        PE_ERR(PEERR_BUFFER);
+        return false;
+      }
+      if (!readCString(*symNameSec->sectionData, nameOffset, ent.symbolName)) {
+        PE_ERR(PEERR_ADDRESS);
+        return false;
+      }
+    } else {
+      auto oval = static_cast<std::uint16_t>(val & 0xFFFF);
+      ent.ordinal = oval;
+      ent.symbolName = "ORDINAL_" + modName + "_" +
+                       to_string<std::uint32_t>(oval, std::dec);
+    }
+
+    // okay now we know the pair... add it
+    p->internal->imports.push_back(std::move(ent));
+
+    offInTable += sizeof(thunk_type);
+  }
+
+  return true;
+}
+
+template <typename T>
+bool getImports(parsed_pe *p, const T &optHdr) {
+  typedef optional_header_traits<T> traits;
+  typedef typename traits::thunk_type thunk_type;
 
-    if (!getSecForVA(p->internal->secs, addr, c)) {
+  const data_directory &importDir = optHdr.DataDirectory[DIR_IMPORT];
+
+  if (importDir.Size != 0) {
+    section_cache secs(p->internal->secs);
+
+    // get section for the RVA in importDir
+    VA addr = toVA(optHdr, importDir.VirtualAddress);
+    const section *c = secs.find(addr);
+
+    if (c == nullptr) {
       return false;
     }
 
     // get import directory from this section
-    auto offt = static_cast<std::uint32_t>(addr - c.sectionBase);
+    auto offt = static_cast<std::uint32_t>(addr - c->sectionBase);
 
     import_dir_entry emptyEnt;
     memset(&emptyEnt, 0, sizeof(import_dir_entry));
 
+    std::vector<thunk_type> thunks;
+
     do {
       // read each directory entry out
       import_dir_entry curEnt = emptyEnt;
 
-      READ_DWORD(c.sectionData, offt, curEnt, LookupTableRVA);
-      READ_DWORD(c.sectionData, offt, curEnt, TimeStamp);
-      READ_DWORD(c.sectionData, offt, curEnt, ForwarderChain);
-      READ_DWORD(c.sectionData, offt, curEnt, NameRVA);
-      READ_DWORD(c.sectionData, offt, curEnt, AddressRVA);
+      READ_DWORD(c->sectionData, offt, curEnt, LookupTableRVA);
+      READ_DWORD(c->sectionData, offt, curEnt, TimeStamp);
+      READ_DWORD(c->sectionData, offt, curEnt, ForwarderChain);
+      READ_DWORD(c->sectionData, offt, curEnt, NameRVA);
+      READ_DWORD(c->sectionData, offt, curEnt, AddressRVA);
 
       // are all the fields in curEnt null? then we break
       if (curEnt.LookupTableRVA == 0 && curEnt.NameRVA == 0 &&
@@ -1969,180 +2522,179 @@ bool getImports(parsed_pe *p) {
       }
 
       // then, try and get the name of this particular module...
-      VA name;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        name = curEnt.NameRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        name = curEnt.NameRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
-        return false;
-      }
+      VA name = toVA(optHdr, curEnt.NameRVA);
 
-      section nameSec;
-      if (!getSecForVA(p->internal->secs, name, nameSec)) {
+      const section *nameSec = secs.find(name);
+      if (nameSec == nullptr) {
         return false;
       }
 
-      auto nameOff = static_cast<std::uint32_t>(name - nameSec.sectionBase);
+      auto nameOff = static_cast<std::uint32_t>(name - nameSec->sectionBase);
       std::string modName;
-      if (!readCString(*nameSec.sectionData, nameOff, modName)) {
+      if (!readCString(*nameSec->sectionData, nameOff, modName)) {
         return false;
       }
 
-      // clang-format off
-      std::transform(
-        modName.begin(),
-        modName.end(),
-        modName.begin(),
-
-        [](char chr) -> char {
-          return static_cast<char>(::toupper(chr));
-        }
-      );
-      // clang-format on
+      asciiToUpper(modName);
 
       // then, try and get all of the sub-symbols
       VA lookupVA = 0;
       if (curEnt.LookupTableRVA != 0) {
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          lookupVA =
-              curEnt.LookupTableRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          lookupVA =
-              curEnt.LookupTableRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+        lookupVA = toVA(optHdr, curEnt.LookupTableRVA);
       } else if (curEnt.AddressRVA != 0) {
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          lookupVA =
-              curEnt.AddressRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          lookupVA =
-              curEnt.AddressRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+        lookupVA = toVA(optHdr, curEnt.AddressRVA);
       }
 
-      section lookupSec;
-      if (lookupVA == 0 ||
-          !getSecForVA(p->internal->secs, lookupVA, lookupSec)) {
+      const section *lookupSec = lookupVA == 0 ? nullptr : secs.find(lookupVA);
+      if (lookupSec == nullptr) {
         return false;
       }
 
       auto lookupOff =
-          static_cast<std::uint32_t>(lookupVA - lookupSec.sectionBase);
-      std::uint32_t offInTable = 0;
-      do {
-        VA valVA = 0;
-        std::uint8_t ord = 0;
-        std::uint16_t oval = 0;
-        std::uint32_t val32 = 0;
-        std::uint64_t val64 = 0;
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          if (!readDword(lookupSec.sectionData, lookupOff, val32)) {
-            return false;
-          }
-          if (val32 == 0) {
-            break;
-          }
-          ord = (val32 >> 31);
-          oval = (val32 & ~0xFFFF0000);
-          valVA = val32 + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          if (!readQword(lookupSec.sectionData, lookupOff, val64)) {
-            return false;
-          }
-          if (val64 == 0) {
-            break;
-          }
-          ord = (val64 >> 63);
-          oval = (val64 & ~0xFFFF0000);
-          valVA = val64 + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+          static_cast<std::uint32_t>(lookupVA - lookupSec->sectionBase);
+      if (!readThunkArray<traits>(lookupSec->sectionData, lookupOff, thunks)) {
+        return false;
+      }
 
-        if (ord == 0) {
-          // import by name
-          std::string symName;
-          section symNameSec;
+      if (!addImports(p,
+                      secs,
+                      optHdr,
+                      modName,
+                      thunks,
+                      curEnt.AddressRVA,
+                      false,
+                      true)) {
+        return false;
+      }
 
-          if (!getSecForVA(p->internal->secs, valVA, symNameSec)) {
-            return false;
-          }
+      offt += sizeof(import_dir_entry);
+    } while (true);
+  }
 
-          std::uint32_t nameOffset =
-              static_cast<std::uint32_t>(valVA - symNameSec.sectionBase) +
-              sizeof(std::uint16_t);
-          do {
-            std::uint8_t chr;
-            if (!readByte(symNameSec.sectionData, nameOffset, chr)) {
-              return false;
-            }
-
-            if (chr == 0) {
-              break;
-            }
-
-            symName.push_back(static_cast<char>(chr));
-            nameOffset++;
-          } while (true);
-
-          // okay now we know the pair... add it
-          importent ent;
-
-          if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader.ImageBase;
-          } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader64.ImageBase;
-          } else {
-            return false;
-          }
+  return true;
+}
 
-          ent.symbolName = symName;
-          ent.moduleName = modName;
-          p->internal->imports.push_back(ent);
-        } else {
-          std::string symName = "ORDINAL_" + modName + "_" +
-                                to_string<std::uint32_t>(oval, std::dec);
-
-          importent ent;
-
-          if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader.ImageBase;
-          } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader64.ImageBase;
-          } else {
-            return false;
-          }
+static bool readDelayImportEntry(bounded_buffer *b,
+                                 std::uint32_t o,
+                                 delay_import_dir_entry &d) {
+  READ_DWORD(b, o, d, Attributes);
+  READ_DWORD(b, o, d, NameRVA);
+  READ_DWORD(b, o, d, ModuleHandleRVA);
+  READ_DWORD(b, o, d, AddressRVA);
+  READ_DWORD(b, o, d, NameTableRVA);
+  READ_DWORD(b, o, d, BoundAddressRVA);
+  READ_DWORD(b, o, d, UnloadInformationRVA);
+  READ_DWORD(b, o, d, TimeStamp);
+
+  return true;
+}
 
-          ent.symbolName = symName;
-          ent.moduleName = modName;
+/*
+ * Delay-load imports are appended to the regular ones, flagged as such.
+ * Unlike the other directories a malformed delay-load directory does not
+ * fail the parse: the walk stops at the first descriptor that cannot be
+ * read, keeping the imports decoded so far.
+ */
+template <typename T>
+void getDelayImports(parsed_pe *p, const T &optHdr) {
+  typedef optional_header_traits<T> traits;
+  typedef typename traits::thunk_type thunk_type;
+
+  const data_directory &delayDir = optHdr.DataDirectory[DIR_DELAY_IMPORT];
+  if (delayDir.Size == 0 || delayDir.VirtualAddress == 0) {
+    return;
+  }
 
-          p->internal->imports.push_back(ent);
-        }
+  section_cache secs(p->internal->secs);
+  const section *c = secs.find(toVA(optHdr, delayDir.VirtualAddress));
+  if (c == nullptr) {
+    return;
+  }
 
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          lookupOff += sizeof(std::uint32_t);
-          offInTable += sizeof(std::uint32_t);
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          lookupOff += sizeof(std::uint64_t);
-          offInTable += sizeof(std::uint64_t);
-        } else {
-          return false;
-        }
-      } while (true);
+  auto offt = static_cast<std::uint32_t>(toVA(optHdr, delayDir.VirtualAddress) -
+                                         c->sectionBase);
+  std::vector<thunk_type> thunks;
+  // rewound if a module fails half way, so that it is all or nothing
+  std::size_t committed = p->internal->imports.size();
 
-      offt += sizeof(import_dir_entry);
-    } while (true);
+  while (true) {
+    delay_import_dir_entry d;
+    if (!readDelayImportEntry(c->sectionData, offt, d) ||
+        (d.NameRVA == 0 && d.AddressRVA == 0 && d.NameTableRVA == 0)) {
+      break;
+    }
+
+    bool rvaBased = (d.Attributes & DELAY_IMPORT_RVA_BASED) != 0;
+    auto fieldVA = [&](std::uint32_t v) {
+      return rvaBased ? toVA(optHdr, v) : static_cast<VA>(v);
+    };
+
+    const section *nameSec = secs.find(fieldVA(d.NameRVA));
+    const section *lookupSec =
+        d.NameTableRVA == 0 ? nullptr : secs.find(fieldVA(d.NameTableRVA));
+    if (nameSec == nullptr || nameSec->sectionData == nullptr ||
+        lookupSec == nullptr) {
+      break;
+    }
+
+    std::string modName;
+    if (!readCString(
+            *nameSec->sectionData,
+            static_cast<std::uint32_t>(fieldVA(d.NameRVA) -
+                                       nameSec->sectionBase),
+            modName)) {
+      break;
+    }
+    asciiToUpper(modName);
+
+    auto lookupOff = static_cast<std::uint32_t>(fieldVA(d.NameTableRVA) -
+                                                lookupSec->sectionBase);
+    if (!readThunkArray<traits>(lookupSec->sectionData, lookupOff, thunks) ||
+        !addImports(p,
+                    secs,
+                    optHdr,
+                    modName,
+                    thunks,
+                    d.AddressRVA,
+                    true,
+                    rvaBased)) {
+      p->internal->imports.resize(committed);
+      break;
+    }
+
+    committed = p->internal->imports.size();
+    offt += sizeof(delay_import_dir_entry);
+  }
+}
+
+// Walks every data directory whose layout depends on PE32 vs PE32+.
+// Called once per image with the optional header selected by its magic.
+template <typename T>
+bool getDataDirectories(parsed_pe *p, const T &optHdr) {
+  // Get exports
+  if (!getExports(p, optHdr)) {
+    PE_ERR(PEERR_MAGIC);
+    return false;
+  }
+
+  // Get relocations, if exist
+  if (!getRelocations(p, optHdr)) {
+    PE_ERR(PEERR_MAGIC);
+    return false;
+  }
+
+  if (!getDebugDir(p, optHdr)) {
+    PE_ERR(PEERR_MAGIC);
+    return false;
+  }
+
+  // Get imports
+  if (!getImports(p, optHdr)) {
+    return false;
   }
 
+  getDelayImports(p, optHdr);
+
   return true;
 }
 
@@ -2517,47 +3069,48 @@ parsed_pe *ParsePEFromBuffer(bounded_buffer *buffer) {
   }
 
   bounded_buffer *file = p->fileBuffer;
-  if (!getSections(remaining, file, p->peHeader.nt, p->internal->secs)) {
-    deleteBuffer(remaining);
-    DestructParsedPE(p);
-    PE_ERR(PEERR_SECT);
-    return nullptr;
-  }
-
-  if (!getResources(remaining, file, p->internal->secs, p->internal->rsrcs)) {
+  const nt_header_32 &nt = p->peHeader.nt;
+  bool ok = false;
+  if (!withOptionalHeader(nt, [&](const auto &optHdr) {
+        ok = getSections(
+            remaining, file, nt.FileHeader, optHdr, p->internal->secs);
+      })) {
     deleteBuffer(remaining);
     DestructParsedPE(p);
-    PE_ERR(PEERR_RESC);
+    PE_ERR(PEERR_MAGIC);
     return nullptr;
   }
-
-  // Get exports
-  if (!getExports(p)) {
+  if (!ok) {
     deleteBuffer(remaining);
     DestructParsedPE(p);
-    PE_ERR(PEERR_MAGIC);
+    PE_ERR(PEERR_SECT);
     return nullptr;
   }
 
-  // Get relocations, if exist
-  if (!getRelocations(p)) {
+  if (!getResources(remaining,
+                    file,
+                    p->internal->secs,
+                    p->internal->rsrcs,
+                    p->internal->rsrcIdx)) {
     deleteBuffer(remaining);
     DestructParsedPE(p);
-    PE_ERR(PEERR_MAGIC);
+    PE_ERR(PEERR_RESC);
     return nullptr;
   }
 
-  if (!getDebugDir(p)) {
+  // Get exports, relocations, debug directories and imports
+  if (!withOptionalHeader(nt, [&](const auto &optHdr) {
+        ok = getDataDirectories(p, optHdr);
+      })) {
     deleteBuffer(remaining);
     DestructParsedPE(p);
     PE_ERR(PEERR_MAGIC);
     return nullptr;
   }
-
-  // Get imports
-  if (!getImports(p)) {
+  if (!ok) {
     deleteBuffer(remaining);
     DestructParsedPE(p);
+    // err is set by getDataDirectories
     return nullptr;
   }
 
@@ -2637,24 +3190,920 @@ void IterImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd) {
   return;
 }
 
-// iterate over relocations in the PE file
-void IterRelocs(parsed_pe *pe, iterReloc cb, void *cbd) {
-  std::vector<reloc> &l = pe->internal->relocs;
-
-  for (reloc &r : l) {
-    if (cb(cbd, r.shiftedAddr, r.type) != 0) {
-      break;
-    }
+void IterImpRefs(parsed_pe *pe, iterImpRef cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
   }
 
-  return;
-}
-
-void IterDebugs(parsed_pe *pe, iterDebug cb, void *cbd) {
-  std::vector<debugent> &l = pe->internal->debugdirs;
+  import_ref r;
 
-  for (debugent &d : l) {
-    if (cb(cbd, d.type, d.data) != 0) {
+  for (const importent &i : pe->internal->imports) {
+    r.addr = i.addr;
+    r.moduleName = i.moduleName;
+    r.symbolName = i.symbolName;
+    r.byOrdinal = i.byOrdinal;
+    r.ordinal = i.ordinal;
+    r.delayLoad = i.delayLoad;
+    if (cb(cbd, r) != 0) {
+      break;
+    }
+  }
+}
+
+static constexpr std::uint32_t kNoImport = 0xFFFFFFFF;
+
+static void buildIATIndex(parsed_pe_internal *pint, iat_index &idx) {
+  idx.refs.reserve(pint->imports.size());
+  for (const importent &i : pint->imports) {
+    idx.refs.push_back(import_ref{i.addr,
+                                  i.moduleName,
+                                  i.symbolName,
+                                  i.byOrdinal,
+                                  i.ordinal,
+                                  i.delayLoad});
+  }
+  std::stable_sort(idx.refs.begin(),
+                   idx.refs.end(),
+                   [](const import_ref &a, const import_ref &b) {
+                     return a.addr < b.addr;
+                   });
+
+  if (idx.refs.empty()) {
+    return;
+  }
+
+  // Only worth it if the table stays within a small multiple of the number
+  // of imports
+  idx.base = idx.refs.front().addr;
+  VA span = (idx.refs.back().addr - idx.base) / 4 + 1;
+  if (span <= 4 * static_cast<VA>(idx.refs.size()) + 64) {
+    idx.dense.assign(static_cast<std::size_t>(span), kNoImport);
+    for (std::size_t i = idx.refs.size(); i-- > 0;) {
+      const import_ref &r = idx.refs[i];
+      if ((r.addr - idx.base) % 4 == 0) {
+        idx.dense[static_cast<std::size_t>((r.addr - idx.base) / 4)] =
+            static_cast<std::uint32_t>(i);
+      }
+    }
+  }
+}
+
+static const iat_index &getIATIndex(parsed_pe_internal *pint) {
+  iat_index &idx = pint->iatIdx;
+  buildOnce(idx.built, idx.lock, [&] { buildIATIndex(pint, idx); });
+  return idx;
+}
+
+static const import_ref *findInIATIndex(const iat_index &idx, VA slot) {
+  if (!idx.dense.empty()) {
+    if (slot >= idx.base && (slot - idx.base) % 4 == 0 &&
+        (slot - idx.base) / 4 < idx.dense.size()) {
+      std::uint32_t i =
+          idx.dense[static_cast<std::size_t>((slot - idx.base) / 4)];
+      if (i != kNoImport) {
+        return &idx.refs[i];
+      }
+    }
+
+    // misaligned slots are not in the dense table
+    if (slot < idx.base || (slot - idx.base) % 4 == 0) {
+      return nullptr;
+    }
+  }
+
+  auto it = std::lower_bound(
+      idx.refs.begin(),
+      idx.refs.end(),
+      slot,
+      [](const import_ref &r, VA v) { return r.addr < v; });
+  if (it == idx.refs.end() || it->addr != slot) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+const import_ref *FindImportByIAT(parsed_pe *pe, VA slot) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return nullptr;
+  }
+
+  return findInIATIndex(getIATIndex(pe->internal), slot);
+}
+
+std::size_t FindImportsByIAT(parsed_pe *pe,
+                             const std::vector<VA> &slots,
+                             std::vector<const import_ref *> &out) {
+  out.clear();
+
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return 0;
+  }
+
+  const iat_index &idx = getIATIndex(pe->internal);
+
+  out.resize(slots.size());
+  std::size_t found = 0;
+  for (std::size_t i = 0; i < slots.size(); i++) {
+    out[i] = findInIATIndex(idx, slots[i]);
+    if (out[i] != nullptr) {
+      found++;
+    }
+  }
+
+  return found;
+}
+
+/*
+ * Decodes the exception directory. x64 (and IA64) entries carry their own
+ * end address; ARM64 and ARMNT entries only have a function length, either
+ * packed into the entry or in the header of the .xdata record it points to.
+ * Entries that are out of bounds or empty are dropped rather than failing
+ * the lookup.
+ */
+template <typename T>
+static void readFunctionTable(parsed_pe *pe,
+                              const T &optHdr,
+                              std::vector<runtime_function> &out) {
+  std::uint32_t entrySize;
+  std::uint32_t lengthScale = 0; // instruction size for ARM, 0 for x64
+  switch (pe->peHeader.nt.FileHeader.Machine) {
+    case IMAGE_FILE_MACHINE_AMD64:
+    case IMAGE_FILE_MACHINE_IA64:
+      entrySize = 12;
+      break;
+    case IMAGE_FILE_MACHINE_ARM64:
+      entrySize = 8;
+      lengthScale = 4;
+      break;
+    case IMAGE_FILE_MACHINE_ARMNT:
+      entrySize = 8;
+      lengthScale = 2;
+      break;
+    default:
+      return;
+  }
+
+  const data_directory &dir = optHdr.DataDirectory[DIR_EXCEPTION];
+  section_cache secs(pe->internal->secs);
+  const section *s = secs.find(toVA(optHdr, dir.VirtualAddress));
+  if (dir.Size < entrySize || s == nullptr || s->sectionData == nullptr) {
+    return;
+  }
+
+  bounded_buffer *b = s->sectionData;
+  auto off = static_cast<std::uint32_t>(toVA(optHdr, dir.VirtualAddress) -
+                                        s->sectionBase);
+  if (off >= b->bufLen) {
+    return;
+  }
+  std::uint32_t count = std::min(dir.Size, b->bufLen - off) / entrySize;
+  out.reserve(count);
+
+  for (std::uint32_t i = 0; i < count; i++) {
+    std::uint32_t o = off + i * entrySize;
+    runtime_function f;
+    std::uint32_t second;
+    if (!readDword(b, o, f.begin) || !readDword(b, o + 4, second)) {
+      break;
+    }
+
+    std::uint64_t end;
+    if (lengthScale == 0) {
+      if (!readDword(b, o + 8, f.unwindData)) {
+        break;
+      }
+      end = second;
+    } else {
+      // ARMNT sets the Thumb bit in the start address
+      if (lengthScale == 2) {
+        f.begin &= ~1u;
+      }
+      f.unwindData = second;
+
+      std::uint32_t length;
+      if ((second & 3) != 0) {
+        length = (second >> 2) & 0x7FF;
+      } else {
+        std::uint32_t xdata;
+        const section *x = secs.find(toVA(optHdr, second));
+        if (x == nullptr ||
+            !readDword(x->sectionData,
+                       static_cast<std::uint32_t>(toVA(optHdr, second) -
+                                                  x->sectionBase),
+                       xdata)) {
+          continue;
+        }
+        length = xdata & 0x3FFFF;
+      }
+      end = static_cast<std::uint64_t>(f.begin) + length * lengthScale;
+    }
+
+    if (end <= f.begin || end > 0xFFFFFFFF) {
+      continue;
+    }
+    f.end = static_cast<RVA>(end);
+    out.push_back(f);
+  }
+
+  // the table is sorted in any image the loader accepts
+  auto byBegin = [](const runtime_function &a, const runtime_function &c) {
+    return a.begin < c.begin;
+  };
+  if (!std::is_sorted(out.begin(), out.end(), byBegin)) {
+    std::stable_sort(out.begin(), out.end(), byBegin);
+  }
+}
+
+static const std::vector<runtime_function> &getFunctions(parsed_pe *pe) {
+  function_table &tbl = pe->internal->funcTbl;
+  buildOnce(tbl.built, tbl.lock, [&] {
+    withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+      readFunctionTable(pe, optHdr, tbl.funcs);
+    });
+  });
+  return tbl.funcs;
+}
+
+// Finds the function containing rva. The search for the first function
+// that begins after rva starts at from, which is advanced to it, so that
+// ascending lookups can pass the previous value along.
+static const runtime_function *
+findFunction(const std::vector<runtime_function> &funcs,
+             std::size_t &from,
+             RVA rva) {
+  auto it = std::upper_bound(
+      funcs.begin() + static_cast<std::ptrdiff_t>(from),
+      funcs.end(),
+      rva,
+      [](RVA v, const runtime_function &f) { return v < f.begin; });
+  from = static_cast<std::size_t>(it - funcs.begin());
+
+  if (it == funcs.begin() || rva >= std::prev(it)->end) {
+    return nullptr;
+  }
+  return &*std::prev(it);
+}
+
+const runtime_function *FindFunctionForRva(parsed_pe *pe, RVA rva) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return nullptr;
+  }
+
+  std::size_t from = 0;
+  return findFunction(getFunctions(pe), from, rva);
+}
+
+std::size_t FindFunctionsForRvas(parsed_pe *pe,
+                                 const std::vector<RVA> &rvas,
+                                 std::vector<const runtime_function *> &out) {
+  out.clear();
+
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return 0;
+  }
+
+  const std::vector<runtime_function> &funcs = getFunctions(pe);
+  bool sorted = std::is_sorted(rvas.begin(), rvas.end());
+
+  out.resize(rvas.size());
+  std::size_t found = 0;
+  std::size_t from = 0;
+  for (std::size_t i = 0; i < rvas.size(); i++) {
+    // ascending input lets each search start where the previous one ended
+    if (!sorted) {
+      from = 0;
+    }
+    out[i] = findFunction(funcs, from, rvas[i]);
+    if (out[i] != nullptr) {
+      found++;
+    }
+  }
+
+  return found;
+}
+
+void IterFunctions(parsed_pe *pe, iterFunc cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  for (const runtime_function &f : getFunctions(pe)) {
+    if (cb(cbd, f) != 0) {
+      break;
+    }
+  }
+}
+
+static void buildSymbolIndex(parsed_pe *pe, symbol_index &idx) {
+  std::vector<symbol_entry> all;
+  VA imageBase = rvaToVA(pe, 0);
+
+  const export_table &tbl = pe->internal->exportTbl;
+  for (const exportent &e : pe->internal->exports) {
+    if (e.forwardName.empty()) {
+      all.push_back(symbol_entry{
+          e.addr,
+          0,
+          e.symbolName.empty()
+              ? "#" + to_string<std::uint32_t>(tbl.ordinalBase + e.eatIdx,
+                                               std::dec)
+              : e.symbolName,
+          symbol_source::exports});
+    }
+  }
+
+  const std::vector<section> &secs = pe->internal->secs;
+  for (const symbol &sym : pe->internal->symbols) {
+    // section symbols are static and carry a section definition record
+    bool sectionSym = sym.storageClass == IMAGE_SYM_CLASS_STATIC &&
+                      sym.numberOfAuxSymbols != 0;
+    if (sym.sectionNumber <= 0 ||
+        static_cast<std::size_t>(sym.sectionNumber) > secs.size() ||
+        sectionSym ||
+        (sym.storageClass != IMAGE_SYM_CLASS_EXTERNAL &&
+         sym.storageClass != IMAGE_SYM_CLASS_STATIC &&
+         sym.storageClass != IMAGE_SYM_CLASS_LABEL)) {
+      continue;
+    }
+
+    const section &sec = secs[static_cast<std::size_t>(sym.sectionNumber - 1)];
+    all.push_back(symbol_entry{sec.sectionBase + sym.value,
+                               0,
+                               sym.strName,
+                               symbol_source::coff});
+  }
+
+  VA entry;
+  if (GetEntryPoint(pe, entry) && entry != imageBase) {
+    all.push_back(symbol_entry{entry, 0, "EntryPoint", symbol_source::entry});
+  }
+
+  for (const runtime_function &f : getFunctions(pe)) {
+    all.push_back(symbol_entry{
+        rvaToVA(pe, f.begin), f.end - f.begin, "", symbol_source::function});
+  }
+
+  // symbol_source is ordered by precedence, so at equal addresses the
+  // preferred name sorts first
+  std::stable_sort(all.begin(),
+                   all.end(),
+                   [](const symbol_entry &a, const symbol_entry &b) {
+                     return a.addr < b.addr ||
+                            (a.addr == b.addr && a.source < b.source);
+                   });
+
+  section_cache cache(secs);
+  for (std::size_t i = 0; i < all.size(); i++) {
+    symbol_entry &cur = all[i];
+
+    // merge symbols at the same address: the first name, the largest size
+    std::size_t j = i + 1;
+    for (; j < all.size() && all[j].addr == cur.addr; j++) {
+      if (cur.name.empty()) {
+        cur.name = all[j].name;
+      }
+      cur.size = std::max(cur.size, all[j].size);
+    }
+
+    const section *sec = cache.find(cur.addr);
+    if (sec != nullptr) {
+      VA secEnd = sec->sectionBase + sec->sec.Misc.VirtualSize;
+      idx.limits.push_back(cur.size != 0 ? std::min(cur.addr + cur.size, secEnd)
+                                         : secEnd);
+      idx.syms.push_back(std::move(cur));
+    }
+
+    i = j - 1;
+  }
+}
+
+static const symbol_index &getSymbolIndex(parsed_pe *pe) {
+  symbol_index &idx = pe->internal->symIdx;
+  buildOnce(idx.built, idx.lock, [&] { buildSymbolIndex(pe, idx); });
+  return idx;
+}
+
+static const symbol_entry *
+findSymbol(const symbol_index &idx, std::size_t &from, VA va, VA &offset) {
+  auto it = std::upper_bound(
+      idx.syms.begin() + static_cast<std::ptrdiff_t>(from),
+      idx.syms.end(),
+      va,
+      [](VA v, const symbol_entry &e) { return v < e.addr; });
+  from = static_cast<std::size_t>(it - idx.syms.begin());
+
+  if (it == idx.syms.begin()) {
+    return nullptr;
+  }
+
+  std::size_t i = from - 1;
+  if (va >= idx.limits[i]) {
+    return nullptr;
+  }
+
+  offset = va - idx.syms[i].addr;
+  return &idx.syms[i];
+}
+
+const symbol_entry *Symbolize(parsed_pe *pe, VA va, VA &offset) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return nullptr;
+  }
+
+  std::size_t from = 0;
+  return findSymbol(getSymbolIndex(pe), from, va, offset);
+}
+
+std::size_t SymbolizeSorted(parsed_pe *pe,
+                            const std::vector<VA> &vas,
+                            std::vector<const symbol_entry *> &out,
+                            std::vector<VA> &offsets) {
+  out.clear();
+  offsets.clear();
+
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return 0;
+  }
+
+  const symbol_index &idx = getSymbolIndex(pe);
+  bool sorted = std::is_sorted(vas.begin(), vas.end());
+
+  out.resize(vas.size());
+  offsets.assign(vas.size(), 0);
+  std::size_t found = 0;
+  std::size_t from = 0;
+  for (std::size_t i = 0; i < vas.size(); i++) {
+    if (!sorted) {
+      from = 0;
+    }
+    out[i] = findSymbol(idx, from, vas[i], offsets[i]);
+    if (out[i] != nullptr) {
+      found++;
+    }
+  }
+
+  return found;
+}
+
+// The load config fields that have the same name in the 32 and 64-bit
+// layouts, which is all of them but CodeIntegrity
+#define LOAD_CONFIG_FIELDS(F)                 \
+  F(Size)                                     \
+  F(TimeDateStamp)                            \
+  F(MajorVersion)                             \
+  F(MinorVersion)                             \
+  F(GlobalFlagsClear)                         \
+  F(GlobalFlagsSet)                           \
+  F(CriticalSectionDefaultTimeout)            \
+  F(DeCommitFreeBlockThreshold)               \
+  F(DeCommitTotalFreeThreshold)               \
+  F(LockPrefixTable)                          \
+  F(MaximumAllocationSize)                    \
+  F(VirtualMemoryThreshold)                   \
+  F(ProcessAffinityMask)                      \
+  F(ProcessHeapFlags)                         \
+  F(CSDVersion)                               \
+  F(DependentLoadFlags)                       \
+  F(EditList)                                 \
+  F(SecurityCookie)                           \
+  F(SEHandlerTable)                           \
+  F(SEHandlerCount)                           \
+  F(GuardCFCheckFunctionPointer)              \
+  F(GuardCFDispatchFunctionPointer)           \
+  F(GuardCFFunctionTable)                     \
+  F(GuardCFFunctionCount)                     \
+  F(GuardFlags)                               \
+  F(GuardAddressTakenIatEntryTable)           \
+  F(GuardAddressTakenIatEntryCount)           \
+  F(GuardLongJumpTargetTable)                 \
+  F(GuardLongJumpTargetCount)                 \
+  F(DynamicValueRelocTable)                   \
+  F(CHPEMetadataPointer)                      \
+  F(GuardRFFailureRoutine)                    \
+  F(GuardRFFailureRoutineFunctionPointer)     \
+  F(DynamicValueRelocTableOffset)             \
+  F(DynamicValueRelocTableSection)            \
+  F(Reserved2)                                \
+  F(GuardRFVerifyStackPointerFunctionPointer) \
+  F(HotPatchTableOffset)                      \
+  F(Reserved3)                                \
+  F(EnclaveConfigurationPointer)              \
+  F(VolatileMetadataPointer)
+
+// The structures are read field by field at their offsetof, which must
+// match the on-disk layout
+static_assert(offsetof(image_load_config_32, VolatileMetadataPointer) == 0xA0,
+              "image_load_config_32 layout");
+static_assert(offsetof(image_load_config_64, VolatileMetadataPointer) == 0x100,
+              "image_load_config_64 layout");
+
+// Reads one field of a structure at off, unless it lies past limit, the
+// number of bytes of the structure present in the image
+template <typename V>
+static void readFieldWithin(bounded_buffer *b,
+                            std::uint32_t off,
+                            std::uint32_t limit,
+                            std::size_t fieldOff,
+                            V &out) {
+  if (fieldOff + sizeof(V) > limit) {
+    return;
+  }
+
+  auto at = off + static_cast<std::uint32_t>(fieldOff);
+  if constexpr (sizeof(V) == sizeof(std::uint16_t)) {
+    readWord(b, at, out);
+  } else if constexpr (sizeof(V) == sizeof(std::uint32_t)) {
+    readDword(b, at, out);
+  } else {
+    readQword(b, at, out);
+  }
+}
+
+/*
+ * Reads the load config at off in b. Older linkers emit shorter versions of
+ * the structure, so only the fields within its Size are read and the rest
+ * are left zero. Returns false if not even Size can be read.
+ */
+template <typename T>
+static bool readLoadConfig(bounded_buffer *b, std::uint32_t off, T &cfg) {
+  std::memset(&cfg, 0, sizeof(T));
+  if (!readDword(b, off, cfg.Size)) {
+    return false;
+  }
+  std::uint32_t limit = std::min(cfg.Size, b->bufLen - off);
+
+#define READ_LOAD_CONFIG_FIELD(m) \
+  readFieldWithin(b, off, limit, offsetof(T, m), cfg.m);
+  LOAD_CONFIG_FIELDS(READ_LOAD_CONFIG_FIELD)
+  READ_LOAD_CONFIG_FIELD(CodeIntegrity.Flags)
+  READ_LOAD_CONFIG_FIELD(CodeIntegrity.Catalog)
+  READ_LOAD_CONFIG_FIELD(CodeIntegrity.CatalogOffset)
+  READ_LOAD_CONFIG_FIELD(CodeIntegrity.Reserved)
+#undef READ_LOAD_CONFIG_FIELD
+
+  return true;
+}
+
+static void widenLoadConfig(const image_load_config_32 &in,
+                            image_load_config_64 &out) {
+#define WIDEN_LOAD_CONFIG_FIELD(m) out.m = in.m;
+  LOAD_CONFIG_FIELDS(WIDEN_LOAD_CONFIG_FIELD)
+#undef WIDEN_LOAD_CONFIG_FIELD
+  out.CodeIntegrity = in.CodeIntegrity;
+}
+
+static void widenLoadConfig(const image_load_config_64 &in,
+                            image_load_config_64 &out) {
+  out = in;
+}
+
+constexpr std::uint32_t RVA_SET_PAGE_SHIFT = 12;
+
+void rva_set::index() {
+  pages.clear();
+  if (rvas.empty()) {
+    return;
+  }
+
+  base = rvas.front();
+  std::size_t count = ((rvas.back() - base) >> RVA_SET_PAGE_SHIFT) + 1;
+  if (count > 4 * rvas.size()) {
+    return;
+  }
+
+  pages.resize(count + 1);
+  std::size_t i = 0;
+  for (std::size_t page = 0; page <= count; page++) {
+    while (i < rvas.size() &&
+           ((rvas[i] - base) >> RVA_SET_PAGE_SHIFT) < page) {
+      i++;
+    }
+    pages[page] = static_cast<std::uint32_t>(i);
+  }
+}
+
+std::size_t rva_set::find(RVA rva) const {
+  auto first = rvas.begin();
+  auto last = rvas.end();
+  if (!pages.empty()) {
+    std::size_t page = (rva - base) >> RVA_SET_PAGE_SHIFT;
+    if (rva < base || page + 1 >= pages.size()) {
+      return rvas.size();
+    }
+    first = rvas.begin() + pages[page];
+    last = rvas.begin() + pages[page + 1];
+  }
+
+  auto it = std::lower_bound(first, last, rva);
+  if (it == last || *it != rva) {
+    return rvas.size();
+  }
+  return static_cast<std::size_t>(it - rvas.begin());
+}
+
+/*
+ * Reads count entries of a guard table at va, each an RVA followed by
+ * stride - 4 bytes of metadata, of which the first is kept. A table that
+ * runs past the end of its section is truncated. The result is sorted by
+ * RVA, which linkers already guarantee.
+ */
+static void readGuardTable(section_cache &secs,
+                           VA va,
+                           std::uint64_t count,
+                           std::uint32_t stride,
+                           rva_set &rvas,
+                           std::vector<std::uint8_t> *flags) {
+  const section *s = secs.find(va);
+  if (va == 0 || count == 0 || s == nullptr || s->sectionData == nullptr) {
+    return;
+  }
+
+  bounded_buffer *b = s->sectionData;
+  auto off = static_cast<std::uint32_t>(va - s->sectionBase);
+  if (off >= b->bufLen) {
+    return;
+  }
+  count = std::min<std::uint64_t>(count, (b->bufLen - off) / stride);
+
+  std::vector<std::pair<RVA, std::uint8_t>> entries;
+  entries.reserve(static_cast<std::size_t>(count));
+  for (std::uint64_t i = 0; i < count; i++) {
+    auto o = static_cast<std::uint32_t>(off + i * stride);
+    std::pair<RVA, std::uint8_t> e{0, 0};
+    if (!readDword(b, o, e.first) ||
+        (stride > 4 && !readByte(b, o + 4, e.second))) {
+      break;
+    }
+    entries.push_back(e);
+  }
+
+  auto byRva = [](const std::pair<RVA, std::uint8_t> &a,
+                  const std::pair<RVA, std::uint8_t> &c) {
+    return a.first < c.first;
+  };
+  if (!std::is_sorted(entries.begin(), entries.end(), byRva)) {
+    std::stable_sort(entries.begin(), entries.end(), byRva);
+  }
+
+  rvas.rvas.reserve(entries.size());
+  for (const auto &e : entries) {
+    rvas.rvas.push_back(e.first);
+  }
+  rvas.index();
+  if (flags != nullptr) {
+    flags->reserve(entries.size());
+    for (const auto &e : entries) {
+      flags->push_back(e.second);
+    }
+  }
+}
+
+static void readLoadConfigInfo(parsed_pe *pe, load_config_info &info) {
+  section_cache secs(pe->internal->secs);
+
+  withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+    const data_directory &dir = optHdr.DataDirectory[DIR_LOAD_CONFIG];
+
+    VA va = toVA(optHdr, dir.VirtualAddress);
+    const section *s = secs.find(va);
+    if (dir.VirtualAddress == 0 || s == nullptr ||
+        s->sectionData == nullptr) {
+      return;
+    }
+
+    typename optional_header_traits<
+        std::decay_t<decltype(optHdr)>>::load_config_type cfg;
+    if (readLoadConfig(s->sectionData,
+                       static_cast<std::uint32_t>(va - s->sectionBase),
+                       cfg)) {
+      widenLoadConfig(cfg, info.cfg);
+      info.present = true;
+    }
+  });
+
+  if (!info.present) {
+    return;
+  }
+
+  const image_load_config_64 &cfg = info.cfg;
+  std::uint32_t stride = 4 + ((cfg.GuardFlags &
+                               IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK) >>
+                              IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT);
+  readGuardTable(secs,
+                 cfg.GuardCFFunctionTable,
+                 cfg.GuardCFFunctionCount,
+                 stride,
+                 info.cfTargets,
+                 &info.cfFlags);
+  readGuardTable(secs,
+                 cfg.SEHandlerTable,
+                 cfg.SEHandlerCount,
+                 4,
+                 info.sehHandlers,
+                 nullptr);
+}
+
+static const load_config_info &getLoadConfigInfo(parsed_pe *pe) {
+  load_config_info &info = pe->internal->loadCfg;
+  buildOnce(info.built, info.lock, [&] { readLoadConfigInfo(pe, info); });
+  return info;
+}
+
+bool GetLoadConfig(parsed_pe *pe, image_load_config_64 &out) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const load_config_info &info = getLoadConfigInfo(pe);
+  if (!info.present) {
+    return false;
+  }
+
+  out = info.cfg;
+  return true;
+}
+
+bool GetSecurityCookie(parsed_pe *pe, VA &cookie) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const load_config_info &info = getLoadConfigInfo(pe);
+  if (!info.present || info.cfg.SecurityCookie == 0) {
+    return false;
+  }
+
+  cookie = info.cfg.SecurityCookie;
+  return true;
+}
+
+bool FindGuardCFFunction(parsed_pe *pe, RVA rva, std::uint8_t &flags) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const load_config_info &info = getLoadConfigInfo(pe);
+  std::size_t i = info.cfTargets.find(rva);
+  if (i == info.cfTargets.rvas.size()) {
+    return false;
+  }
+
+  flags = info.cfFlags[i];
+  return true;
+}
+
+bool IsCFGTarget(parsed_pe *pe, RVA rva) {
+  std::uint8_t flags;
+  return FindGuardCFFunction(pe, rva, flags) &&
+         (flags & IMAGE_GUARD_FLAG_FID_SUPPRESSED) == 0;
+}
+
+void IterGuardCFFunctions(parsed_pe *pe, iterGuardCF cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  const load_config_info &info = getLoadConfigInfo(pe);
+  for (std::size_t i = 0; i < info.cfTargets.rvas.size(); i++) {
+    if (cb(cbd, info.cfTargets.rvas[i], info.cfFlags[i]) != 0) {
+      break;
+    }
+  }
+}
+
+bool IsSEHandler(parsed_pe *pe, RVA rva) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const rva_set &handlers = getLoadConfigInfo(pe).sehHandlers;
+  return handlers.find(rva) != handlers.rvas.size();
+}
+
+void IterSEHandlers(parsed_pe *pe, iterRVA cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  for (RVA rva : getLoadConfigInfo(pe).sehHandlers.rvas) {
+    if (cb(cbd, rva) != 0) {
+      break;
+    }
+  }
+}
+
+// Decodes the TLS directory, in the layout optHdr selects, into out
+template <typename T>
+static bool readTlsDirectory(parsed_pe *pe,
+                             const T &optHdr,
+                             image_tls_directory_64 &out) {
+  const data_directory &dir = optHdr.DataDirectory[DIR_TLS];
+  VA va = toVA(optHdr, dir.VirtualAddress);
+  const section *s = findSecForVA(pe->internal->secs, va);
+  if (dir.VirtualAddress == 0 || s == nullptr || s->sectionData == nullptr) {
+    return false;
+  }
+
+  typename optional_header_traits<T>::tls_directory_type tls;
+  bounded_buffer *b = s->sectionData;
+  auto off = static_cast<std::uint32_t>(va - s->sectionBase);
+  if (off >= b->bufLen || b->bufLen - off < sizeof(tls)) {
+    return false;
+  }
+
+#define READ_TLS_FIELD(m)                                                  \
+  readFieldWithin(b, off, sizeof(tls), offsetof(decltype(tls), m), tls.m); \
+  out.m = tls.m;
+  READ_TLS_FIELD(StartAddressOfRawData)
+  READ_TLS_FIELD(EndAddressOfRawData)
+  READ_TLS_FIELD(AddressOfIndex)
+  READ_TLS_FIELD(AddressOfCallBacks)
+  READ_TLS_FIELD(SizeOfZeroFill)
+  READ_TLS_FIELD(Characteristics)
+#undef READ_TLS_FIELD
+
+  return true;
+}
+
+bool GetTlsDirectory(parsed_pe *pe, image_tls_directory_64 &out) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  bool found = false;
+  withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+    found = readTlsDirectory(pe, optHdr, out);
+  });
+  return found;
+}
+
+void IterTlsCallbacks(parsed_pe *pe, iterVA cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+    using traits = optional_header_traits<std::decay_t<decltype(optHdr)>>;
+
+    image_tls_directory_64 tls;
+    if (!readTlsDirectory(pe, optHdr, tls) || tls.AddressOfCallBacks == 0) {
+      return;
+    }
+
+    // the array is usually in .rdata, but may be anywhere in the image
+    const section *s = findSecForVA(pe->internal->secs, tls.AddressOfCallBacks);
+    if (s == nullptr || s->sectionData == nullptr) {
+      return;
+    }
+
+    std::uint64_t at = tls.AddressOfCallBacks - s->sectionBase;
+    for (std::uint32_t i = 0; i < TLS_MAX_CALLBACKS; i++) {
+      typename traits::thunk_type callback;
+      if (at > UINT32_MAX ||
+          !traits::readThunk(
+              s->sectionData, static_cast<std::uint32_t>(at), callback) ||
+          callback == 0 || cb(cbd, callback) != 0) {
+        return;
+      }
+      at += sizeof(callback);
+    }
+  });
+}
+
+// iterate over relocations in the PE file
+void IterRelocs(parsed_pe *pe, iterReloc cb, void *cbd) {
+  std::vector<reloc> &l = pe->internal->relocs;
+
+  for (reloc &r : l) {
+    if (cb(cbd, r.shiftedAddr, r.type) != 0) {
+      break;
+    }
+  }
+
+  return;
+}
+
+void IterDebugs(parsed_pe *pe, iterDebug cb, void *cbd) {
+  std::vector<debugent> &l = pe->internal->debugdirs;
+
+  for (debugent &d : l) {
+    if (cb(cbd, d.type, d.data) != 0) {
       break;
     }
   }
@@ -2700,13 +4149,169 @@ void IterExpFull(parsed_pe *pe, iterExpFull cb, void *cbd) {
   std::vector<exportent> &l = pe->internal->exports;
 
   for (exportent &i : l) {
-    if (cb(cbd, i.addr, i.ordinal, i.moduleName, i.symbolName, i.forwardName) !=
+    if (cb(cbd, i.addr, i.eatIdx, i.moduleName, i.symbolName, i.forwardName) !=
         0) {
       break;
     }
   }
 
-  return;
+  return;
+}
+
+void IterExpRefs(parsed_pe *pe, iterExpRef cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  const export_table &tbl = pe->internal->exportTbl;
+  export_ref r;
+
+  for (const exportent &e : pe->internal->exports) {
+    r.addr = e.addr;
+    r.ordinal = tbl.ordinalBase + e.eatIdx;
+    r.symbolName = e.symbolName;
+    r.moduleName = e.moduleName;
+    r.forwardName = e.forwardName;
+    if (cb(cbd, r) != 0) {
+      break;
+    }
+  }
+}
+
+// Compares the NUL-terminated string at VA v with s, like strcmp. Returns
+// false if v is unmapped or the string runs off the end of its section.
+static bool
+compareCStringAtVA(parsed_pe *pe, VA v, const std::string &s, int &cmp) {
+  const section *sec = findSecForVA(pe->internal->secs, v);
+  if (sec == nullptr) {
+    return false;
+  }
+
+  const bounded_buffer *b = sec->sectionData;
+  auto off = static_cast<std::uint64_t>(v - sec->sectionBase);
+  for (std::size_t i = 0;; i++) {
+    if (off + i >= b->bufLen) {
+      return false;
+    }
+
+    std::uint8_t c = b->buf[off + i];
+    std::uint8_t want =
+        i < s.size() ? static_cast<std::uint8_t>(s[i]) : std::uint8_t{0};
+    if (c != want || c == 0) {
+      cmp = static_cast<int>(c) - static_cast<int>(want);
+      return true;
+    }
+  }
+}
+
+// Fills out from the EAT entry at eatIdx; callers set symbolName
+static bool readExport(parsed_pe *pe,
+                       std::uint32_t eatIdx,
+                       export_ref &out) {
+  const export_table &tbl = pe->internal->exportTbl;
+
+  std::uint32_t rva;
+  if (eatIdx >= tbl.numFunctions || !tbl.eat.read(eatIdx, rva) || rva == 0) {
+    return false;
+  }
+
+  out.ordinal = tbl.ordinalBase + eatIdx;
+  out.moduleName = tbl.moduleName;
+  out.forwardName.clear();
+
+  if (!tbl.isForwarded(rva)) {
+    out.addr = rvaToVA(pe, rva);
+    return true;
+  }
+
+  out.addr = 0;
+  VA v = rvaToVA(pe, rva);
+  const section *sec = findSecForVA(pe->internal->secs, v);
+  return sec != nullptr &&
+         readCString(*sec->sectionData,
+                     static_cast<std::uint32_t>(v - sec->sectionBase),
+                     out.forwardName);
+}
+
+bool FindExportByName(parsed_pe *pe,
+                      const std::string &name,
+                      export_ref &out) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const export_table &tbl = pe->internal->exportTbl;
+
+  // The name pointer table is sorted lexically, which the loader relies on
+  // for its own binary search
+  std::uint32_t lo = 0;
+  std::uint32_t hi = tbl.numNames;
+  while (lo < hi) {
+    std::uint32_t mid = lo + (hi - lo) / 2;
+    std::uint32_t nameRva;
+    int cmp;
+    if (!tbl.names.read(mid, nameRva) ||
+        !compareCStringAtVA(pe, rvaToVA(pe, nameRva), name, cmp)) {
+      return false;
+    }
+
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else if (cmp > 0) {
+      hi = mid;
+    } else {
+      std::uint16_t eatIdx;
+      if (!tbl.ordinals.read(mid, eatIdx) || !readExport(pe, eatIdx, out)) {
+        return false;
+      }
+
+      out.symbolName = name;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool FindExportByOrdinal(parsed_pe *pe,
+                         std::uint32_t ordinal,
+                         export_ref &out) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const export_table &tbl = pe->internal->exportTbl;
+  if (ordinal < tbl.ordinalBase ||
+      !readExport(pe, ordinal - tbl.ordinalBase, out)) {
+    return false;
+  }
+
+  // Find the first name, if any, that refers to this EAT entry
+  out.symbolName.clear();
+  std::uint32_t eatIdx = ordinal - tbl.ordinalBase;
+  auto it = std::lower_bound(tbl.nameByIndex.begin(),
+                             tbl.nameByIndex.end(),
+                             eatIdx,
+                             [](const export_name &n, std::uint32_t idx) {
+                               return n.eatIdx < idx;
+                             });
+  if (it != tbl.nameByIndex.end() && it->eatIdx == eatIdx) {
+    std::uint32_t nameRva;
+    if (tbl.names.read(it->nameIdx, nameRva)) {
+      VA v = rvaToVA(pe, nameRva);
+      const section *sec = findSecForVA(pe->internal->secs, v);
+      if (sec != nullptr) {
+        readCString(*sec->sectionData,
+                    static_cast<std::uint32_t>(v - sec->sectionBase),
+                    out.symbolName);
+      }
+    }
+  }
+
+  return true;
 }
 
 // iterate over sections
@@ -2738,15 +4343,9 @@ bool ReadByteAtVA(parsed_pe *pe, VA v, std::uint8_t &b) {
 bool GetEntryPoint(parsed_pe *pe, VA &v) {
 
   if (pe != nullptr) {
-    nt_header_32 *nthdr = &pe->peHeader.nt;
-
-    if (nthdr->OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      v = nthdr->OptionalHeader.AddressOfEntryPoint +
-          nthdr->OptionalHeader.ImageBase;
-    } else if (nthdr->OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      v = nthdr->OptionalHeader64.AddressOfEntryPoint +
-          nthdr->OptionalHeader64.ImageBase;
-    } else {
+    if (!withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+          v = toVA(optHdr, optHdr.AddressOfEntryPoint);
+        })) {
       PE_ERR(PEERR_MAGIC);
       return false;
     }
@@ -2784,11 +4383,9 @@ const char *GetSubsystemAsString(parsed_pe *pe) {
     return nullptr;
 
   std::uint16_t subsystem;
-  if (pe->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC)
-    subsystem = pe->peHeader.nt.OptionalHeader.Subsystem;
-  else if (pe->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC)
-    subsystem = pe->peHeader.nt.OptionalHeader64.Subsystem;
-  else
+  if (!withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+        subsystem = optHdr.Subsystem;
+      }))
     return nullptr;
 
   switch (subsystem) {
@@ -2839,13 +4436,10 @@ bool GetDataDirectoryEntry(parsed_pe *pe,
 
   data_directory dir;
   VA addr;
-  if (pe->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    dir = pe->peHeader.nt.OptionalHeader.DataDirectory[dirnum];
-    addr = dir.VirtualAddress + pe->peHeader.nt.OptionalHeader.ImageBase;
-  } else if (pe->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    dir = pe->peHeader.nt.OptionalHeader64.DataDirectory[dirnum];
-    addr = dir.VirtualAddress + pe->peHeader.nt.OptionalHeader64.ImageBase;
-  } else {
+  if (!withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+        dir = optHdr.DataDirectory[dirnum];
+        addr = toVA(optHdr, dir.VirtualAddress);
+      })) {
     PE_ERR(PEERR_MAGIC);
     return false;
   }
@@ -2862,15 +4456,15 @@ bool GetDataDirectoryEntry(parsed_pe *pe,
    * https://docs.microsoft.com/en-us/windows/win32/debug/pe-format#the-attribute-certificate-table-image-only
    */
   if (dirnum == DIR_SECURITY) {
-    auto *buf = splitBuffer(
-        pe->fileBuffer, dir.VirtualAddress, dir.VirtualAddress + dir.Size);
-    if (buf == nullptr) {
+    std::uint64_t end =
+        static_cast<std::uint64_t>(dir.VirtualAddress) + dir.Size;
+    if (end > pe->fileBuffer->bufLen) {
       PE_ERR(PEERR_SIZE);
       return false;
     }
 
-    raw_entry.assign(buf->buf, buf->buf + buf->bufLen);
-    deleteBuffer(buf);
+    raw_entry.assign(pe->fileBuffer->buf + dir.VirtualAddress,
+                     pe->fileBuffer->buf + end);
   } else {
     section sec;
     if (!getSecForVA(pe->internal->secs, addr, sec)) {
@@ -2891,4 +4485,764 @@ bool GetDataDirectoryEntry(parsed_pe *pe,
   return true;
 }
 
+/*
+ * Follows "Windows Authenticode Portable Executable Signature Format": the
+ * headers up to SizeOfHeaders minus the CheckSum field and the certificate
+ * table entry, then each section's raw data in order of PointerToRawData,
+ * then whatever follows the last section except the certificate table. All
+ * of it is hashed straight out of fileBuffer, in one ascending pass unless
+ * sections overlap.
+ */
+bool GetAuthenticodeDigest(parsed_pe *pe, sha256_digest &out) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const std::uint8_t *file = pe->fileBuffer->buf;
+  const std::uint64_t fileSize = pe->fileBuffer->bufLen;
+
+  std::uint32_t sizeOfHeaders;
+  std::uint64_t checkSumOff;
+  std::uint64_t certEntryOff;
+  data_directory certDir{0, 0};
+  bool hasCertEntry;
+  std::uint64_t optOff = static_cast<std::uint64_t>(pe->peHeader.dos.e_lfanew) +
+                         sizeof(std::uint32_t) + 20;
+  if (!withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+        using T = std::decay_t<decltype(optHdr)>;
+        sizeOfHeaders = optHdr.SizeOfHeaders;
+        checkSumOff = optOff + offsetof(T, CheckSum);
+        certEntryOff = optOff + offsetof(T, DataDirectory) +
+                       DIR_SECURITY * sizeof(data_directory);
+        hasCertEntry = optHdr.NumberOfRvaAndSizes > DIR_SECURITY;
+        if (hasCertEntry) {
+          certDir = optHdr.DataDirectory[DIR_SECURITY];
+        }
+      })) {
+    PE_ERR(PEERR_MAGIC);
+    return false;
+  }
+
+  sha256_ctx ctx;
+  Sha256Init(ctx);
+  auto hash = [&](std::uint64_t from, std::uint64_t to) {
+    to = std::min(to, fileSize);
+    if (from < to) {
+      Sha256Update(ctx, file + from, static_cast<std::size_t>(to - from));
+    }
+  };
+
+  // a crafted SizeOfHeaders can end the headers before the CheckSum or the
+  // certificate table entry, so every range stops at headersEnd
+  std::uint64_t headersEnd = std::min<std::uint64_t>(sizeOfHeaders, fileSize);
+  hash(0, std::min(checkSumOff, headersEnd));
+  if (hasCertEntry) {
+    hash(checkSumOff + 4, std::min(certEntryOff, headersEnd));
+    hash(certEntryOff + sizeof(data_directory), headersEnd);
+  } else {
+    hash(checkSumOff + 4, headersEnd);
+  }
+
+  std::vector<const image_section_header *> secs;
+  for (const section &s : pe->internal->secs) {
+    if (s.sec.SizeOfRawData != 0) {
+      secs.push_back(&s.sec);
+    }
+  }
+  std::stable_sort(
+      secs.begin(),
+      secs.end(),
+      [](const image_section_header *a, const image_section_header *b) {
+        return a->PointerToRawData < b->PointerToRawData;
+      });
+
+  std::uint64_t end = headersEnd;
+  for (const image_section_header *s : secs) {
+    std::uint64_t from = s->PointerToRawData;
+    std::uint64_t to = from + s->SizeOfRawData;
+    hash(from, to);
+    end = std::max(end, std::min(to, fileSize));
+  }
+
+  // the certificate table is normally the last thing in the file, but only
+  // its own bytes are left out
+  std::uint64_t certOff = certDir.VirtualAddress;
+  if (certDir.Size != 0 && certOff >= end) {
+    hash(end, certOff);
+    hash(certOff + certDir.Size, fileSize);
+  } else {
+    hash(end, fileSize);
+  }
+
+  Sha256Final(ctx, out);
+  return true;
+}
+
+// the DIR_SECURITY entry, or an empty one if the image doesn't have it
+static data_directory certificateDirectory(parsed_pe *pe) {
+  data_directory dir{0, 0};
+  withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+    if (optHdr.NumberOfRvaAndSizes > DIR_SECURITY) {
+      dir = optHdr.DataDirectory[DIR_SECURITY];
+    }
+  });
+  return dir;
+}
+
+void IterCertificates(parsed_pe *pe, iterCert cb, void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  data_directory dir = certificateDirectory(pe);
+  if (dir.VirtualAddress == 0 || dir.Size == 0) {
+    return;
+  }
+
+  // VirtualAddress is a file offset here; a table cut short by the end of
+  // the file is walked as far as it goes
+  bounded_buffer *b = pe->fileBuffer;
+  std::uint64_t at = dir.VirtualAddress;
+  std::uint64_t end = std::min<std::uint64_t>(at + dir.Size, b->bufLen);
+
+  while (at < end && end - at >= sizeof(win_certificate)) {
+    auto off = static_cast<std::uint32_t>(at);
+    std::uint32_t length;
+    certificate_entry entry;
+    if (!readDword(b, off, length) || length < sizeof(win_certificate) ||
+        length > end - at ||
+        !readWord(b, off + offsetof(win_certificate, wRevision),
+                  entry.revision) ||
+        !readWord(b, off + offsetof(win_certificate, wCertificateType),
+                  entry.type)) {
+      return;
+    }
+
+    entry.offset = off;
+    entry.data = b->buf + off + sizeof(win_certificate);
+    entry.length = length - static_cast<std::uint32_t>(sizeof(win_certificate));
+    if (cb(cbd, entry) != 0) {
+      return;
+    }
+
+    // each entry starts on an 8-byte boundary
+    at += (static_cast<std::uint64_t>(length) + 7) & ~std::uint64_t{7};
+  }
+}
+
+// The Winsock 1.1 exports, whose ordinals are the same in every ws2_32 and
+// wsock32. pefile names ordinal imports from either with these in imphashes,
+// and so does the import hash
+struct ordinal_name {
+  std::uint16_t ordinal;
+  const char *name;
+};
+
+static const ordinal_name winsockOrdinals[] = {
+    {1, "accept"},
+    {2, "bind"},
+    {3, "closesocket"},
+    {4, "connect"},
+    {5, "getpeername"},
+    {6, "getsockname"},
+    {7, "getsockopt"},
+    {8, "htonl"},
+    {9, "htons"},
+    {10, "ioctlsocket"},
+    {11, "inet_addr"},
+    {12, "inet_ntoa"},
+    {13, "listen"},
+    {14, "ntohl"},
+    {15, "ntohs"},
+    {16, "recv"},
+    {17, "recvfrom"},
+    {18, "select"},
+    {19, "send"},
+    {20, "sendto"},
+    {21, "setsockopt"},
+    {22, "shutdown"},
+    {23, "socket"},
+    {51, "gethostbyaddr"},
+    {52, "gethostbyname"},
+    {53, "getprotobyname"},
+    {54, "getprotobynumber"},
+    {55, "getservbyname"},
+    {56, "getservbyport"},
+    {57, "gethostname"},
+    {101, "WSAAsyncSelect"},
+    {102, "WSAAsyncGetHostByAddr"},
+    {103, "WSAAsyncGetHostByName"},
+    {104, "WSAAsyncGetProtoByNumber"},
+    {105, "WSAAsyncGetProtoByName"},
+    {106, "WSAAsyncGetServByPort"},
+    {107, "WSAAsyncGetServByName"},
+    {108, "WSACancelAsyncRequest"},
+    {109, "WSASetBlockingHook"},
+    {110, "WSAUnhookBlockingHook"},
+    {111, "WSAGetLastError"},
+    {112, "WSASetLastError"},
+    {113, "WSACancelBlockingCall"},
+    {114, "WSAIsBlocking"},
+    {115, "WSAStartup"},
+    {116, "WSACleanup"},
+    {151, "__WSAFDIsSet"},
+    {500, "WEP"},
+};
+
+static char toLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// true if s equals lower, which is already lower case, ignoring ASCII case
+static bool equalsLower(const char *s, std::size_t len, const char *lower) {
+  std::size_t i = 0;
+  for (; i < len && lower[i] != '\0'; i++) {
+    if (toLowerAscii(s[i]) != lower[i]) {
+      return false;
+    }
+  }
+  return i == len && lower[i] == '\0';
+}
+
+// Feeds s to ctx lowercased, through a small buffer rather than a copy of
+// the whole string
+static void md5UpdateLower(md5_ctx &ctx, const char *s, std::size_t len) {
+  std::uint8_t buf[64];
+  while (len != 0) {
+    std::size_t n = std::min(len, sizeof(buf));
+    for (std::size_t i = 0; i < n; i++) {
+      buf[i] = static_cast<std::uint8_t>(toLowerAscii(s[i]));
+    }
+    Md5Update(ctx, buf, n);
+    s += n;
+    len -= n;
+  }
+}
+
+static void md5UpdateLower(md5_ctx &ctx, const std::string &s) {
+  md5UpdateLower(ctx, s.data(), s.size());
+}
+
+static void md5UpdateSeparator(md5_ctx &ctx, char c) {
+  auto b = static_cast<std::uint8_t>(c);
+  Md5Update(ctx, &b, 1);
+}
+
+static bool importHash(parsed_pe *pe, md5_digest &out) {
+  md5_ctx ctx;
+  Md5Init(ctx);
+  bool any = false;
+
+  for (const importent &i : pe->internal->imports) {
+    if (i.delayLoad) {
+      continue;
+    }
+
+    const std::string &mod = i.moduleName;
+    std::size_t modLen = mod.size();
+    std::size_t dot = mod.rfind('.');
+    if (dot != std::string::npos) {
+      const char *ext = mod.data() + dot + 1;
+      std::size_t extLen = modLen - dot - 1;
+      if (equalsLower(ext, extLen, "dll") || equalsLower(ext, extLen, "ocx") ||
+          equalsLower(ext, extLen, "sys")) {
+        modLen = dot;
+      }
+    }
+
+    if (any) {
+      md5UpdateSeparator(ctx, ',');
+    }
+    any = true;
+    md5UpdateLower(ctx, mod.data(), modLen);
+    md5UpdateSeparator(ctx, '.');
+
+    if (!i.byOrdinal) {
+      md5UpdateLower(ctx, i.symbolName);
+      continue;
+    }
+
+    const char *name = nullptr;
+    if (equalsLower(mod.data(), mod.size(), "ws2_32.dll") ||
+        equalsLower(mod.data(), mod.size(), "wsock32.dll")) {
+      auto it = std::lower_bound(
+          std::begin(winsockOrdinals),
+          std::end(winsockOrdinals),
+          i.ordinal,
+          [](const ordinal_name &o, std::uint16_t v) { return o.ordinal < v; });
+      if (it != std::end(winsockOrdinals) && it->ordinal == i.ordinal) {
+        name = it->name;
+      }
+    }
+
+    if (name != nullptr) {
+      md5UpdateLower(ctx, name, std::strlen(name));
+    } else {
+      char buf[16];
+      int n = std::snprintf(buf, sizeof(buf), "ord%u", i.ordinal);
+      Md5Update(ctx,
+                reinterpret_cast<std::uint8_t *>(buf),
+                static_cast<std::size_t>(n));
+    }
+  }
+
+  if (any) {
+    Md5Final(ctx, out);
+  }
+  return any;
+}
+
+static bool exportHash(parsed_pe *pe, md5_digest &out) {
+  // the export name table is sorted, but the exports are kept in EAT order
+  std::vector<const std::string *> names;
+  for (const exportent &e : pe->internal->exports) {
+    if (!e.symbolName.empty()) {
+      names.push_back(&e.symbolName);
+    }
+  }
+  if (names.empty()) {
+    return false;
+  }
+  std::sort(names.begin(),
+            names.end(),
+            [](const std::string *a, const std::string *b) { return *a < *b; });
+
+  md5_ctx ctx;
+  Md5Init(ctx);
+  for (std::size_t i = 0; i < names.size(); i++) {
+    if (i != 0) {
+      md5UpdateSeparator(ctx, ',');
+    }
+    md5UpdateLower(ctx, *names[i]);
+  }
+  Md5Final(ctx, out);
+  return true;
+}
+
+static bool richHash(parsed_pe *pe, md5_digest &out) {
+  const rich_header &rich = pe->peHeader.rich;
+  if (!rich.isPresent) {
+    return false;
+  }
+
+  // "DanS", three padding dwords and the entries, all encoded with the key
+  std::uint64_t end = RICH_OFFSET + 16 + 8 * rich.Entries.size();
+  std::uint32_t sig;
+  if (end > UINT32_MAX ||
+      !readDword(pe->fileBuffer, static_cast<std::uint32_t>(end), sig) ||
+      sig != RICH_MAGIC_END) {
+    return false;
+  }
+
+  md5_ctx ctx;
+  Md5Init(ctx);
+  for (std::uint32_t off = RICH_OFFSET; off < end; off += 4) {
+    std::uint32_t dword;
+    if (!readDword(pe->fileBuffer, off, dword)) {
+      return false;
+    }
+    dword ^= rich.DecryptionKey;
+    std::uint8_t bytes[4] = {static_cast<std::uint8_t>(dword),
+                             static_cast<std::uint8_t>(dword >> 8),
+                             static_cast<std::uint8_t>(dword >> 16),
+                             static_cast<std::uint8_t>(dword >> 24)};
+    Md5Update(ctx, bytes, sizeof(bytes));
+  }
+  Md5Final(ctx, out);
+  return true;
+}
+
+// sections are kept in file order; report them in section table order
+static std::vector<const section *> sectionsInTableOrder(parsed_pe *pe) {
+  std::vector<const section *> secs;
+  for (const section &s : pe->internal->secs) {
+    secs.push_back(&s);
+  }
+  std::sort(secs.begin(), secs.end(), [](const section *a, const section *b) {
+    return a->tableIndex < b->tableIndex;
+  });
+  return secs;
+}
+
+bool GetFingerprints(parsed_pe *pe, std::uint32_t which, pe_fingerprints &out) {
+  out = pe_fingerprints();
+
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  if ((which & FINGERPRINT_IMPORT_HASH) != 0 &&
+      importHash(pe, out.importHash)) {
+    out.computed |= FINGERPRINT_IMPORT_HASH;
+  }
+  if ((which & FINGERPRINT_EXPHASH) != 0 && exportHash(pe, out.exphash)) {
+    out.computed |= FINGERPRINT_EXPHASH;
+  }
+  if ((which & FINGERPRINT_RICH_HASH) != 0 && richHash(pe, out.richHash)) {
+    out.computed |= FINGERPRINT_RICH_HASH;
+  }
+
+  const bool md5 = (which & FINGERPRINT_SECTION_MD5) != 0;
+  const bool sha256 = (which & FINGERPRINT_SECTION_SHA256) != 0;
+  if (!md5 && !sha256) {
+    return out.computed != 0;
+  }
+
+  std::vector<const section *> secs = sectionsInTableOrder(pe);
+  out.sections.reserve(secs.size());
+  for (const section *s : secs) {
+    section_fingerprint f = section_fingerprint();
+    f.name = s->sectionName;
+
+    md5_ctx md5Ctx;
+    sha256_ctx shaCtx;
+    Md5Init(md5Ctx);
+    Sha256Init(shaCtx);
+
+    // both digests take each slice in turn, while it is still in cache
+    const bounded_buffer *b = s->sectionData;
+    std::size_t len = b != nullptr ? b->bufLen : 0;
+    for (std::size_t off = 0; off < len;) {
+      std::size_t n = std::min<std::size_t>(len - off, 64 * 1024);
+      if (md5) {
+        Md5Update(md5Ctx, b->buf + off, n);
+      }
+      if (sha256) {
+        Sha256Update(shaCtx, b->buf + off, n);
+      }
+      off += n;
+    }
+
+    if (md5) {
+      Md5Final(md5Ctx, f.md5);
+    }
+    if (sha256) {
+      Sha256Final(shaCtx, f.sha256);
+    }
+    out.sections.push_back(std::move(f));
+  }
+  out.computed |=
+      which & (FINGERPRINT_SECTION_MD5 | FINGERPRINT_SECTION_SHA256);
+
+  return true;
+}
+
+static void countSection(const std::uint8_t *data,
+                         std::size_t len,
+                         const entropy_options &opts,
+                         byte_histogram &h) {
+  std::size_t n = 1;
+  if (opts.threads > 1 && len >= opts.parallelThreshold) {
+    n = std::min<std::size_t>(opts.threads, len);
+  }
+  if (n <= 1) {
+    AddByteHistogram(h, data, len);
+    return;
+  }
+
+  // the calling thread counts the last slice
+  const std::size_t slice = len / n;
+  std::vector<byte_histogram> partial(n - 1, byte_histogram());
+  std::vector<std::thread> workers;
+  workers.reserve(n - 1);
+  std::size_t started = 0;
+  try {
+    for (; started < n - 1; started++) {
+      workers.emplace_back([&partial, data, slice, started]() {
+        AddByteHistogram(partial[started], data + started * slice, slice);
+      });
+    }
+  } catch (const std::system_error &) {
+    // out of threads: count the rest here
+    for (std::size_t i = started; i < n - 1; i++) {
+      AddByteHistogram(partial[i], data + i * slice, slice);
+    }
+  }
+  AddByteHistogram(h, data + (n - 1) * slice, len - (n - 1) * slice);
+
+  for (std::thread &t : workers) {
+    t.join();
+  }
+  for (const byte_histogram &p : partial) {
+    for (std::size_t b = 0; b < h.size(); b++) {
+      h[b] += p[b];
+    }
+  }
+}
+
+bool GetSectionEntropy(parsed_pe *pe,
+                       const entropy_options &opts,
+                       std::vector<section_entropy> &out) {
+  out.clear();
+
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  std::vector<const section *> secs = sectionsInTableOrder(pe);
+  out.reserve(secs.size());
+  for (const section *s : secs) {
+    section_entropy e = section_entropy();
+    e.name = s->sectionName;
+
+    const bounded_buffer *b = s->sectionData;
+    const std::uint8_t *data = b != nullptr ? b->buf : nullptr;
+    std::size_t len = b != nullptr ? b->bufLen : 0;
+
+    countSection(data, len, opts, e.histogram);
+    e.entropy = ShannonEntropy(e.histogram);
+    e.chiSquare = ChiSquare(e.histogram);
+    if (opts.profileThreshold != 0 && len >= opts.profileThreshold) {
+      e.profile =
+          EntropyProfile(data, len, opts.windowSize, opts.windowStep);
+    }
+    out.push_back(std::move(e));
+  }
+
+  return true;
+}
+
+// the end of the headers and of the last section's raw data, past which is
+// the overlay
+static std::uint64_t overlayOffset(parsed_pe *pe) {
+  std::uint64_t end = 0;
+  withOptionalHeader(pe->peHeader.nt, [&](const auto &optHdr) {
+    end = optHdr.SizeOfHeaders;
+  });
+  for (const section &s : pe->internal->secs) {
+    if (s.sec.SizeOfRawData != 0) {
+      end = std::max<std::uint64_t>(
+          end,
+          static_cast<std::uint64_t>(s.sec.PointerToRawData) +
+              s.sec.SizeOfRawData);
+    }
+  }
+  return std::min<std::uint64_t>(end, pe->fileBuffer->bufLen);
+}
+
+bool GetOverlay(parsed_pe *pe, pe_overlay &out) {
+  out = pe_overlay();
+
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  const std::uint8_t *file = pe->fileBuffer->buf;
+  const std::uint64_t fileSize = pe->fileBuffer->bufLen;
+  const std::uint64_t start = overlayOffset(pe);
+
+  // the certificate table splits the overlay in two, though normally one
+  // of the parts is empty
+  std::uint64_t frontEnd = fileSize;
+  std::uint64_t backStart = fileSize;
+  data_directory dir = certificateDirectory(pe);
+  if (dir.VirtualAddress != 0 && dir.Size != 0) {
+    std::uint64_t certStart = dir.VirtualAddress;
+    std::uint64_t certEnd = certStart + dir.Size;
+    if (certEnd > start && certStart < fileSize) {
+      frontEnd = std::max(certStart, start);
+      backStart = std::min(certEnd, fileSize);
+      // the table starts on an 8-byte boundary
+      if (frontEnd - start < 8) {
+        frontEnd = start;
+      }
+    }
+  }
+
+  auto span = [&](std::uint64_t from, std::uint64_t to) {
+    return file_span{
+        from, file + from, static_cast<std::size_t>(to - from)};
+  };
+  file_span front = span(start, frontEnd);
+  file_span back = span(backStart, fileSize);
+  if (front.length != 0) {
+    out.data = front;
+    out.appended = back;
+  } else {
+    out.data = back;
+    out.appended = span(fileSize, fileSize);
+  }
+
+  return out.data.length != 0;
+}
+
+bool GetOverlayEntropy(parsed_pe *pe,
+                       const entropy_options &opts,
+                       section_entropy &out) {
+  out = section_entropy();
+
+  pe_overlay overlay;
+  if (!GetOverlay(pe, overlay)) {
+    return false;
+  }
+
+  for (const file_span &part : {overlay.data, overlay.appended}) {
+    countSection(part.data, part.length, opts, out.histogram);
+    if (opts.profileThreshold != 0 && part.length >= opts.profileThreshold) {
+      std::vector<double> profile = EntropyProfile(
+          part.data, part.length, opts.windowSize, opts.windowStep);
+      out.profile.insert(out.profile.end(), profile.begin(), profile.end());
+    }
+  }
+  out.entropy = ShannonEntropy(out.histogram);
+  out.chiSquare = ChiSquare(out.histogram);
+
+  return true;
+}
+
+void IterStrings(parsed_pe *pe,
+                 std::size_t minLength,
+                 std::uint32_t encodings,
+                 iterString cb,
+                 void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  const std::uint8_t *file = pe->fileBuffer->buf;
+  std::vector<string_match> matches;
+  string_entry e;
+
+  // returns true if the callback asked to stop
+  auto scan = [&](const std::uint8_t *data,
+                  std::size_t len,
+                  const section *s) {
+    FindStrings(data, len, minLength, encodings, matches);
+    e.sectionName = s != nullptr ? s->sectionName : std::string();
+    for (const string_match &m : matches) {
+      e.encoding = m.encoding;
+      e.fileOffset = static_cast<std::uint64_t>(data - file) + m.offset;
+      e.rva = 0;
+      e.va = 0;
+      if (s != nullptr) {
+        e.rva = static_cast<RVA>(s->sec.VirtualAddress + m.offset);
+        e.va = s->sectionBase + m.offset;
+      }
+
+      const std::uint8_t *str = data + m.offset;
+      e.value.resize(m.length);
+      if (m.encoding == STRING_ASCII) {
+        std::memcpy(&e.value[0], str, m.length);
+      } else {
+        for (std::size_t i = 0; i < m.length; i++) {
+          e.value[i] = static_cast<char>(str[2 * i]);
+        }
+      }
+
+      if (cb(cbd, e) != 0) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  for (const section *s : sectionsInTableOrder(pe)) {
+    const bounded_buffer *b = s->sectionData;
+    if (b != nullptr && b->bufLen != 0 && scan(b->buf, b->bufLen, s)) {
+      return;
+    }
+  }
+
+  // the overlay less the certificate table, whose strings are the signer's
+  pe_overlay overlay;
+  if (!GetOverlay(pe, overlay)) {
+    return;
+  }
+  for (const file_span &part : {overlay.data, overlay.appended}) {
+    if (part.length != 0 && scan(part.data, part.length, nullptr)) {
+      return;
+    }
+  }
+}
+
+// report the hits in [data, data + len), a part of s's raw data
+static bool reportSignatureHits(parsed_pe *pe,
+                                const signature_set *set,
+                                const section &s,
+                                const std::uint8_t *data,
+                                std::size_t len,
+                                iterSignature cb,
+                                void *cbd) {
+  std::vector<signature_hit> hits;
+  FindSignatures(set, data, len, hits);
+
+  signature_match m;
+  m.sectionName = s.sectionName;
+  const VA va = s.sectionBase + static_cast<VA>(data - s.sectionData->buf);
+  const std::uint64_t fileOffset =
+      static_cast<std::uint64_t>(data - pe->fileBuffer->buf);
+  for (const signature_hit &h : hits) {
+    m.pattern = h.pattern;
+    m.va = va + h.offset;
+    m.fileOffset = fileOffset + h.offset;
+    if (cb(cbd, m) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IterSectionSignatures(parsed_pe *pe,
+                           const signature_set *set,
+                           const std::vector<std::string> &sections,
+                           iterSignature cb,
+                           void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  for (const section *s : sectionsInTableOrder(pe)) {
+    if (!sections.empty() &&
+        std::find(sections.begin(), sections.end(), s->sectionName) ==
+            sections.end()) {
+      continue;
+    }
+
+    const bounded_buffer *b = s->sectionData;
+    if (b != nullptr && b->bufLen != 0 &&
+        reportSignatureHits(pe, set, *s, b->buf, b->bufLen, cb, cbd)) {
+      return;
+    }
+  }
+}
+
+void IterEntryPointSignatures(parsed_pe *pe,
+                              const signature_set *set,
+                              std::uint32_t window,
+                              iterSignature cb,
+                              void *cbd) {
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return;
+  }
+
+  VA entry;
+  if (!GetEntryPoint(pe, entry)) {
+    return;
+  }
+
+  const section *s = findSecForVA(pe->internal->secs, entry);
+  if (s == nullptr || s->sectionData == nullptr) {
+    PE_ERR(PEERR_SECTVA);
+    return;
+  }
+
+  // the window stops at the end of the section's raw data
+  const bounded_buffer *b = s->sectionData;
+  std::uint64_t off = entry - s->sectionBase;
+  if (off >= b->bufLen) {
+    return;
+  }
+  std::size_t len = static_cast<std::size_t>(
+      std::min<std::uint64_t>(window, b->bufLen - off));
+  reportSignatureHits(pe, set, *s, b->buf + off, len, cb, cbd);
+}
+
 } // namespace peparse
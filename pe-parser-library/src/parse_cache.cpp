@@ -0,0 +1,585 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+
+#include <pe-parse/parse.h>
+
+namespace peparse {
+
+extern std::uint32_t err;
+extern error_location err_loc;
+
+namespace {
+
+constexpr std::uint32_t RECORD_MAGIC = 0x43504550; // "PEPC"
+constexpr std::uint32_t INDEX_MAGIC = 0x49504550;  // "PEPI"
+constexpr std::uint32_t CACHE_VERSION = 3;
+
+// the seed of the second XXH64 that, with the key, makes up the 128-bit
+// content hash a record is checked against
+constexpr std::uint64_t CHECK_SEED = 0x6b63656843504550; // "PEPCheck"
+
+// headers are stored as they are laid out in memory, so records written by
+// a build with different structure layouts are rejected
+constexpr std::uint32_t LAYOUT =
+    static_cast<std::uint32_t>(sizeof(dos_header) ^
+                               (sizeof(nt_header_32) << 8) ^
+                               (sizeof(image_section_header) << 20));
+
+/*
+ * A record is written and read by the same transfer functions, which take
+ * either a record_writer or a record_reader, so that the two can't drift
+ * apart. Integers are little-endian; a reader that runs out of input or
+ * meets an implausible count clears ok and reads zeroes from then on.
+ */
+struct record_writer {
+  std::vector<std::uint8_t> bytes;
+
+  template <typename T>
+  void integer(const T &v) {
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+      bytes.push_back(static_cast<std::uint8_t>(
+          static_cast<std::uint64_t>(v) >> (8 * i)));
+    }
+  }
+
+  void flag(const bool &v) {
+    bytes.push_back(v ? 1 : 0);
+  }
+
+  template <typename T>
+  void raw(const T &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "raw needs a POD");
+    const auto *p = reinterpret_cast<const std::uint8_t *>(&v);
+    bytes.insert(bytes.end(), p, p + sizeof(T));
+  }
+
+  void string(const std::string &s) {
+    integer(static_cast<std::uint32_t>(s.size()));
+    bytes.insert(bytes.end(), s.begin(), s.end());
+  }
+
+  template <typename T, typename F>
+  void list(const std::vector<T> &v, F each) {
+    integer(static_cast<std::uint64_t>(v.size()));
+    for (const T &e : v) {
+      each(e);
+    }
+  }
+};
+
+struct record_reader {
+  const std::uint8_t *p;
+  const std::uint8_t *end;
+  bool ok = true;
+
+  bool take(std::size_t n) {
+    if (!ok || static_cast<std::size_t>(end - p) < n) {
+      ok = false;
+      return false;
+    }
+    return true;
+  }
+
+  template <typename T>
+  void integer(T &v) {
+    std::uint64_t x = 0;
+    if (take(sizeof(T))) {
+      for (std::size_t i = 0; i < sizeof(T); i++) {
+        x |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+      }
+      p += sizeof(T);
+    }
+    v = static_cast<T>(x);
+  }
+
+  void flag(bool &v) {
+    std::uint8_t b;
+    integer(b);
+    v = b != 0;
+  }
+
+  template <typename T>
+  void raw(T &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "raw needs a POD");
+    if (take(sizeof(T))) {
+      std::memcpy(&v, p, sizeof(T));
+      p += sizeof(T);
+    } else {
+      v = T();
+    }
+  }
+
+  void string(std::string &s) {
+    std::uint32_t n;
+    integer(n);
+    if (take(n)) {
+      s.assign(reinterpret_cast<const char *>(p), n);
+      p += n;
+    } else {
+      s.clear();
+    }
+  }
+
+  template <typename T, typename F>
+  void list(std::vector<T> &v, F each) {
+    // every element takes at least a byte, which bounds the count before
+    // anything is allocated for it
+    std::uint64_t n;
+    integer(n);
+    if (!ok || n > static_cast<std::uint64_t>(end - p)) {
+      ok = false;
+      v.clear();
+      return;
+    }
+    v.resize(static_cast<std::size_t>(n));
+    for (T &e : v) {
+      each(e);
+    }
+  }
+};
+
+// the fields of a summary, in record order. S is pe_summary or const
+// pe_summary, to go with the reader or the writer
+template <typename A, typename S>
+void transferSummary(A &a, S &s) {
+  auto &h = s.header;
+  a.raw(h.dos);
+  a.raw(h.nt);
+  a.integer(h.rich.StartSignature);
+  a.integer(h.rich.EndSignature);
+  a.integer(h.rich.DecryptionKey);
+  a.integer(h.rich.Checksum);
+  a.flag(h.rich.isPresent);
+  a.flag(h.rich.isValid);
+  a.list(h.rich.Entries, [&a](auto &e) {
+    a.integer(e.ProductId);
+    a.integer(e.BuildNumber);
+    a.integer(e.Count);
+  });
+
+  a.list(s.sections, [&a](auto &sec) {
+    a.string(sec.name);
+    a.integer(sec.base);
+    a.raw(sec.header);
+  });
+  a.list(s.imports, [&a](auto &i) {
+    a.integer(i.addr);
+    a.string(i.moduleName);
+    a.string(i.symbolName);
+    a.flag(i.byOrdinal);
+    a.integer(i.ordinal);
+    a.flag(i.delayLoad);
+  });
+  a.list(s.exports, [&a](auto &e) {
+    a.integer(e.addr);
+    a.integer(e.ordinal);
+    a.string(e.symbolName);
+    a.string(e.moduleName);
+    a.string(e.forwardName);
+  });
+  a.list(s.resources, [&a](auto &r) {
+    a.string(r.type_str);
+    a.string(r.name_str);
+    a.string(r.lang_str);
+    a.integer(r.type);
+    a.integer(r.name);
+    a.integer(r.lang);
+    a.integer(r.codepage);
+    a.integer(r.RVA);
+    a.integer(r.size);
+  });
+}
+
+// what a record says about the file it was made from
+struct record_header {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t layout;
+  std::uint64_t key;
+  std::uint64_t length;
+  // the key only picks the record; a hit needs the second half of the
+  // 128-bit content hash to match too
+  std::uint64_t check;
+  // the pe_err the parse failed with, or PEERR_NONE
+  std::uint32_t status;
+};
+
+template <typename A, typename H>
+void transferHeader(A &a, H &h) {
+  a.integer(h.magic);
+  a.integer(h.version);
+  a.integer(h.layout);
+  a.integer(h.key);
+  a.integer(h.length);
+  a.integer(h.check);
+  a.integer(h.status);
+}
+
+bool readFile(const std::string &path, std::vector<std::uint8_t> &out) {
+  std::FILE *f = std::fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+
+  out.clear();
+  std::uint8_t chunk[16384];
+  std::size_t n;
+  while ((n = std::fread(chunk, 1, sizeof(chunk), f)) != 0) {
+    out.insert(out.end(), chunk, chunk + n);
+  }
+  bool ok = std::ferror(f) == 0;
+  std::fclose(f);
+  return ok;
+}
+
+// write through a temporary file, so that a record or index is either
+// complete or not there at all
+bool writeFile(const std::string &path, const std::vector<std::uint8_t> &in) {
+  std::string tmp = path + ".tmp";
+  std::FILE *f = std::fopen(tmp.c_str(), "wb");
+  if (f == nullptr) {
+    return false;
+  }
+
+  bool ok = std::fwrite(in.data(), 1, in.size(), f) == in.size();
+  ok = std::fclose(f) == 0 && ok;
+  // rename doesn't replace an existing file everywhere
+  std::remove(path.c_str());
+  if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+struct cache_entry {
+  std::uint64_t key;
+  std::uint64_t size;
+  // tells a record apart from one stored under the same key later; not
+  // saved in the index
+  std::uint64_t stamp;
+};
+
+int collectSection(void *cbd,
+                   const VA &base,
+                   const std::string &name,
+                   const image_section_header &header,
+                   const bounded_buffer *) {
+  static_cast<pe_summary *>(cbd)->sections.push_back(
+      section_summary{name, base, header});
+  return 0;
+}
+
+int collectImport(void *cbd, const import_ref &ref) {
+  static_cast<pe_summary *>(cbd)->imports.push_back(ref);
+  return 0;
+}
+
+int collectExport(void *cbd, const export_ref &ref) {
+  static_cast<pe_summary *>(cbd)->exports.push_back(ref);
+  return 0;
+}
+
+int collectResource(void *cbd, const resource &r) {
+  auto *s = static_cast<pe_summary *>(cbd);
+  s->resources.push_back(r);
+  s->resources.back().buf = nullptr;
+  return 0;
+}
+
+} // namespace
+
+struct parse_cache {
+  std::string dir;
+  std::uint64_t maxBytes;
+  std::mutex lock;
+  // least recently used first
+  std::list<cache_entry> lru;
+  std::unordered_map<std::uint64_t, std::list<cache_entry>::iterator> index;
+  std::uint64_t nextStamp = 0;
+  parse_cache_stats stats;
+
+  std::string recordPath(std::uint64_t key) const {
+    static const char hex[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (std::size_t i = 0; i < 16; i++) {
+      name[15 - i] = hex[(key >> (4 * i)) & 0xF];
+    }
+    return dir + "/" + name + ".sum";
+  }
+
+  std::string indexPath() const {
+    return dir + "/index";
+  }
+
+  void add(std::uint64_t key, std::uint64_t size) {
+    index[key] = lru.insert(lru.end(), cache_entry{key, size, ++nextStamp});
+    stats.entries++;
+    stats.bytes += size;
+  }
+
+  void drop(std::list<cache_entry>::iterator it, bool evicted) {
+    std::remove(recordPath(it->key).c_str());
+    stats.entries--;
+    stats.bytes -= it->size;
+    if (evicted) {
+      stats.evictions++;
+    }
+    index.erase(it->key);
+    lru.erase(it);
+  }
+
+  void evict() {
+    while (stats.bytes > maxBytes && !lru.empty()) {
+      drop(lru.begin(), true);
+    }
+  }
+
+  // look want.key up, and read its record if it is for a file of the same
+  // length and 128-bit content hash. the record is read and checked without
+  // holding the lock, so lookups only wait on each other for the index.
+  // returns false on a miss
+  bool find(const record_header &want,
+            std::uint32_t &status,
+            pe_summary &out) {
+    std::uint64_t stamp;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      auto it = index.find(want.key);
+      if (it == index.end()) {
+        stats.misses++;
+        return false;
+      }
+      stamp = it->second->stamp;
+    }
+
+    // store replaces records by renaming over them, so this sees either
+    // the old record or the new one
+    std::vector<std::uint8_t> bytes;
+    bool ok = readFile(recordPath(want.key), bytes);
+    record_header h{};
+    if (ok) {
+      record_reader r{bytes.data(), bytes.data() + bytes.size()};
+      transferHeader(r, h);
+      if (r.ok && h.status == PEERR_NONE) {
+        transferSummary(r, out);
+      }
+      // PEERR_WRITE is the last pe_err
+      ok = r.ok && r.p == r.end && h.magic == RECORD_MAGIC &&
+           h.version == CACHE_VERSION && h.layout == LAYOUT &&
+           h.key == want.key && h.length == want.length &&
+           h.check == want.check && h.status <= PEERR_WRITE;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(want.key);
+    bool same = it != index.end() && it->second->stamp == stamp;
+    if (!ok) {
+      // missing, damaged, or for another file with the same key; the parse
+      // that follows replaces it, unless a store already has
+      if (same) {
+        drop(it->second, false);
+      }
+      stats.misses++;
+      return false;
+    }
+
+    if (same) {
+      lru.splice(lru.end(), lru, it->second);
+    }
+    stats.hits++;
+    status = h.status;
+    return true;
+  }
+
+  void store(const record_header &h, const pe_summary &s) {
+    record_writer w;
+    transferHeader(w, h);
+    if (h.status == PEERR_NONE) {
+      transferSummary(w, s);
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(h.key);
+    if (it != index.end()) {
+      drop(it->second, false);
+    }
+    if (w.bytes.size() > maxBytes || !writeFile(recordPath(h.key), w.bytes)) {
+      return;
+    }
+    add(h.key, w.bytes.size());
+    evict();
+  }
+};
+
+bool SummarizePE(parsed_pe *pe, pe_summary &out) {
+  out = pe_summary();
+  if (pe == nullptr) {
+    PE_ERR(PEERR_NONE);
+    return false;
+  }
+
+  out.header = pe->peHeader;
+  IterSec(pe, collectSection, &out);
+  IterImpRefs(pe, collectImport, &out);
+  IterExpRefs(pe, collectExport, &out);
+  IterRsrc(pe, collectResource, &out);
+  return true;
+}
+
+parse_cache *OpenParseCache(const char *dir, std::uint64_t maxBytes) {
+  parse_cache *cache = new (std::nothrow) parse_cache();
+  if (cache == nullptr) {
+    PE_ERR(PEERR_MEM);
+    return nullptr;
+  }
+  cache->dir = dir;
+  cache->maxBytes = maxBytes;
+  cache->stats = parse_cache_stats();
+
+  // a missing or damaged index leaves the cache empty
+  std::vector<std::uint8_t> bytes;
+  if (readFile(cache->indexPath(), bytes)) {
+    record_reader r{bytes.data(), bytes.data() + bytes.size()};
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::vector<cache_entry> entries;
+    r.integer(magic);
+    r.integer(version);
+    r.list(entries, [&r](cache_entry &e) {
+      r.integer(e.key);
+      r.integer(e.size);
+    });
+    if (r.ok && magic == INDEX_MAGIC && version == CACHE_VERSION) {
+      for (const cache_entry &e : entries) {
+        if (cache->index.count(e.key) == 0) {
+          cache->add(e.key, e.size);
+        }
+      }
+    }
+  }
+  cache->evict();
+
+  return cache;
+}
+
+void CloseParseCache(parse_cache *cache) {
+  if (cache == nullptr) {
+    return;
+  }
+
+  record_writer w;
+  w.integer(INDEX_MAGIC);
+  w.integer(CACHE_VERSION);
+  w.list(std::vector<cache_entry>(cache->lru.begin(), cache->lru.end()),
+         [&w](const cache_entry &e) {
+           w.integer(e.key);
+           w.integer(e.size);
+         });
+  writeFile(cache->indexPath(), w.bytes);
+
+  delete cache;
+}
+
+parse_cache_stats GetParseCacheStats(parse_cache *cache) {
+  if (cache == nullptr) {
+    return parse_cache_stats();
+  }
+  std::lock_guard<std::mutex> guard(cache->lock);
+  return cache->stats;
+}
+
+// summarize the file in b, which is consumed
+static bool summarizeBuffer(parse_cache *cache,
+                            bounded_buffer *b,
+                            pe_summary &out) {
+  record_header h{RECORD_MAGIC, CACHE_VERSION, LAYOUT, 0, b->bufLen, 0, 0};
+  if (cache != nullptr) {
+    xxh64_pair hash = Xxh64Pair(b->buf, b->bufLen, 0, CHECK_SEED);
+    h.key = hash.first;
+    h.check = hash.second;
+    if (cache->find(h, h.status, out)) {
+      deleteBuffer(b);
+      if (h.status != PEERR_NONE) {
+        out = pe_summary();
+        PE_ERR(h.status);
+        return false;
+      }
+      return true;
+    }
+  }
+
+  // the parse takes b over
+  parsed_pe *pe = ParsePEFromBuffer(b);
+  if (pe == nullptr) {
+    out = pe_summary();
+    h.status = GetPEErr();
+  } else {
+    SummarizePE(pe, out);
+    DestructParsedPE(pe);
+  }
+
+  if (cache != nullptr) {
+    std::uint32_t status = err;
+    error_location loc = err_loc;
+    cache->store(h, out);
+    err = status;
+    err_loc = loc;
+  }
+  return h.status == PEERR_NONE;
+}
+
+bool GetPESummary(parse_cache *cache,
+                  std::uint8_t *data,
+                  std::uint32_t len,
+                  pe_summary &out) {
+  bounded_buffer *b = makeBufferFromPointer(data, len);
+  if (b == nullptr) {
+    // err is set by makeBufferFromPointer
+    return false;
+  }
+  return summarizeBuffer(cache, b, out);
+}
+
+bool GetPESummaryFromFile(parse_cache *cache,
+                          const char *filePath,
+                          pe_summary &out) {
+  bounded_buffer *b = readFileToFileBuffer(filePath);
+  if (b == nullptr) {
+    // err is set by readFileToFileBuffer
+    return false;
+  }
+  return summarizeBuffer(cache, b, out);
+}
+
+} // namespace peparse
@@ -0,0 +1,701 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
+
+// keep these headers above "windows.h" because they contain many types
+#include <pe-parse/parse.h>
+#include <pe-parse/resolver.h>
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define VC_EXTRALEAN
+
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace peparse {
+
+extern std::uint32_t err;
+extern error_location err_loc;
+
+namespace {
+
+const char kDbMagic[8] = {'P', 'E', 'X', 'D', 'B', '\0', '\0', '\1'};
+
+// the Windows loader gives up on forwarder chains long before this
+constexpr std::uint32_t kMaxForwarderHops = 32;
+
+enum class module_state {
+  pending, // added but not parsed yet
+  cached, // read from a saved database, not yet checked against the file
+  indexed,
+  failed,
+};
+
+struct module_entry {
+  std::string path;
+  std::string fileName;
+  std::uint64_t size;
+  std::int64_t mtime;
+  module_state state;
+  // sorted by ordinal; aliases share an ordinal
+  std::vector<export_ref> exports;
+  std::unordered_map<std::string, std::size_t> byName;
+};
+
+bool statFile(const std::string &path,
+              std::uint64_t &size,
+              std::int64_t &mtime) {
+#ifdef _WIN32
+  WIN32_FILE_ATTRIBUTE_DATA a;
+  if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &a) ||
+      (a.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+    return false;
+  }
+
+  size = (static_cast<std::uint64_t>(a.nFileSizeHigh) << 32) | a.nFileSizeLow;
+  mtime = static_cast<std::int64_t>(
+      (static_cast<std::uint64_t>(a.ftLastWriteTime.dwHighDateTime) << 32) |
+      a.ftLastWriteTime.dwLowDateTime);
+#else
+  struct stat s;
+  if (stat(path.c_str(), &s) != 0 || !S_ISREG(s.st_mode)) {
+    return false;
+  }
+
+  size = static_cast<std::uint64_t>(s.st_size);
+#if defined(__APPLE__)
+  mtime = static_cast<std::int64_t>(s.st_mtimespec.tv_sec) * 1000000000 +
+          s.st_mtimespec.tv_nsec;
+#else
+  mtime = static_cast<std::int64_t>(s.st_mtim.tv_sec) * 1000000000 +
+          s.st_mtim.tv_nsec;
+#endif
+#endif
+  return true;
+}
+
+std::string baseName(const std::string &path) {
+  std::string::size_type slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool endsWithDll(const std::string &s) {
+  if (s.size() < 4) {
+    return false;
+  }
+
+  std::string ext = s.substr(s.size() - 4);
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return ext == ".dll";
+}
+
+// Modules are looked up case-insensitively and without a ".dll" extension,
+// which is how forwarder strings name them
+std::string moduleKey(const std::string &name) {
+  std::string key = endsWithDll(name) ? name.substr(0, name.size() - 4) : name;
+  std::transform(key.begin(), key.end(), key.begin(), [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return key;
+}
+
+// Parses "#<decimal>", as used by forwarders that import by ordinal
+bool parseOrdinal(const std::string &symbol, std::uint32_t &ordinal) {
+  if (symbol.size() < 2 || symbol.size() > 11 || symbol[0] != '#') {
+    return false;
+  }
+
+  std::uint64_t v = 0;
+  for (std::size_t i = 1; i < symbol.size(); i++) {
+    if (symbol[i] < '0' || symbol[i] > '9') {
+      return false;
+    }
+    v = v * 10 + static_cast<std::uint64_t>(symbol[i] - '0');
+  }
+
+  if (v > 0xFFFFFFFF) {
+    return false;
+  }
+
+  ordinal = static_cast<std::uint32_t>(v);
+  return true;
+}
+
+bool splitForwarder(const std::string &forwardName,
+                    std::string &module,
+                    std::string &symbol) {
+  std::string::size_type dot = forwardName.find('.');
+  if (dot == std::string::npos || dot == 0 || dot + 1 == forwardName.size()) {
+    return false;
+  }
+
+  module = forwardName.substr(0, dot);
+  symbol = forwardName.substr(dot + 1);
+  return true;
+}
+
+int collectExport(void *cbd, const export_ref &r) {
+  static_cast<std::vector<export_ref> *>(cbd)->push_back(r);
+  return 0;
+}
+
+void buildNameIndex(module_entry &m) {
+  std::stable_sort(m.exports.begin(),
+                   m.exports.end(),
+                   [](const export_ref &a, const export_ref &b) {
+                     return a.ordinal < b.ordinal;
+                   });
+
+  m.byName.clear();
+  for (std::size_t i = 0; i < m.exports.size(); i++) {
+    if (!m.exports[i].symbolName.empty()) {
+      m.byName.emplace(m.exports[i].symbolName, i);
+    }
+  }
+}
+
+bool indexModule(module_entry &m) {
+  m.exports.clear();
+  m.byName.clear();
+
+  if (!statFile(m.path, m.size, m.mtime)) {
+    PE_ERR(PEERR_OPEN);
+    return false;
+  }
+
+  parsed_pe *pe = ParsePEFromFile(m.path.c_str());
+  if (pe == nullptr) {
+    return false;
+  }
+
+  IterExpRefs(pe, collectExport, &m.exports);
+  DestructParsedPE(pe);
+
+  buildNameIndex(m);
+  return true;
+}
+
+const export_ref *findExport(const module_entry &m, const std::string &symbol) {
+  std::uint32_t ordinal;
+  if (parseOrdinal(symbol, ordinal)) {
+    auto it = std::lower_bound(m.exports.begin(),
+                               m.exports.end(),
+                               ordinal,
+                               [](const export_ref &e, std::uint32_t o) {
+                                 return e.ordinal < o;
+                               });
+    if (it == m.exports.end() || it->ordinal != ordinal) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  auto it = m.byName.find(symbol);
+  if (it == m.byName.end()) {
+    return nullptr;
+  }
+  return &m.exports[it->second];
+}
+
+// Simple length-prefixed little-endian encoding for SaveExportDb
+void writeU32(std::ostream &os, std::uint32_t v) {
+  char b[4];
+  for (std::size_t i = 0; i < 4; i++) {
+    b[i] = static_cast<char>((v >> (8 * i)) & 0xFF);
+  }
+  os.write(b, 4);
+}
+
+void writeU64(std::ostream &os, std::uint64_t v) {
+  writeU32(os, static_cast<std::uint32_t>(v));
+  writeU32(os, static_cast<std::uint32_t>(v >> 32));
+}
+
+void writeString(std::ostream &os, const std::string &s) {
+  writeU32(os, static_cast<std::uint32_t>(s.size()));
+  os.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+struct db_reader {
+  const std::vector<char> &data;
+  std::size_t off;
+
+  bool u32(std::uint32_t &v) {
+    if (data.size() - off < 4) {
+      return false;
+    }
+    v = 0;
+    for (std::size_t i = 0; i < 4; i++) {
+      v |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(data[off + i]))
+           << (8 * i);
+    }
+    off += 4;
+    return true;
+  }
+
+  bool u64(std::uint64_t &v) {
+    std::uint32_t lo;
+    std::uint32_t hi;
+    if (!u32(lo) || !u32(hi)) {
+      return false;
+    }
+    v = (static_cast<std::uint64_t>(hi) << 32) | lo;
+    return true;
+  }
+
+  bool str(std::string &s) {
+    std::uint32_t len;
+    if (!u32(len) || data.size() - off < len) {
+      return false;
+    }
+    s.assign(data.data() + off, len);
+    off += len;
+    return true;
+  }
+};
+
+} // namespace
+
+struct export_db {
+  std::unordered_map<std::string, module_entry> modules;
+  // results of earlier queries, keyed by module key and symbol; dropped
+  // whenever the set of modules changes
+  std::unordered_map<std::string, resolved_export> resolved;
+};
+
+export_db *CreateExportDb() {
+  return new (std::nothrow) export_db();
+}
+
+void DestroyExportDb(export_db *db) {
+  delete db;
+}
+
+namespace {
+
+module_entry *getModule(export_db *db, const std::string &key) {
+  auto it = db->modules.find(key);
+  if (it == db->modules.end()) {
+    return nullptr;
+  }
+
+  module_entry &m = it->second;
+  if (m.state == module_state::cached) {
+    std::uint64_t size;
+    std::int64_t mtime;
+    if (statFile(m.path, size, mtime) && size == m.size && mtime == m.mtime) {
+      m.state = module_state::indexed;
+    } else {
+      m.state = module_state::pending;
+    }
+  }
+
+  if (m.state == module_state::pending) {
+    m.state = indexModule(m) ? module_state::indexed : module_state::failed;
+  }
+
+  return m.state == module_state::indexed ? &m : nullptr;
+}
+
+bool resolveChain(export_db *db,
+                  std::string module,
+                  std::string symbol,
+                  resolved_export &out) {
+  std::unordered_set<std::string> seen;
+
+  out.ordinal = 0;
+  out.addr = 0;
+  out.hops = 0;
+
+  while (true) {
+    std::string key = moduleKey(module);
+    out.moduleName = module;
+    out.symbolName = symbol;
+
+    if (!seen.insert(key + '\0' + symbol).second ||
+        out.hops > kMaxForwarderHops) {
+      out.status = resolve_status::loop;
+      return false;
+    }
+
+    const module_entry *m = getModule(db, key);
+    if (m == nullptr) {
+      out.status = resolve_status::missing_module;
+      return false;
+    }
+
+    const export_ref *e = findExport(*m, symbol);
+    if (e == nullptr) {
+      out.status = resolve_status::missing_export;
+      return false;
+    }
+
+    if (e->forwardName.empty()) {
+      out.status = resolve_status::ok;
+      out.moduleName = m->fileName;
+      out.symbolName = e->symbolName;
+      out.ordinal = e->ordinal;
+      out.addr = e->addr;
+      return true;
+    }
+
+    if (!splitForwarder(e->forwardName, module, symbol)) {
+      out.status = resolve_status::missing_module;
+      out.moduleName = e->forwardName;
+      out.symbolName.clear();
+      return false;
+    }
+
+    out.hops++;
+  }
+}
+
+} // namespace
+
+bool ExportDbAddFile(export_db *db, const char *path) {
+  if (db == nullptr || path == nullptr) {
+    return false;
+  }
+
+  module_entry m;
+  m.path = path;
+  m.fileName = baseName(m.path);
+  m.state = module_state::pending;
+  if (!statFile(m.path, m.size, m.mtime)) {
+    PE_ERR(PEERR_OPEN);
+    return false;
+  }
+
+  std::string key = moduleKey(m.fileName);
+  auto it = db->modules.find(key);
+  if (it != db->modules.end()) {
+    // already known, possibly from a saved database
+    return it->second.path == m.path;
+  }
+
+  db->modules.emplace(key, std::move(m));
+  db->resolved.clear();
+  return true;
+}
+
+std::size_t ExportDbAddDirectory(export_db *db, const char *path) {
+  if (db == nullptr || path == nullptr) {
+    return 0;
+  }
+
+  std::string dir = path;
+  std::vector<std::string> names;
+
+#ifdef _WIN32
+  WIN32_FIND_DATAA fd;
+  HANDLE h = FindFirstFileA((dir + "\\*.dll").c_str(), &fd);
+  if (h == INVALID_HANDLE_VALUE) {
+    if (GetLastError() != ERROR_FILE_NOT_FOUND) {
+      PE_ERR(PEERR_OPEN);
+    }
+    return 0;
+  }
+
+  do {
+    if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+      names.emplace_back(fd.cFileName);
+    }
+  } while (FindNextFileA(h, &fd));
+  FindClose(h);
+
+  const char sep = '\\';
+#else
+  DIR *d = opendir(path);
+  if (d == nullptr) {
+    PE_ERR(PEERR_OPEN);
+    return 0;
+  }
+
+  while (const struct dirent *ent = readdir(d)) {
+    names.emplace_back(ent->d_name);
+  }
+  closedir(d);
+
+  const char sep = '/';
+#endif
+
+  if (!dir.empty() && dir.back() != '/' && dir.back() != '\\') {
+    dir += sep;
+  }
+
+  // directory order is arbitrary; sort so that names differing only in case
+  // always resolve to the same file
+  std::sort(names.begin(), names.end());
+
+  std::size_t added = 0;
+  for (const std::string &name : names) {
+    if (endsWithDll(name) && ExportDbAddFile(db, (dir + name).c_str())) {
+      added++;
+    }
+  }
+
+  return added;
+}
+
+namespace {
+
+bool resolveMemo(export_db *db,
+                 const std::string &key,
+                 const std::string &module,
+                 const std::string &symbol,
+                 resolved_export &out) {
+  std::string memoKey = key + '\0' + symbol;
+  auto it = db->resolved.find(memoKey);
+  if (it != db->resolved.end()) {
+    out = it->second;
+    return out.status == resolve_status::ok;
+  }
+
+  bool ok = resolveChain(db, module, symbol, out);
+  db->resolved.emplace(std::move(memoKey), out);
+  return ok;
+}
+
+int collectImport(void *cbd, const import_ref &r) {
+  static_cast<std::vector<import_ref> *>(cbd)->push_back(r);
+  return 0;
+}
+
+} // namespace
+
+bool ResolveExport(export_db *db,
+                   const std::string &module,
+                   const std::string &symbol,
+                   resolved_export &out) {
+  if (db == nullptr) {
+    return false;
+  }
+
+  return resolveMemo(db, moduleKey(module), module, symbol, out);
+}
+
+bool ResolveForwarder(export_db *db,
+                      const std::string &forwardName,
+                      resolved_export &out) {
+  std::string module;
+  std::string symbol;
+  if (!splitForwarder(forwardName, module, symbol)) {
+    out = resolved_export{};
+    out.status = resolve_status::missing_module;
+    out.moduleName = forwardName;
+    return false;
+  }
+
+  return ResolveExport(db, module, symbol, out);
+}
+
+std::size_t ResolveForwarders(export_db *db,
+                              const std::vector<std::string> &forwardNames,
+                              std::vector<resolved_export> &out) {
+  out.resize(forwardNames.size());
+
+  std::size_t ok = 0;
+  for (std::size_t i = 0; i < forwardNames.size(); i++) {
+    if (ResolveForwarder(db, forwardNames[i], out[i])) {
+      ok++;
+    }
+  }
+
+  return ok;
+}
+
+std::size_t ResolveImports(export_db *db,
+                           parsed_pe *pe,
+                           std::vector<import_binding> &out) {
+  out.clear();
+  if (db == nullptr || pe == nullptr) {
+    return 0;
+  }
+
+  std::vector<import_ref> imports;
+  IterImpRefs(pe, collectImport, &imports);
+  out.resize(imports.size());
+
+  // imports are grouped by module, so the module key only changes once
+  // per import descriptor
+  std::string module;
+  std::string key;
+  std::size_t ok = 0;
+  for (std::size_t i = 0; i < imports.size(); i++) {
+    import_ref &imp = imports[i];
+    import_binding &b = out[i];
+
+    if (i == 0 || imp.moduleName != module) {
+      module = imp.moduleName;
+      key = moduleKey(module);
+    }
+
+    std::string symbol = imp.symbolName;
+    if (imp.byOrdinal) {
+      symbol = "#" + std::to_string(static_cast<unsigned>(imp.ordinal));
+    }
+    if (resolveMemo(db, key, module, symbol, b.target)) {
+      ok++;
+    }
+
+    b.iatAddr = imp.addr;
+    b.moduleName = std::move(imp.moduleName);
+    b.symbolName = std::move(imp.symbolName);
+  }
+
+  return ok;
+}
+
+bool SaveExportDb(export_db *db, const char *path) {
+  if (db == nullptr || path == nullptr) {
+    return false;
+  }
+
+  std::ofstream os(path, std::ios::binary | std::ios::trunc);
+  if (!os) {
+    PE_ERR(PEERR_OPEN);
+    return false;
+  }
+
+  std::vector<const module_entry *> mods;
+  for (const auto &p : db->modules) {
+    if (p.second.state == module_state::indexed ||
+        p.second.state == module_state::cached) {
+      mods.push_back(&p.second);
+    }
+  }
+
+  os.write(kDbMagic, sizeof(kDbMagic));
+  writeU32(os, static_cast<std::uint32_t>(mods.size()));
+  for (const module_entry *m : mods) {
+    writeString(os, m->path);
+    writeU64(os, m->size);
+    writeU64(os, static_cast<std::uint64_t>(m->mtime));
+    writeU32(os, static_cast<std::uint32_t>(m->exports.size()));
+    for (const export_ref &e : m->exports) {
+      writeU64(os, e.addr);
+      writeU32(os, e.ordinal);
+      writeString(os, e.symbolName);
+      writeString(os, e.moduleName);
+      writeString(os, e.forwardName);
+    }
+  }
+
+  // flush, so that a full disk shows up here rather than on close
+  os.flush();
+  if (!os) {
+    PE_ERR(PEERR_WRITE);
+    return false;
+  }
+
+  return true;
+}
+
+bool LoadExportDb(export_db *db, const char *path) {
+  if (db == nullptr || path == nullptr) {
+    return false;
+  }
+
+  std::ifstream is(path, std::ios::binary);
+  if (!is) {
+    PE_ERR(PEERR_OPEN);
+    return false;
+  }
+
+  std::vector<char> data((std::istreambuf_iterator<char>(is)),
+                         std::istreambuf_iterator<char>());
+  if (data.size() < sizeof(kDbMagic) ||
+      std::memcmp(data.data(), kDbMagic, sizeof(kDbMagic)) != 0) {
+    PE_ERR(PEERR_MAGIC);
+    return false;
+  }
+
+  db_reader r{data, sizeof(kDbMagic)};
+  std::vector<module_entry> mods;
+
+  std::uint32_t numModules;
+  if (!r.u32(numModules)) {
+    PE_ERR(PEERR_READ);
+    return false;
+  }
+
+  for (std::uint32_t i = 0; i < numModules; i++) {
+    module_entry m;
+    std::uint64_t mtime;
+    std::uint32_t numExports;
+    if (!r.str(m.path) || !r.u64(m.size) || !r.u64(mtime) ||
+        !r.u32(numExports)) {
+      PE_ERR(PEERR_READ);
+      return false;
+    }
+
+    m.fileName = baseName(m.path);
+    m.mtime = static_cast<std::int64_t>(mtime);
+    m.state = module_state::cached;
+
+    for (std::uint32_t j = 0; j < numExports; j++) {
+      export_ref e;
+      if (!r.u64(e.addr) || !r.u32(e.ordinal) || !r.str(e.symbolName) ||
+          !r.str(e.moduleName) || !r.str(e.forwardName)) {
+        PE_ERR(PEERR_READ);
+        return false;
+      }
+      m.exports.push_back(std::move(e));
+    }
+
+    buildNameIndex(m);
+    mods.push_back(std::move(m));
+  }
+
+  for (module_entry &m : mods) {
+    std::string key = moduleKey(m.fileName);
+    auto it = db->modules.find(key);
+    if (it == db->modules.end()) {
+      db->modules.emplace(key, std::move(m));
+    } else if (it->second.path == m.path &&
+               it->second.state == module_state::pending) {
+      it->second = std::move(m);
+    }
+  }
+
+  db->resolved.clear();
+  return true;
+}
+
+} // namespace peparse
@@ -0,0 +1,300 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <pe-parse/digest.h>
+
+/*
+ * The SHA extensions are detected at run time, so the accelerated path is
+ * compiled with a per-function target attribute rather than requiring the
+ * whole library to be built for a CPU that has them.
+ */
+#include "simd.h"
+
+#if defined(PEPARSE_HAVE_X86_DISPATCH) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace peparse {
+
+namespace {
+
+alignas(16) const std::uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline std::uint32_t rotr(std::uint32_t x, std::uint32_t n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+inline std::uint32_t loadBE32(const std::uint8_t *p) {
+  return static_cast<std::uint32_t>(p[0]) << 24 |
+         static_cast<std::uint32_t>(p[1]) << 16 |
+         static_cast<std::uint32_t>(p[2]) << 8 |
+         static_cast<std::uint32_t>(p[3]);
+}
+
+void compressPortable(std::uint32_t state[8],
+                      const std::uint8_t *data,
+                      std::size_t blocks) {
+  std::uint32_t w[64];
+  for (; blocks != 0; blocks--, data += 64) {
+    for (std::size_t i = 0; i < 16; i++) {
+      w[i] = loadBE32(data + 4 * i);
+    }
+    for (std::size_t i = 16; i < 64; i++) {
+      std::uint32_t s0 =
+          rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      std::uint32_t s1 =
+          rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (std::size_t i = 0; i < 64; i++) {
+      std::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                         ((e & f) ^ (~e & g)) + K[i] + w[i];
+      std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                         ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#if defined(PEPARSE_HAVE_X86_DISPATCH)
+bool detectShaNi() {
+  unsigned int a, b, c, d;
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0);
+  if (regs[0] < 7) {
+    return false;
+  }
+  __cpuid(regs, 1);
+  c = static_cast<unsigned int>(regs[2]);
+  __cpuidex(regs, 7, 0);
+  b = static_cast<unsigned int>(regs[1]);
+  (void) a;
+  (void) d;
+#else
+  if (__get_cpuid_max(0, nullptr) < 7 || !__get_cpuid(1, &a, &b, &c, &d)) {
+    return false;
+  }
+  unsigned int c1 = c;
+  __cpuid_count(7, 0, a, b, c, d);
+  c = c1;
+#endif
+  // SSSE3 and SSE4.1 in leaf 1 ECX, SHA in leaf 7 EBX
+  return (c & (1u << 9)) != 0 && (c & (1u << 19)) != 0 &&
+         (b & (1u << 29)) != 0;
+}
+
+/*
+ * Four rounds per iteration: the state is kept as ABEF/CDGH pairs, as the
+ * sha256rnds2 instruction expects, and the message schedule is computed
+ * four words at a time into the slot of the block that is no longer
+ * needed.
+ */
+PEPARSE_TARGET("sha,sse4.1") void compressShaNi(std::uint32_t state[8],
+                                                const std::uint8_t *data,
+                                                std::size_t blocks) {
+  const __m128i byteSwap =
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0]));
+  __m128i cdgh = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4]));
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);
+  cdgh = _mm_shuffle_epi32(cdgh, 0x1B);
+  __m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+  cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+  for (; blocks != 0; blocks--, data += 64) {
+    const __m128i abefSave = abef;
+    const __m128i cdghSave = cdgh;
+
+    __m128i msg[4];
+    for (int i = 0; i < 4; i++) {
+      msg[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i)),
+          byteSwap);
+    }
+
+    for (int r = 0; r < 16; r++) {
+      __m128i wk = _mm_add_epi32(
+          msg[r & 3],
+          _mm_load_si128(reinterpret_cast<const __m128i *>(&K[4 * r])));
+      cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+
+      if (r < 12) {
+        __m128i next = _mm_sha256msg1_epu32(msg[r & 3], msg[(r + 1) & 3]);
+        next = _mm_add_epi32(
+            next, _mm_alignr_epi8(msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+        msg[r & 3] = _mm_sha256msg2_epu32(next, msg[(r + 3) & 3]);
+      }
+
+      wk = _mm_shuffle_epi32(wk, 0x0E);
+      abef = _mm_sha256rnds2_epu32(abef, cdgh, wk);
+    }
+
+    abef = _mm_add_epi32(abef, abefSave);
+    cdgh = _mm_add_epi32(cdgh, cdghSave);
+  }
+
+  tmp = _mm_shuffle_epi32(abef, 0x1B);
+  cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]),
+                   _mm_blend_epi16(tmp, cdgh, 0xF0));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]),
+                   _mm_alignr_epi8(cdgh, tmp, 8));
+}
+#endif
+
+void compress(sha256_ctx &ctx, const std::uint8_t *data, std::size_t blocks) {
+#if defined(PEPARSE_HAVE_X86_DISPATCH)
+  if (ctx.accelerated) {
+    compressShaNi(ctx.state, data, blocks);
+    return;
+  }
+#endif
+  compressPortable(ctx.state, data, blocks);
+}
+
+} // namespace
+
+bool Sha256Accelerated() {
+#if defined(PEPARSE_HAVE_X86_DISPATCH)
+  static const bool shaNi = detectShaNi();
+  return shaNi;
+#else
+  return false;
+#endif
+}
+
+void Sha256Init(sha256_ctx &ctx) {
+  static const std::uint32_t init[8] = {0x6a09e667,
+                                        0xbb67ae85,
+                                        0x3c6ef372,
+                                        0xa54ff53a,
+                                        0x510e527f,
+                                        0x9b05688c,
+                                        0x1f83d9ab,
+                                        0x5be0cd19};
+  std::memcpy(ctx.state, init, sizeof(init));
+  ctx.length = 0;
+  ctx.blockLen = 0;
+  ctx.accelerated = Sha256Accelerated();
+}
+
+void Sha256Update(sha256_ctx &ctx, const std::uint8_t *data, std::size_t len) {
+  ctx.length += len;
+
+  if (ctx.blockLen != 0) {
+    std::size_t take = std::min<std::size_t>(len, 64 - ctx.blockLen);
+    std::memcpy(ctx.block + ctx.blockLen, data, take);
+    ctx.blockLen += static_cast<std::uint32_t>(take);
+    data += take;
+    len -= take;
+    if (ctx.blockLen < 64) {
+      return;
+    }
+    compress(ctx, ctx.block, 1);
+    ctx.blockLen = 0;
+  }
+
+  // whole blocks are hashed straight from the caller's buffer
+  if (len >= 64) {
+    compress(ctx, data, len / 64);
+    data += len & ~static_cast<std::size_t>(63);
+    len &= 63;
+  }
+
+  if (len != 0) {
+    std::memcpy(ctx.block, data, len);
+    ctx.blockLen = static_cast<std::uint32_t>(len);
+  }
+}
+
+void Sha256Final(sha256_ctx &ctx, sha256_digest &out) {
+  std::uint64_t bits = ctx.length * 8;
+
+  ctx.block[ctx.blockLen++] = 0x80;
+  if (ctx.blockLen > 56) {
+    std::memset(ctx.block + ctx.blockLen, 0, 64 - ctx.blockLen);
+    compress(ctx, ctx.block, 1);
+    ctx.blockLen = 0;
+  }
+  std::memset(ctx.block + ctx.blockLen, 0, 56 - ctx.blockLen);
+  for (std::size_t i = 0; i < 8; i++) {
+    ctx.block[56 + i] = static_cast<std::uint8_t>(bits >> (56 - 8 * i));
+  }
+  compress(ctx, ctx.block, 1);
+
+  for (std::size_t i = 0; i < 8; i++) {
+    out[4 * i] = static_cast<std::uint8_t>(ctx.state[i] >> 24);
+    out[4 * i + 1] = static_cast<std::uint8_t>(ctx.state[i] >> 16);
+    out[4 * i + 2] = static_cast<std::uint8_t>(ctx.state[i] >> 8);
+    out[4 * i + 3] = static_cast<std::uint8_t>(ctx.state[i]);
+  }
+}
+
+sha256_digest Sha256(const std::uint8_t *data, std::size_t len) {
+  sha256_ctx ctx;
+  Sha256Init(ctx);
+  Sha256Update(ctx, data, len);
+
+  sha256_digest out;
+  Sha256Final(ctx, out);
+  return out;
+}
+
+} // namespace peparse
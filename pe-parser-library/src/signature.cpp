@@ -0,0 +1,424 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <new>
+
+#include <pe-parse/parse.h>
+
+namespace peparse {
+
+extern std::uint32_t err;
+extern error_location err_loc;
+
+namespace {
+
+// the longest literal stretch of a pattern that goes into the automaton;
+// longer ones don't find candidates any more selectively
+constexpr std::size_t MAX_ANCHOR = 16;
+
+struct compiled_pattern {
+  std::vector<std::uint8_t> value;
+  std::vector<std::uint8_t> mask;
+  // the literal bytes looked for by the automaton, at this offset into the
+  // pattern
+  std::size_t anchorOffset;
+  std::size_t anchorLength;
+};
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool parsePattern(const std::string &text, compiled_pattern &p) {
+  // each byte is two nibbles, each a hex digit or ?
+  std::uint8_t value = 0;
+  std::uint8_t mask = 0;
+  bool high = true;
+  for (char c : text) {
+    if (c == ' ' || c == '\t') {
+      if (!high) {
+        return false;
+      }
+      continue;
+    }
+
+    value = static_cast<std::uint8_t>(value << 4);
+    mask = static_cast<std::uint8_t>(mask << 4);
+    if (c != '?') {
+      int d = hexDigit(c);
+      if (d < 0) {
+        return false;
+      }
+      value = static_cast<std::uint8_t>(value | d);
+      mask = static_cast<std::uint8_t>(mask | 0xF);
+    }
+
+    if (!high) {
+      p.value.push_back(value);
+      p.mask.push_back(mask);
+      value = 0;
+      mask = 0;
+    }
+    high = !high;
+  }
+  if (!high) {
+    return false;
+  }
+
+  // anchor on the longest run of fully known bytes
+  std::size_t best = 0;
+  std::size_t bestLength = 0;
+  for (std::size_t i = 0; i < p.mask.size();) {
+    if (p.mask[i] != 0xFF) {
+      i++;
+      continue;
+    }
+    std::size_t j = i;
+    while (j < p.mask.size() && p.mask[j] == 0xFF) {
+      j++;
+    }
+    if (j - i > bestLength) {
+      best = i;
+      bestLength = j - i;
+    }
+    i = j;
+  }
+  if (bestLength == 0) {
+    return false;
+  }
+
+  p.anchorOffset = best;
+  p.anchorLength = std::min(bestLength, MAX_ANCHOR);
+  return true;
+}
+
+} // namespace
+
+/*
+ * An Aho-Corasick automaton over the patterns' anchors, with states numbered
+ * breadth first. Scanning spends nearly all of its time in the shallowest
+ * states, so the first DENSE_STATES of them get a full 256-entry row of
+ * transitions; deeper states keep their trie edges sorted by byte and fall
+ * back along their failure links, which always lead to shallower states.
+ * Every pattern whose anchor ends at a state, directly or through a failure
+ * link, is listed with it, and is checked in full against the data when the
+ * state is reached.
+ */
+constexpr std::size_t DENSE_STATES = 1024;
+
+struct signature_set {
+  std::vector<compiled_pattern> patterns;
+  std::size_t maxLength;
+
+  std::vector<std::uint32_t> dense;
+  std::uint32_t denseStates;
+  // true if so many bytes begin an anchor that skipping through the bytes
+  // that don't is not worth it
+  bool busyRoot;
+  // state s's edges are [edgeBegin[s], edgeBegin[s + 1])
+  std::vector<std::uint32_t> edgeBegin;
+  std::vector<std::uint8_t> edgeByte;
+  std::vector<std::uint32_t> edgeTarget;
+  std::vector<std::uint32_t> fail;
+  // state s's patterns are [outBegin[s], outBegin[s + 1])
+  std::vector<std::uint32_t> outBegin;
+  std::vector<std::uint32_t> outPattern;
+
+  std::uint32_t next(std::uint32_t s, std::uint8_t c) const {
+    while (s >= denseStates) {
+      for (std::uint32_t e = edgeBegin[s]; e < edgeBegin[s + 1]; e++) {
+        if (edgeByte[e] == c) {
+          return edgeTarget[e];
+        }
+      }
+      s = fail[s];
+    }
+    return dense[std::size_t{s} * 256 + c];
+  }
+};
+
+signature_set *CompileSignatures(const std::vector<std::string> &patterns) {
+  signature_set *set = new (std::nothrow) signature_set();
+  if (set == nullptr) {
+    PE_ERR(PEERR_MEM);
+    return nullptr;
+  }
+
+  set->patterns.resize(patterns.size());
+  set->maxLength = 0;
+  for (std::size_t i = 0; i < patterns.size(); i++) {
+    if (!parsePattern(patterns[i], set->patterns[i])) {
+      delete set;
+      PE_ERR(PEERR_PATTERN);
+      return nullptr;
+    }
+    set->maxLength =
+        std::max(set->maxLength, set->patterns[i].value.size());
+  }
+
+  // the trie of anchors
+  std::vector<std::map<std::uint8_t, std::uint32_t>> children(1);
+  std::vector<std::vector<std::uint32_t>> out(1);
+  for (std::size_t i = 0; i < set->patterns.size(); i++) {
+    const compiled_pattern &p = set->patterns[i];
+    std::uint32_t s = 0;
+    for (std::size_t k = 0; k < p.anchorLength; k++) {
+      std::uint8_t c = p.value[p.anchorOffset + k];
+      auto it = children[s].find(c);
+      if (it != children[s].end()) {
+        s = it->second;
+        continue;
+      }
+      auto t = static_cast<std::uint32_t>(children.size());
+      children[s][c] = t;
+      children.emplace_back();
+      out.emplace_back();
+      s = t;
+    }
+    out[s].push_back(static_cast<std::uint32_t>(i));
+  }
+
+  // failure links, breadth first so that each state's link is done before
+  // its children need it; order is the breadth-first numbering
+  const std::size_t states = children.size();
+  std::vector<std::uint32_t> fail(states, 0);
+  std::vector<std::uint32_t> order(1, 0);
+  for (std::size_t q = 0; q < order.size(); q++) {
+    std::uint32_t s = order[q];
+    for (const auto &edge : children[s]) {
+      std::uint32_t f = 0;
+      if (s != 0) {
+        f = fail[s];
+        for (;;) {
+          auto it = children[f].find(edge.first);
+          if (it != children[f].end()) {
+            f = it->second;
+            break;
+          }
+          if (f == 0) {
+            break;
+          }
+          f = fail[f];
+        }
+      }
+      fail[edge.second] = f;
+      out[edge.second].insert(
+          out[edge.second].end(), out[f].begin(), out[f].end());
+      order.push_back(edge.second);
+    }
+  }
+
+  std::vector<std::uint32_t> number(states);
+  for (std::size_t n = 0; n < states; n++) {
+    number[order[n]] = static_cast<std::uint32_t>(n);
+  }
+
+  set->fail.resize(states);
+  set->edgeBegin.reserve(states + 1);
+  set->outBegin.reserve(states + 1);
+  for (std::size_t n = 0; n < states; n++) {
+    std::uint32_t s = order[n];
+    set->fail[n] = number[fail[s]];
+    set->edgeBegin.push_back(
+        static_cast<std::uint32_t>(set->edgeByte.size()));
+    for (const auto &edge : children[s]) {
+      set->edgeByte.push_back(edge.first);
+      set->edgeTarget.push_back(number[edge.second]);
+    }
+    set->outBegin.push_back(
+        static_cast<std::uint32_t>(set->outPattern.size()));
+    set->outPattern.insert(
+        set->outPattern.end(), out[s].begin(), out[s].end());
+  }
+  set->edgeBegin.push_back(static_cast<std::uint32_t>(set->edgeByte.size()));
+  set->outBegin.push_back(
+      static_cast<std::uint32_t>(set->outPattern.size()));
+
+  // a missing edge goes wherever the failure link's row does, which is
+  // already filled in since the link is to a shallower state
+  set->denseStates =
+      static_cast<std::uint32_t>(std::min(states, DENSE_STATES));
+  set->dense.assign(std::size_t{set->denseStates} * 256, 0);
+  for (std::uint32_t n = 0; n < set->denseStates; n++) {
+    std::uint32_t *row = &set->dense[std::size_t{n} * 256];
+    if (n != 0) {
+      std::memcpy(row,
+                  &set->dense[std::size_t{set->fail[n]} * 256],
+                  256 * sizeof(std::uint32_t));
+    }
+    for (std::uint32_t e = set->edgeBegin[n]; e < set->edgeBegin[n + 1];
+         e++) {
+      row[set->edgeByte[e]] = set->edgeTarget[e];
+    }
+  }
+
+  set->busyRoot = std::count_if(set->dense.begin(),
+                                set->dense.begin() + 256,
+                                [](std::uint32_t t) { return t != 0; }) >= 64;
+
+  return set;
+}
+
+void DestructSignatureSet(signature_set *set) {
+  delete set;
+}
+
+namespace {
+
+// the automaton follows one dependent load per byte, so unless most bytes
+// can be skipped at the root, a long buffer is split into this many
+// stretches that are scanned side by side
+constexpr std::size_t STREAMS = 4;
+constexpr std::size_t MIN_STREAM = 16 * 1024;
+
+struct scan_stream {
+  std::size_t pos;
+  // scanning stops here, past hi far enough to finish any match starting
+  // before hi
+  std::size_t stop;
+  // only matches starting in [lo, hi) are this stream's to report
+  std::size_t lo;
+  std::size_t hi;
+  std::uint32_t state;
+};
+
+// check the patterns whose anchors end at data[i] in state s
+void checkState(const signature_set *set,
+                std::uint32_t s,
+                const std::uint8_t *data,
+                std::size_t len,
+                std::size_t i,
+                const scan_stream &stream,
+                std::vector<signature_hit> &out) {
+  for (std::uint32_t o = set->outBegin[s]; o < set->outBegin[s + 1]; o++) {
+    std::uint32_t index = set->outPattern[o];
+    const compiled_pattern &p = set->patterns[index];
+    std::size_t anchorEnd = p.anchorOffset + p.anchorLength;
+    if (i + 1 < anchorEnd) {
+      continue;
+    }
+    std::size_t start = i + 1 - anchorEnd;
+    if (start < stream.lo || start >= stream.hi ||
+        p.value.size() > len - start) {
+      continue;
+    }
+
+    const std::uint8_t *at = data + start;
+    bool match = true;
+    for (std::size_t k = 0; k < p.value.size(); k++) {
+      if ((at[k] & p.mask[k]) != p.value[k]) {
+        match = false;
+        break;
+      }
+    }
+    if (match) {
+      out.push_back({index, start});
+    }
+  }
+}
+
+void step(const signature_set *set,
+          const std::uint8_t *data,
+          std::size_t len,
+          scan_stream &stream,
+          std::vector<signature_hit> &out) {
+  std::uint32_t s = set->next(stream.state, data[stream.pos]);
+  stream.state = s;
+  if (set->outBegin[s] != set->outBegin[s + 1]) {
+    checkState(set, s, data, len, stream.pos, stream, out);
+  }
+  stream.pos++;
+}
+
+} // namespace
+
+void FindSignatures(const signature_set *set,
+                    const std::uint8_t *data,
+                    std::size_t len,
+                    std::vector<signature_hit> &out) {
+  out.clear();
+
+  std::size_t n =
+      set->busyRoot && len >= STREAMS * MIN_STREAM ? STREAMS : 1;
+  scan_stream streams[STREAMS];
+  const std::size_t stretch = len / n;
+  for (std::size_t k = 0; k < n; k++) {
+    scan_stream &stream = streams[k];
+    stream.lo = k * stretch;
+    stream.hi = k + 1 == n ? len : stream.lo + stretch;
+    stream.pos = stream.lo;
+    stream.stop = std::min(len, stream.hi + set->maxLength);
+    stream.state = 0;
+  }
+
+  if (n > 1) {
+    std::size_t common = len;
+    for (const scan_stream &stream : streams) {
+      common = std::min(common, stream.stop - stream.pos);
+    }
+    for (std::size_t i = 0; i < common; i++) {
+      for (std::size_t k = 0; k < STREAMS; k++) {
+        step(set, data, len, streams[k], out);
+      }
+    }
+  }
+
+  for (std::size_t k = 0; k < n; k++) {
+    scan_stream &stream = streams[k];
+    while (stream.pos < stream.stop) {
+      // most bytes leave the automaton at the root
+      if (stream.state == 0) {
+        while (stream.pos < stream.stop && set->dense[data[stream.pos]] == 0) {
+          stream.pos++;
+        }
+        if (stream.pos == stream.stop) {
+          break;
+        }
+      }
+      step(set, data, len, stream, out);
+    }
+  }
+
+  std::sort(out.begin(),
+            out.end(),
+            [](const signature_hit &a, const signature_hit &b) {
+              return a.offset != b.offset ? a.offset < b.offset
+                                          : a.pattern < b.pattern;
+            });
+}
+
+} // namespace peparse
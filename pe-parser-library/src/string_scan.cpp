@@ -0,0 +1,274 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cstring>
+
+#include <pe-parse/string_scan.h>
+
+#include "simd.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace peparse {
+
+namespace {
+
+/*
+ * The data is classified 64 bytes at a time into two bitmasks, one of
+ * printable bytes and one of zero bytes. An ASCII string is a run of set
+ * bits in the first; a UTF-16LE character is a printable byte followed by a
+ * zero byte, so the UTF-16LE strings starting at even and at odd offsets
+ * are runs in the even and odd bits of printable & (zero >> 1). Runs are
+ * found a mask at a time, and runs too short to report are masked out
+ * before looking at individual bits, so code and padding cost a handful of
+ * vector compares and shifts per block.
+ */
+constexpr std::size_t BLOCK = 64;
+
+// runs are filtered by whether they are at least this long, or minLength
+// if that is shorter, before being followed bit by bit
+constexpr unsigned FILTER_LENGTH = 16;
+
+inline bool isPrintable(std::uint8_t c) {
+  return (c >= 0x20 && c <= 0x7E) || c == '\t';
+}
+
+void classify(const std::uint8_t *p,
+              std::uint64_t &printable,
+              std::uint64_t &zero) {
+  printable = 0;
+  zero = 0;
+#if defined(PEPARSE_HAVE_SSE2)
+  // c + 0x60 is below -33 as a signed byte exactly when c is 0x20 to 0x7E
+  const __m128i bias = _mm_set1_epi8(0x60);
+  const __m128i limit = _mm_set1_epi8(-33);
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i nul = _mm_setzero_si128();
+  for (unsigned i = 0; i < BLOCK / 16; i++) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p) + i);
+    __m128i pr = _mm_or_si128(
+        _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit), _mm_cmpeq_epi8(v, tab));
+    __m128i nz = _mm_cmpeq_epi8(v, nul);
+    printable |= static_cast<std::uint64_t>(
+                     static_cast<std::uint32_t>(_mm_movemask_epi8(pr)))
+                 << (i * 16);
+    zero |= static_cast<std::uint64_t>(
+                static_cast<std::uint32_t>(_mm_movemask_epi8(nz)))
+            << (i * 16);
+  }
+#else
+  for (std::size_t i = 0; i < BLOCK; i++) {
+    printable |= static_cast<std::uint64_t>(isPrintable(p[i])) << i;
+    zero |= static_cast<std::uint64_t>(p[i] == 0) << i;
+  }
+#endif
+}
+
+inline unsigned countTrailingZeros(std::uint64_t v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long i;
+  _BitScanForward64(&i, v);
+  return static_cast<unsigned>(i);
+#elif defined(_MSC_VER)
+  unsigned long i;
+  if (_BitScanForward(&i, static_cast<std::uint32_t>(v))) {
+    return static_cast<unsigned>(i);
+  }
+  _BitScanForward(&i, static_cast<std::uint32_t>(v >> 32));
+  return static_cast<unsigned>(i) + 32;
+#else
+  return static_cast<unsigned>(__builtin_ctzll(v));
+#endif
+}
+
+// gather the even bits of v into the low 32 bits
+inline std::uint64_t evenBits(std::uint64_t v) {
+  v &= UINT64_C(0x5555555555555555);
+  v = (v | (v >> 1)) & UINT64_C(0x3333333333333333);
+  v = (v | (v >> 2)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+  v = (v | (v >> 4)) & UINT64_C(0x00FF00FF00FF00FF);
+  v = (v | (v >> 8)) & UINT64_C(0x0000FFFF0000FFFF);
+  v = (v | (v >> 16)) & UINT64_C(0x00000000FFFFFFFF);
+  return v;
+}
+
+// follows the runs of set bits in one stream of character positions: every
+// byte for ASCII, or every other byte from an even or odd offset for UTF-16.
+// masks are processed one behind, so that the next one is known when
+// filtering out short runs
+class run_tracker {
+public:
+  run_tracker(std::uint32_t encoding,
+              std::size_t phase,
+              std::size_t minLength,
+              std::vector<string_match> &out)
+      : encoding_(encoding),
+        phase_(phase),
+        minLength_(minLength),
+        filter_(static_cast<unsigned>(
+            std::min<std::size_t>(minLength, FILTER_LENGTH))),
+        out_(out) {
+  }
+
+  // bits (32 or 64) is the number of positions in mask
+  void feed(std::uint64_t mask, unsigned bits) {
+    if (pendingBits_ != 0) {
+      process(mask);
+    }
+    pending_ = mask;
+    pendingBits_ = bits;
+  }
+
+  // end is the number of positions in the stream
+  void finish(std::size_t end) {
+    if (pendingBits_ != 0) {
+      process(0);
+    }
+    close(end);
+  }
+
+private:
+  void process(std::uint64_t next) {
+    const unsigned bits = pendingBits_;
+    const std::uint64_t full =
+        bits == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+    const std::uint64_t mask = pending_ & full;
+    const std::size_t base = base_;
+    base_ += bits;
+
+    if (open_ && mask == full) {
+      return;
+    }
+
+    // starts of windows of filter_ set positions; the first one after a gap
+    // is where a long enough run starts
+    std::uint64_t starts = mask;
+    for (unsigned k = 1; k < filter_ && starts != 0; k++) {
+      starts &= (mask >> k) | (next << (bits - k));
+    }
+    starts &= full;
+    if (!open_ && starts == 0) {
+      return;
+    }
+
+    for (unsigned bit = 0; bit < bits;) {
+      std::uint64_t m = (open_ ? ~mask & full : starts) >> bit;
+      if (m == 0) {
+        return;
+      }
+      bit += countTrailingZeros(m);
+      if (open_) {
+        close(base + bit);
+      } else {
+        start_ = base + bit;
+        open_ = true;
+      }
+    }
+  }
+
+  void close(std::size_t end) {
+    if (open_ && end - start_ >= minLength_) {
+      std::size_t stride = encoding_ == STRING_ASCII ? 1 : 2;
+      out_.push_back({start_ * stride + phase_, end - start_, encoding_});
+    }
+    open_ = false;
+  }
+
+  std::uint32_t encoding_;
+  std::size_t phase_;
+  std::size_t minLength_;
+  unsigned filter_;
+  std::vector<string_match> &out_;
+  std::uint64_t pending_ = 0;
+  unsigned pendingBits_ = 0;
+  std::size_t base_ = 0;
+  bool open_ = false;
+  std::size_t start_ = 0;
+};
+
+} // namespace
+
+void FindStrings(const std::uint8_t *data,
+                 std::size_t len,
+                 std::size_t minLength,
+                 std::uint32_t encodings,
+                 std::vector<string_match> &out) {
+  out.clear();
+  minLength = std::max<std::size_t>(minLength, 1);
+
+  const bool ascii = (encodings & STRING_ASCII) != 0;
+  const bool utf16 = (encodings & STRING_UTF16LE) != 0;
+  run_tracker asciiRuns(STRING_ASCII, 0, minLength, out);
+  run_tracker evenRuns(STRING_UTF16LE, 0, minLength, out);
+  run_tracker oddRuns(STRING_UTF16LE, 1, minLength, out);
+
+  // the tail is padded with bytes that are neither printable nor zero, so
+  // it can be classified like any other block
+  std::uint8_t tail[BLOCK];
+  for (std::size_t off = 0; off < len; off += BLOCK) {
+    const std::uint8_t *block = data + off;
+    if (len - off < BLOCK) {
+      std::memset(tail, 0x01, sizeof(tail));
+      std::memcpy(tail, block, len - off);
+      block = tail;
+    }
+
+    std::uint64_t printable;
+    std::uint64_t zero;
+    classify(block, printable, zero);
+
+    if (ascii) {
+      asciiRuns.feed(printable, 64);
+    }
+    if (utf16) {
+      // the last byte of the block pairs with the first byte of the next
+      std::uint64_t next = off + BLOCK < len && data[off + BLOCK] == 0;
+      std::uint64_t units = printable & ((zero >> 1) | (next << 63));
+      evenRuns.feed(evenBits(units), 32);
+      oddRuns.feed(evenBits(units >> 1), 32);
+    }
+  }
+
+  // a run still open reaches the end of the data, which for UTF-16 is the
+  // end of the last whole character
+  asciiRuns.finish(len);
+  evenRuns.finish(len / 2);
+  oddRuns.finish(len > 0 ? (len - 1) / 2 : 0);
+
+  // the streams each come out in order, but interleave with each other
+  if (utf16) {
+    std::sort(out.begin(),
+              out.end(),
+              [](const string_match &a, const string_match &b) {
+                return a.offset != b.offset ? a.offset < b.offset
+                                            : a.encoding < b.encoding;
+              });
+  }
+}
+
+} // namespace peparse
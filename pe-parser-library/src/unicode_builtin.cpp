@@ -0,0 +1,117 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2019 Trail of Bits, Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <cstdint>
+#include <string>
+
+#include <pe-parse/to_string.h>
+
+#include "simd.h"
+
+/*
+ * Self-contained UTF-16LE to UTF-8 conversion. Behaves like the ICU and
+ * Win32 backends: a string containing an unpaired surrogate converts to an
+ * empty string, and embedded NULs are preserved.
+ */
+
+namespace peparse {
+std::string from_utf16(const UCharString &u) {
+  if (u.empty()) {
+    return std::string();
+  }
+
+  const std::size_t n = u.size();
+  const auto *src = u.data();
+
+  // A single UTF-16 code unit never needs more than three UTF-8 bytes (a
+  // four byte sequence consumes a surrogate pair), so one allocation sized
+  // up front is always enough.
+  std::string result(n * 3, '\0');
+  char *out = &result[0];
+  std::size_t i = 0;
+
+#if defined(PEPARSE_HAVE_SSE2)
+  const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i zero = _mm_setzero_si128();
+#endif
+
+  while (i < n) {
+#if defined(PEPARSE_HAVE_SSE2)
+    // ASCII fast path: narrow eight code units at a time for as long as
+    // every one of them is below 0x80.
+    while (i + 8 <= n) {
+      __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      __m128i high = _mm_cmpeq_epi16(_mm_and_si128(v, nonAscii), zero);
+      if (_mm_movemask_epi8(high) != 0xFFFF) {
+        break;
+      }
+
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(out),
+                       _mm_packus_epi16(v, v));
+      out += 8;
+      i += 8;
+    }
+
+    if (i == n) {
+      break;
+    }
+#endif
+
+    auto c = static_cast<std::uint32_t>(static_cast<std::uint16_t>(src[i++]));
+
+    if (c < 0x80) {
+      *out++ = static_cast<char>(c);
+    } else if (c < 0x800) {
+      *out++ = static_cast<char>(0xC0 | (c >> 6));
+      *out++ = static_cast<char>(0x80 | (c & 0x3F));
+    } else if ((c & 0xF800) != 0xD800) {
+      *out++ = static_cast<char>(0xE0 | (c >> 12));
+      *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      *out++ = static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+      // Surrogates: a high surrogate must be followed by a low one.
+      if (c >= 0xDC00 || i == n) {
+        return std::string();
+      }
+
+      auto lo =
+          static_cast<std::uint32_t>(static_cast<std::uint16_t>(src[i]));
+      if ((lo & 0xFC00) != 0xDC00) {
+        return std::string();
+      }
+      i++;
+
+      std::uint32_t cp = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+      *out++ = static_cast<char>(0xF0 | (cp >> 18));
+      *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+      *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+  }
+
+  result.resize(static_cast<std::size_t>(out - result.data()));
+  return result;
+}
+} // namespace peparse
@@ -0,0 +1,168 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include <cstdint>
+#include <cstddef>
+
+#include <pe-parse/digest.h>
+
+namespace peparse {
+
+namespace {
+
+constexpr std::uint64_t P1 = 0x9E3779B185EBCA87;
+constexpr std::uint64_t P2 = 0xC2B2AE3D27D4EB4F;
+constexpr std::uint64_t P3 = 0x165667B19E3779F9;
+constexpr std::uint64_t P4 = 0x85EBCA77C2B2AE63;
+constexpr std::uint64_t P5 = 0x27D4EB2F165667C5;
+
+inline std::uint64_t rotl(std::uint64_t x, unsigned n) {
+  return (x << n) | (x >> (64 - n));
+}
+
+// the input is read as little-endian whatever the host; compilers turn
+// these into plain loads on little-endian targets
+inline std::uint32_t loadLE32(const std::uint8_t *p) {
+  return static_cast<std::uint32_t>(p[0]) |
+         static_cast<std::uint32_t>(p[1]) << 8 |
+         static_cast<std::uint32_t>(p[2]) << 16 |
+         static_cast<std::uint32_t>(p[3]) << 24;
+}
+
+inline std::uint64_t loadLE64(const std::uint8_t *p) {
+  return static_cast<std::uint64_t>(loadLE32(p)) |
+         static_cast<std::uint64_t>(loadLE32(p + 4)) << 32;
+}
+
+inline std::uint64_t laneRound(std::uint64_t acc, std::uint64_t input) {
+  acc += input * P2;
+  acc = rotl(acc, 31);
+  return acc * P1;
+}
+
+inline std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t v) {
+  acc ^= laneRound(0, v);
+  return acc * P1 + P4;
+}
+
+// the bytes left over from the lanes, and the final avalanche
+std::uint64_t finish(std::uint64_t h,
+                     const std::uint8_t *p,
+                     const std::uint8_t *end) {
+  for (; p + 8 <= end; p += 8) {
+    h ^= laneRound(0, loadLE64(p));
+    h = rotl(h, 27) * P1 + P4;
+  }
+  if (p + 4 <= end) {
+    h ^= static_cast<std::uint64_t>(loadLE32(p)) * P1;
+    h = rotl(h, 23) * P2 + P3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= *p * P5;
+    h = rotl(h, 11) * P1;
+  }
+
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+// XXH64 under N seeds at once: each stripe is loaded once and fed to the
+// lanes of every seed, so the data is only read once
+template <std::size_t N>
+void xxh64Seeds(const std::uint8_t *data,
+                std::size_t len,
+                const std::uint64_t (&seeds)[N],
+                std::uint64_t (&out)[N]) {
+  const std::uint8_t *p = data;
+  const std::uint8_t *end = data + len;
+  std::uint64_t h[N];
+
+  if (len >= 32) {
+    // four independent lanes of 8 bytes each per seed, so that the
+    // multiplies of one stripe overlap
+    std::uint64_t v[N][4];
+    for (std::size_t k = 0; k < N; k++) {
+      v[k][0] = seeds[k] + P1 + P2;
+      v[k][1] = seeds[k] + P2;
+      v[k][2] = seeds[k];
+      v[k][3] = seeds[k] - P1;
+    }
+    const std::uint8_t *limit = end - 32;
+    do {
+      std::uint64_t in[4] = {
+          loadLE64(p), loadLE64(p + 8), loadLE64(p + 16), loadLE64(p + 24)};
+      for (std::size_t k = 0; k < N; k++) {
+        for (std::size_t i = 0; i < 4; i++) {
+          v[k][i] = laneRound(v[k][i], in[i]);
+        }
+      }
+      p += 32;
+    } while (p <= limit);
+
+    for (std::size_t k = 0; k < N; k++) {
+      h[k] = rotl(v[k][0], 1) + rotl(v[k][1], 7) + rotl(v[k][2], 12) +
+             rotl(v[k][3], 18);
+      for (std::size_t i = 0; i < 4; i++) {
+        h[k] = mergeRound(h[k], v[k][i]);
+      }
+    }
+  } else {
+    for (std::size_t k = 0; k < N; k++) {
+      h[k] = seeds[k] + P5;
+    }
+  }
+
+  for (std::size_t k = 0; k < N; k++) {
+    out[k] = finish(h[k] + static_cast<std::uint64_t>(len), p, end);
+  }
+}
+
+} // namespace
+
+std::uint64_t Xxh64(const std::uint8_t *data,
+                    std::size_t len,
+                    std::uint64_t seed) {
+  const std::uint64_t seeds[1] = {seed};
+  std::uint64_t out[1];
+  xxh64Seeds(data, len, seeds, out);
+  return out[0];
+}
+
+xxh64_pair Xxh64Pair(const std::uint8_t *data,
+                     std::size_t len,
+                     std::uint64_t seed1,
+                     std::uint64_t seed2) {
+  const std::uint64_t seeds[2] = {seed1, seed2};
+  std::uint64_t out[2];
+  xxh64Seeds(data, len, seeds, out);
+  return {out[0], out[1]};
+}
+
+} // namespace peparse
@@ -96,6 +96,7 @@ struct pepy_import {
   PyObject_HEAD PyObject *name;
   PyObject *sym;
   PyObject *addr;
+  PyObject *delayload;
 };
 
 struct pepy_export {
@@ -126,8 +127,12 @@ pepy_import_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
 }
 
 static int pepy_import_init(pepy_import *self, PyObject *args, PyObject *kwds) {
-  if (!PyArg_ParseTuple(
-          args, "OOO:pepy_import_init", &self->name, &self->sym, &self->addr))
+  if (!PyArg_ParseTuple(args,
+                        "OOOO:pepy_import_init",
+                        &self->name,
+                        &self->sym,
+                        &self->addr,
+                        &self->delayload))
     return -1;
   return 0;
 }
@@ -136,17 +141,20 @@ static void pepy_import_dealloc(pepy_import *self) {
   Py_XDECREF(self->name);
   Py_XDECREF(self->sym);
   Py_XDECREF(self->addr);
+  Py_XDECREF(self->delayload);
   Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
 PEPY_OBJECT_GET(import, name);
 PEPY_OBJECT_GET(import, sym);
 PEPY_OBJECT_GET(import, addr);
+PEPY_OBJECT_GET(import, delayload);
 
 static PyGetSetDef pepy_import_getseters[] = {
     OBJECTGETTER(import, name, "Name"),
     OBJECTGETTER(import, sym, "Symbol"),
     OBJECTGETTER(import, addr, "Address"),
+    OBJECTGETTER(import, delayload, "Delay-loaded"),
     {NULL}};
 
 static PyTypeObject pepy_import_type = {
@@ -922,10 +930,7 @@ static PyObject *pepy_parsed_get_resources(PyObject *self, PyObject *args) {
   return ret;
 }
 
-int import_callback(void *cbd,
-                    const VA &addr,
-                    const std::string &name,
-                    const std::string &sym) {
+int import_callback(void *cbd, const import_ref &ref) {
   PyObject *imp;
   PyObject *tuple;
   PyObject *list = (PyObject *) cbd;
@@ -934,7 +939,11 @@ int import_callback(void *cbd,
    * The tuple item order is important here. It is passed into the
    * import type initialization and parsed there.
    */
-  tuple = Py_BuildValue("ssI", name.c_str(), sym.c_str(), addr);
+  tuple = Py_BuildValue("ssIO",
+                        ref.moduleName.c_str(),
+                        ref.symbolName.c_str(),
+                        static_cast<unsigned int>(ref.addr),
+                        ref.delayLoad ? Py_True : Py_False);
   if (!tuple)
     return 1;
 
@@ -965,7 +974,7 @@ static PyObject *pepy_parsed_get_imports(PyObject *self, PyObject *args) {
     return NULL;
   }
 
-  IterImpVAString(((pepy_parsed *) self)->pe, import_callback, ret);
+  IterImpRefs(((pepy_parsed *) self)->pe, import_callback, ret);
 
   return ret;
 }
@@ -1067,6 +1076,349 @@ static PyObject *pepy_parsed_get_relocations(PyObject *self, PyObject *args) {
   return ret;
 }
 
+int tls_callback(void *cbd, const VA &addr) {
+  PyObject *list = (PyObject *) cbd;
+
+  PyObject *va = PyLong_FromUnsignedLongLong(addr);
+  if (!va)
+    return 1;
+
+  if (PyList_Append(list, va) == -1) {
+    Py_DECREF(va);
+    return 1;
+  }
+
+  Py_DECREF(va);
+  return 0;
+}
+
+static PyObject *pepy_parsed_get_tls_callbacks(PyObject *self,
+                                               PyObject *args) {
+  PyObject *ret = PyList_New(0);
+  if (!ret) {
+    PyErr_SetString(pepy_error, "Unable to create new list.");
+    return NULL;
+  }
+
+  IterTlsCallbacks(((pepy_parsed *) self)->pe, tls_callback, ret);
+
+  return ret;
+}
+
+int certificate_callback(void *cbd, const certificate_entry &entry) {
+  PyObject *list = (PyObject *) cbd;
+
+  PyObject *data = PyBytes_FromStringAndSize(
+      reinterpret_cast<const char *>(entry.data),
+      static_cast<Py_ssize_t>(entry.length));
+  if (!data)
+    return 1;
+
+  // N steals the reference to data
+  PyObject *tuple = Py_BuildValue("(HHN)", entry.revision, entry.type, data);
+  if (!tuple)
+    return 1;
+
+  if (PyList_Append(list, tuple) == -1) {
+    Py_DECREF(tuple);
+    return 1;
+  }
+
+  Py_DECREF(tuple);
+  return 0;
+}
+
+static PyObject *pepy_parsed_get_certificates(PyObject *self,
+                                              PyObject *args) {
+  PyObject *ret = PyList_New(0);
+  if (!ret) {
+    PyErr_SetString(pepy_error, "Unable to create new list.");
+    return NULL;
+  }
+
+  IterCertificates(((pepy_parsed *) self)->pe, certificate_callback, ret);
+  if (PyErr_Occurred()) {
+    Py_DECREF(ret);
+    return NULL;
+  }
+
+  return ret;
+}
+
+/*
+ * Returns a dict with "import_hash", "exphash" and "rich_hash" keys for those
+ * fingerprints that were computed, and a "sections" list of
+ * (name, md5, sha256) tuples if section hashes were requested. Digests are
+ * hex strings; a section digest that was not requested is None.
+ */
+static PyObject *pepy_parsed_get_fingerprints(PyObject *self, PyObject *args) {
+  unsigned int which = FINGERPRINT_ALL;
+  pe_fingerprints fp;
+
+  if (!PyArg_ParseTuple(args, "|I:pepy_parsed_get_fingerprints", &which))
+    return NULL;
+
+  GetFingerprints(((pepy_parsed *) self)->pe, which, fp);
+
+  PyObject *ret = PyDict_New();
+  if (!ret) {
+    PyErr_SetString(pepy_error, "Unable to create new dict.");
+    return NULL;
+  }
+
+  struct {
+    std::uint32_t bit;
+    const char *key;
+    const md5_digest &digest;
+  } hashes[] = {{FINGERPRINT_IMPORT_HASH, "import_hash", fp.importHash},
+                {FINGERPRINT_EXPHASH, "exphash", fp.exphash},
+                {FINGERPRINT_RICH_HASH, "rich_hash", fp.richHash}};
+
+  for (const auto &h : hashes) {
+    if ((fp.computed & h.bit) == 0)
+      continue;
+
+    PyObject *hex = PyUnicode_FromString(DigestToHex(h.digest).c_str());
+    if (!hex || PyDict_SetItemString(ret, h.key, hex) == -1) {
+      Py_XDECREF(hex);
+      Py_DECREF(ret);
+      return NULL;
+    }
+    Py_DECREF(hex);
+  }
+
+  if ((fp.computed &
+       (FINGERPRINT_SECTION_MD5 | FINGERPRINT_SECTION_SHA256)) == 0)
+    return ret;
+
+  PyObject *sections = PyList_New(0);
+  if (!sections || PyDict_SetItemString(ret, "sections", sections) == -1) {
+    Py_XDECREF(sections);
+    Py_DECREF(ret);
+    return NULL;
+  }
+  Py_DECREF(sections);
+
+  for (const section_fingerprint &s : fp.sections) {
+    PyObject *md5 = Py_None;
+    PyObject *sha256 = Py_None;
+    Py_INCREF(md5);
+    Py_INCREF(sha256);
+    if (fp.computed & FINGERPRINT_SECTION_MD5) {
+      Py_DECREF(md5);
+      md5 = PyUnicode_FromString(DigestToHex(s.md5).c_str());
+    }
+    if (fp.computed & FINGERPRINT_SECTION_SHA256) {
+      Py_DECREF(sha256);
+      sha256 = PyUnicode_FromString(DigestToHex(s.sha256).c_str());
+    }
+
+    PyObject *tuple = NULL;
+    if (md5 && sha256)
+      tuple = Py_BuildValue("(sOO)", s.name.c_str(), md5, sha256);
+    Py_XDECREF(md5);
+    Py_XDECREF(sha256);
+
+    if (!tuple || PyList_Append(sections, tuple) == -1) {
+      Py_XDECREF(tuple);
+      Py_DECREF(ret);
+      return NULL;
+    }
+    Py_DECREF(tuple);
+  }
+
+  return ret;
+}
+
+/*
+ * Returns a list of (name, entropy, chi_square, histogram, profile) tuples,
+ * one per section in section table order. The histogram is a tuple of 256
+ * counts and the profile a list of windowed entropies, empty for sections
+ * smaller than profile_threshold.
+ */
+static PyObject *pepy_parsed_get_section_entropy(PyObject *self,
+                                                 PyObject *args) {
+  entropy_options opts;
+  Py_ssize_t threshold = static_cast<Py_ssize_t>(opts.profileThreshold);
+  std::vector<section_entropy> out;
+
+  if (!PyArg_ParseTuple(args,
+                        "|nIII:pepy_parsed_get_section_entropy",
+                        &threshold,
+                        &opts.windowSize,
+                        &opts.windowStep,
+                        &opts.threads))
+    return NULL;
+
+  if (threshold < 0) {
+    PyErr_SetString(pepy_error, "Profile threshold must not be negative.");
+    return NULL;
+  }
+  opts.profileThreshold = static_cast<std::size_t>(threshold);
+
+  GetSectionEntropy(((pepy_parsed *) self)->pe, opts, out);
+
+  PyObject *ret = PyList_New(0);
+  if (!ret) {
+    PyErr_SetString(pepy_error, "Unable to create new list.");
+    return NULL;
+  }
+
+  for (const section_entropy &e : out) {
+    PyObject *histogram = PyTuple_New(256);
+    PyObject *profile = PyList_New(0);
+    if (histogram) {
+      for (std::size_t i = 0; i < 256; i++) {
+        PyObject *n = PyLong_FromUnsignedLongLong(e.histogram[i]);
+        if (!n) {
+          Py_CLEAR(histogram);
+          break;
+        }
+        PyTuple_SET_ITEM(histogram, static_cast<Py_ssize_t>(i), n);
+      }
+    }
+    if (profile) {
+      for (double v : e.profile) {
+        PyObject *f = PyFloat_FromDouble(v);
+        if (!f || PyList_Append(profile, f) == -1) {
+          Py_XDECREF(f);
+          Py_CLEAR(profile);
+          break;
+        }
+        Py_DECREF(f);
+      }
+    }
+
+    PyObject *tuple = NULL;
+    if (histogram && profile)
+      tuple = Py_BuildValue("(sddNN)",
+                            e.name.c_str(),
+                            e.entropy,
+                            e.chiSquare,
+                            histogram,
+                            profile);
+    else {
+      Py_XDECREF(histogram);
+      Py_XDECREF(profile);
+    }
+
+    if (!tuple || PyList_Append(ret, tuple) == -1) {
+      Py_XDECREF(tuple);
+      Py_DECREF(ret);
+      return NULL;
+    }
+    Py_DECREF(tuple);
+  }
+
+  return ret;
+}
+
+int string_callback(void *cbd, const string_entry &entry) {
+  PyObject *list = (PyObject *) cbd;
+
+  PyObject *value =
+      PyUnicode_FromStringAndSize(entry.value.data(),
+                                  static_cast<Py_ssize_t>(entry.value.size()));
+  if (!value)
+    return 1;
+
+  // z turns the overlay's empty section name into None
+  PyObject *tuple = Py_BuildValue(
+      "(IzIKKN)",
+      entry.encoding,
+      entry.sectionName.empty() ? NULL : entry.sectionName.c_str(),
+      entry.rva,
+      static_cast<unsigned long long>(entry.va),
+      static_cast<unsigned long long>(entry.fileOffset),
+      value);
+  if (!tuple)
+    return 1;
+
+  if (PyList_Append(list, tuple) == -1) {
+    Py_DECREF(tuple);
+    return 1;
+  }
+
+  Py_DECREF(tuple);
+  return 0;
+}
+
+static PyObject *pepy_parsed_get_strings(PyObject *self, PyObject *args) {
+  unsigned int minLength = 4;
+  unsigned int encodings = STRING_ASCII | STRING_UTF16LE;
+
+  if (!PyArg_ParseTuple(
+          args, "|II:pepy_parsed_get_strings", &minLength, &encodings))
+    return NULL;
+
+  PyObject *ret = PyList_New(0);
+  if (!ret) {
+    PyErr_SetString(pepy_error, "Unable to create new list.");
+    return NULL;
+  }
+
+  IterStrings(((pepy_parsed *) self)->pe,
+              minLength,
+              encodings,
+              string_callback,
+              ret);
+  if (PyErr_Occurred()) {
+    Py_DECREF(ret);
+    return NULL;
+  }
+
+  return ret;
+}
+
+static PyObject *pepy_parsed_compute_checksum(PyObject *self,
+                                              PyObject *args) {
+  return PyLong_FromUnsignedLong(
+      ComputePEChecksum(((pepy_parsed *) self)->pe));
+}
+
+static PyObject *pepy_parsed_get_authenticode_digest(PyObject *self,
+                                                     PyObject *args) {
+  sha256_digest digest;
+
+  if (!GetAuthenticodeDigest(((pepy_parsed *) self)->pe, digest))
+    Py_RETURN_NONE;
+
+  return PyBytes_FromStringAndSize(
+      reinterpret_cast<const char *>(digest.data()),
+      static_cast<Py_ssize_t>(digest.size()));
+}
+
+/*
+ * Returns None, or (offset, data, appended_offset, appended) for the overlay
+ * in front of and behind the certificate table. Only this copies the overlay
+ * out of the file.
+ */
+static PyObject *pepy_parsed_get_overlay(PyObject *self, PyObject *args) {
+  pe_overlay overlay;
+
+  if (!GetOverlay(((pepy_parsed *) self)->pe, overlay))
+    Py_RETURN_NONE;
+
+  PyObject *data = PyBytes_FromStringAndSize(
+      reinterpret_cast<const char *>(overlay.data.data),
+      static_cast<Py_ssize_t>(overlay.data.length));
+  PyObject *appended = PyBytes_FromStringAndSize(
+      reinterpret_cast<const char *>(overlay.appended.data),
+      static_cast<Py_ssize_t>(overlay.appended.length));
+  if (!data || !appended) {
+    Py_XDECREF(data);
+    Py_XDECREF(appended);
+    return NULL;
+  }
+
+  return Py_BuildValue("(KNKN)",
+                       static_cast<unsigned long long>(overlay.data.offset),
+                       data,
+                       static_cast<unsigned long long>(
+                           overlay.appended.offset),
+                       appended);
+}
+
 #define PEPY_PARSED_GET(ATTR, VAL)                                         \
   static PyObject *pepy_parsed_get_##ATTR(PyObject *self, void *closure) { \
     PyObject *ret = PyLong_FromUnsignedLongLong(                           \
@@ -1237,6 +1589,38 @@ static PyMethodDef pepy_parsed_methods[] = {
      pepy_parsed_get_resources,
      METH_NOARGS,
      "Return a list of resource objects."},
+    {"get_tls_callbacks",
+     pepy_parsed_get_tls_callbacks,
+     METH_NOARGS,
+     "Return a list of TLS callback addresses."},
+    {"get_authenticode_digest",
+     pepy_parsed_get_authenticode_digest,
+     METH_NOARGS,
+     "Return the Authenticode SHA-256 image digest."},
+    {"get_certificates",
+     pepy_parsed_get_certificates,
+     METH_NOARGS,
+     "Return a list of (revision, type, data) certificate tuples."},
+    {"compute_checksum",
+     pepy_parsed_compute_checksum,
+     METH_NOARGS,
+     "Return the optional header checksum recomputed from the file."},
+    {"get_fingerprints",
+     pepy_parsed_get_fingerprints,
+     METH_VARARGS,
+     "Return a dict of the requested fingerprints (default: all)."},
+    {"get_section_entropy",
+     pepy_parsed_get_section_entropy,
+     METH_VARARGS,
+     "Return a list of per-section entropy tuples."},
+    {"get_strings",
+     pepy_parsed_get_strings,
+     METH_VARARGS,
+     "Return a list of (encoding, section, rva, va, offset, string) tuples."},
+    {"get_overlay",
+     pepy_parsed_get_overlay,
+     METH_NOARGS,
+     "Return the overlay, less the certificate table, or None."},
     {NULL}};
 
 static PyTypeObject pepy_parsed_type = {
@@ -1429,5 +1813,14 @@ PyMODINIT_FUNC PyInit_pepy(void) {
   PyModule_AddIntMacro(m, IMAGE_SCN_MEM_READ);
   PyModule_AddIntMacro(m, IMAGE_SCN_MEM_WRITE);
 
+  PyModule_AddIntMacro(m, FINGERPRINT_IMPORT_HASH);
+  PyModule_AddIntMacro(m, FINGERPRINT_EXPHASH);
+  PyModule_AddIntMacro(m, FINGERPRINT_RICH_HASH);
+  PyModule_AddIntMacro(m, FINGERPRINT_SECTION_MD5);
+  PyModule_AddIntMacro(m, FINGERPRINT_SECTION_SHA256);
+  PyModule_AddIntMacro(m, FINGERPRINT_ALL);
+  PyModule_AddIntMacro(m, STRING_ASCII);
+  PyModule_AddIntMacro(m, STRING_UTF16LE);
+
   return m;
 }
@@ -43,6 +43,14 @@ SOURCE_FILES = [
     os.path.join(pepy, "pepy.cpp"),
     os.path.join(here, "pe-parser-library", "src", "parse.cpp"),
     os.path.join(here, "pe-parser-library", "src", "buffer.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "sha256.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "checksum.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "md5.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "entropy.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "string_scan.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "signature.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "xxh64.cpp"),
+    os.path.join(here, "pe-parser-library", "src", "parse_cache.cpp"),
 ]
 
 INCLUDE_DIRS = []
@@ -64,9 +72,6 @@ if platform.system() == "Windows":
     ]
     COMPILE_ARGS = ["/EHsc"]
 else:
-    SOURCE_FILES.append(
-        os.path.join(here, "pe-parser-library", "src", "unicode_libicu.cpp")
-    )
     INCLUDE_DIRS += [
         "/usr/local/include",
         "/opt/local/include",
@@ -74,15 +79,25 @@ else:
         os.path.join(here, "pe-parser-library", "include"),
     ]
     LIBRARY_DIRS += ["/usr/lib", "/usr/local/lib"]
-    LIBRARIES += ["icuuc"]
     COMPILE_ARGS = ["-std=c++17"]
 
-    # Add Homebrew ICU paths on macOS if ICU_ROOT is set
-    if platform.system() == "Darwin":
-        icu_root = os.environ.get("ICU_ROOT")
-        if icu_root:
-            INCLUDE_DIRS.insert(0, os.path.join(icu_root, "include"))
-            LIBRARY_DIRS.insert(0, os.path.join(icu_root, "lib"))
+    # The built-in UTF-16 decoder is used unless PEPARSE_USE_ICU is set
+    if os.environ.get("PEPARSE_USE_ICU", "0") not in ("", "0"):
+        SOURCE_FILES.append(
+            os.path.join(here, "pe-parser-library", "src", "unicode_libicu.cpp")
+        )
+        LIBRARIES += ["icuuc"]
+
+        # Add Homebrew ICU paths on macOS if ICU_ROOT is set
+        if platform.system() == "Darwin":
+            icu_root = os.environ.get("ICU_ROOT")
+            if icu_root:
+                INCLUDE_DIRS.insert(0, os.path.join(icu_root, "include"))
+                LIBRARY_DIRS.insert(0, os.path.join(icu_root, "lib"))
+    else:
+        SOURCE_FILES.append(
+            os.path.join(here, "pe-parser-library", "src", "unicode_builtin.cpp")
+        )
 
 extension_mod = Extension(
     "pepy",
@@ -0,0 +1,485 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+// Benchmarks are hidden from the default run; use `tests "[benchmark]"`.
+
+namespace peparse {
+
+TEST_CASE("Primitive read throughput", "[.][benchmark]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  bounded_buffer *b = readFileToFileBuffer(path.string().c_str());
+
+  REQUIRE(b);
+
+  BENCHMARK("readDword little-endian") {
+    std::uint32_t sum = 0;
+    std::uint32_t v;
+    for (std::uint32_t i = 0; i + 4 <= b->bufLen; i += 2) {
+      readDword(b, i, v);
+      sum += v;
+    }
+    return sum;
+  };
+
+  BENCHMARK("readDword big-endian") {
+    std::uint32_t sum = 0;
+    std::uint32_t v;
+    for (std::uint32_t i = 0; i + 4 <= b->bufLen; i += 2) {
+      readDword<byte_order::big>(b, i, v);
+      sum += v;
+    }
+    return sum;
+  };
+
+  BENCHMARK("readWord little-endian") {
+    std::uint32_t sum = 0;
+    std::uint16_t v;
+    for (std::uint32_t i = 0; i + 2 <= b->bufLen; i += 2) {
+      readWord(b, i, v);
+      sum += v;
+    }
+    return sum;
+  };
+
+  deleteBuffer(b);
+}
+
+TEST_CASE("Full parse throughput", "[.][benchmark]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  bounded_buffer *b = readFileToFileBuffer(path.string().c_str());
+
+  REQUIRE(b);
+
+  BENCHMARK("ParsePEFromPointer example.exe") {
+    parsed_pe *p = ParsePEFromPointer(b->buf, b->bufLen);
+    bool ok = p != nullptr;
+    DestructParsedPE(p);
+    return ok;
+  };
+
+  deleteBuffer(b);
+}
+
+TEST_CASE("Relocation and symbol parse throughput", "[.][benchmark]") {
+  // A relocation- and symbol-heavy image, where the parse is mostly
+  // primitive reads: 128 base relocation blocks of 1024 DIR64 entries, and
+  // 32k COFF symbols, every other one named through the string table
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x1000, 0xCC));
+
+  std::vector<std::uint8_t> relocs;
+  for (std::uint32_t page = 0; page < 128; page++) {
+    std::size_t off = relocs.size();
+    test::put32(relocs, off, 0x1000 + page * 0x1000);
+    test::put32(relocs, off + 4, 8 + 2 * 1024);
+    for (std::uint16_t i = 0; i < 1024; i++) {
+      test::put16(relocs,
+                  off + 8 + 2 * i,
+                  static_cast<std::uint16_t>((RELOC_DIR64 << 12) | (i * 4)));
+    }
+  }
+  std::uint32_t reloc = builder.addSection(".reloc", relocs);
+  builder.setDataDirectory(
+      DIR_BASERELOC, reloc, static_cast<std::uint32_t>(relocs.size()));
+
+  const std::uint32_t numSymbols = 32 * 1024;
+  std::vector<std::uint8_t> symtab(18 * numSymbols, 0);
+  std::vector<std::uint8_t> strings(4, 0);
+  for (std::uint32_t i = 0; i < numSymbols; i++) {
+    std::size_t off = 18 * i;
+    if (i % 2 == 0) {
+      std::string name = "long_symbol_name_" + std::to_string(i);
+      test::put32(symtab, off + 4, static_cast<std::uint32_t>(strings.size()));
+      strings.insert(strings.end(), name.begin(), name.end());
+      strings.push_back(0);
+    } else {
+      std::string name = "s" + std::to_string(i);
+      for (std::size_t c = 0; c < name.size(); c++) {
+        symtab[off + c] = static_cast<std::uint8_t>(name[c]);
+      }
+    }
+    test::put32(symtab, off + 8, (i * 16) % 0x1000);
+    test::put16(symtab, off + 12, 1);
+    symtab[off + 16] = IMAGE_SYM_CLASS_EXTERNAL;
+  }
+  test::put32(strings, 0, static_cast<std::uint32_t>(strings.size()));
+  symtab.insert(symtab.end(), strings.begin(), strings.end());
+  builder.setSymbolTable(builder.overlayOffset(), numSymbols);
+  builder.setOverlay(symtab);
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *check = ParsePEFromPointer(
+      image.data(), static_cast<std::uint32_t>(image.size()));
+  REQUIRE(check);
+  std::size_t counts[2] = {0, 0};
+  IterRelocs(
+      check,
+      [](void *cbd, const VA &, const reloc_type &) {
+        static_cast<std::size_t *>(cbd)[0]++;
+        return 0;
+      },
+      counts);
+  IterSymbols(
+      check,
+      [](void *cbd,
+         const std::string &,
+         const std::uint32_t &,
+         const std::int16_t &,
+         const std::uint16_t &,
+         const std::uint8_t &,
+         const std::uint8_t &) {
+        static_cast<std::size_t *>(cbd)[1]++;
+        return 0;
+      },
+      counts);
+  REQUIRE(counts[0] == 128 * 1024);
+  REQUIRE(counts[1] == numSymbols);
+  DestructParsedPE(check);
+
+  BENCHMARK("ParsePEFromPointer 128k relocations, 32k symbols") {
+    parsed_pe *p = ParsePEFromPointer(image.data(),
+                                      static_cast<std::uint32_t>(image.size()));
+    bool ok = p != nullptr;
+    DestructParsedPE(p);
+    return ok;
+  };
+}
+
+TEST_CASE("Malformed input rejection throughput", "[.][benchmark]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  bounded_buffer *b = readFileToFileBuffer(path.string().c_str());
+
+  REQUIRE(b);
+
+  // Truncations and header corruptions that each fail somewhere different
+  // in the parser, so that error reporting dominates the run time.
+  std::vector<std::vector<std::uint8_t>> inputs;
+  for (std::uint32_t len : {0x10u, 0x40u, 0x100u, 0x180u, 0x200u, 0x400u}) {
+    inputs.emplace_back(b->buf, b->buf + len);
+  }
+
+  std::vector<std::uint8_t> badMagic(b->buf, b->buf + b->bufLen);
+  badMagic[0xf8 + 0x18] ^= 0xff;
+  inputs.push_back(badMagic);
+
+  std::vector<std::uint8_t> badLfanew(b->buf, b->buf + b->bufLen);
+  badLfanew[0x3c] = 0xff;
+  badLfanew[0x3d] = 0xff;
+  inputs.push_back(badLfanew);
+
+  deleteBuffer(b);
+
+  for (auto &in : inputs) {
+    parsed_pe *p =
+        ParsePEFromPointer(in.data(), static_cast<std::uint32_t>(in.size()));
+    REQUIRE(p == nullptr);
+  }
+
+  BENCHMARK("ParsePEFromPointer malformed inputs") {
+    std::uint32_t failures = 0;
+    for (auto &in : inputs) {
+      parsed_pe *p = ParsePEFromPointer(in.data(),
+                                        static_cast<std::uint32_t>(in.size()));
+      if (p == nullptr) {
+        failures++;
+      }
+      DestructParsedPE(p);
+    }
+    return failures;
+  };
+}
+
+namespace {
+
+int collectIATSlot(void *cbd,
+                   const VA &addr,
+                   const std::string &,
+                   const std::string &) {
+  static_cast<std::vector<VA> *>(cbd)->push_back(addr);
+  return 0;
+}
+
+} // namespace
+
+TEST_CASE("IAT slot lookup throughput", "[.][benchmark]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  parsed_pe *p = ParsePEFromFile(path.string().c_str());
+
+  REQUIRE(p);
+
+  // Every IAT slot, repeated as a disassembler would see calls through them
+  std::vector<VA> iat;
+  IterImpVAString(p, collectIATSlot, &iat);
+  REQUIRE(!iat.empty());
+
+  std::vector<VA> slots;
+  for (std::size_t i = 0; i < 100000; i++) {
+    slots.push_back(iat[(i * 7) % iat.size()]);
+  }
+
+  std::vector<const import_ref *> out;
+  BENCHMARK("FindImportsByIAT 100k slots") {
+    return FindImportsByIAT(p, slots, out);
+  };
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Import walk throughput", "[.][benchmark]") {
+  // An import-heavy image: 64 modules with 256 named imports each
+  std::vector<test::import_spec> modules;
+  for (int m = 0; m < 64; m++) {
+    test::import_spec spec;
+    spec.module = "module" + std::to_string(m) + ".dll";
+    for (int i = 0; i < 256; i++) {
+      spec.symbols.push_back("Function" + std::to_string(i));
+    }
+    modules.push_back(spec);
+  }
+
+  test::pe_builder builder;
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> sec =
+      test::buildImportSection(idata, true, modules);
+  builder.addSection(".idata", sec);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(sec.size()));
+  std::vector<std::uint8_t> image = builder.build();
+
+  BENCHMARK("ParsePEFromPointer 16k imports") {
+    parsed_pe *p = ParsePEFromPointer(image.data(),
+                                      static_cast<std::uint32_t>(image.size()));
+    bool ok = p != nullptr;
+    DestructParsedPE(p);
+    return ok;
+  };
+}
+
+TEST_CASE("CFG target lookup throughput", "[.][benchmark]") {
+  // A GuardCF table of 64k functions, 16 bytes apart, with no metadata
+  const std::uint32_t count = 0x10000;
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(count * 16, 0xCC));
+
+  std::uint32_t rva = builder.nextSectionRva();
+  std::vector<std::uint8_t> rdata(0x108, 0);
+  test::put32(rdata, 0, 0x108);
+  test::put64(rdata, 0x80, builder.imageBase() + rva + 0x108);
+  test::put64(rdata, 0x88, count);
+  test::put32(rdata, 0x90, IMAGE_GUARD_CF_INSTRUMENTED);
+  for (std::uint32_t i = 0; i < count; i++) {
+    test::put32(rdata, 0x108 + i * 4, 0x1000 + i * 16);
+  }
+  builder.addSection(".rdata", rdata);
+  builder.setDataDirectory(DIR_LOAD_CONFIG, rva, 0x108);
+  std::vector<std::uint8_t> image = builder.build();
+
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+  REQUIRE(IsCFGTarget(p, 0x1000));
+
+  BENCHMARK("IsCFGTarget 1M queries") {
+    std::size_t hits = 0;
+    for (std::uint32_t i = 0; i < 1000000; i++) {
+      hits += IsCFGTarget(p, 0x1000 + ((i * 40503u) & 0xFFFFF)) ? 1 : 0;
+    }
+    return hits;
+  };
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("SHA-256 throughput", "[.][benchmark]") {
+  std::vector<std::uint8_t> data(1 << 20);
+  for (std::size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<std::uint8_t>(i * 131);
+  }
+
+  auto run = [&](bool accelerated) {
+    sha256_ctx ctx;
+    Sha256Init(ctx);
+    ctx.accelerated = accelerated;
+    Sha256Update(ctx, data.data(), data.size());
+    sha256_digest out;
+    Sha256Final(ctx, out);
+    return out[0];
+  };
+
+  BENCHMARK("SHA-256 1 MiB portable") {
+    return run(false);
+  };
+
+  if (Sha256Accelerated()) {
+    BENCHMARK("SHA-256 1 MiB SHA-NI") {
+      return run(true);
+    };
+  }
+}
+
+TEST_CASE("PE checksum throughput", "[.][benchmark]") {
+  // a large installer-like image: a small .text and a 64 MiB overlay
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x1000, 0xCC));
+  std::vector<std::uint8_t> overlay(64 << 20);
+  for (std::size_t i = 0; i < overlay.size(); i++) {
+    overlay[i] = static_cast<std::uint8_t>(i * 131);
+  }
+  builder.setOverlay(overlay);
+  std::vector<std::uint8_t> image = builder.build();
+
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  BENCHMARK("ComputePEChecksum 64 MiB") {
+    return ComputePEChecksum(p);
+  };
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Byte histogram throughput", "[.][benchmark]") {
+  std::vector<std::uint8_t> noise(16 << 20);
+  std::uint32_t x = 1;
+  for (std::uint8_t &b : noise) {
+    x = x * 1103515245 + 12345;
+    b = static_cast<std::uint8_t>(x >> 24);
+  }
+  std::vector<std::uint8_t> padding(16 << 20, 0);
+
+  BENCHMARK("AddByteHistogram 16 MiB noise") {
+    byte_histogram h = {};
+    AddByteHistogram(h, noise.data(), noise.size());
+    return h[0];
+  };
+
+  BENCHMARK("AddByteHistogram 16 MiB padding") {
+    byte_histogram h = {};
+    AddByteHistogram(h, padding.data(), padding.size());
+    return h[0];
+  };
+
+  BENCHMARK("EntropyProfile 16 MiB, 4 KiB windows every 1 KiB") {
+    return EntropyProfile(noise.data(), noise.size(), 4096, 1024).size();
+  };
+
+  test::pe_builder builder;
+  builder.addSection(".text", noise);
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  entropy_options opts;
+  opts.profileThreshold = 0;
+  BENCHMARK("GetSectionEntropy 16 MiB section") {
+    std::vector<section_entropy> out;
+    GetSectionEntropy(p, opts, out);
+    return out.size();
+  };
+
+  opts.threads = 4;
+  BENCHMARK("GetSectionEntropy 16 MiB section, 4 threads") {
+    std::vector<section_entropy> out;
+    GetSectionEntropy(p, opts, out);
+    return out.size();
+  };
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("String extraction throughput", "[.][benchmark]") {
+  // code-like noise with a short ASCII or UTF-16LE string every 4 KiB
+  std::vector<std::uint8_t> data(16 << 20);
+  std::uint32_t x = 1;
+  for (std::size_t i = 0; i < data.size(); i++) {
+    x = x * 1103515245 + 12345;
+    data[i] = static_cast<std::uint8_t>(x >> 24);
+    if (i % 4096 < 24) {
+      data[i] = i % 8192 < 4096 ? 'a' : ((i & 1) != 0 ? 0 : 'w');
+    }
+  }
+
+  BENCHMARK("FindStrings 16 MiB, ASCII and UTF-16LE") {
+    std::vector<string_match> out;
+    FindStrings(data.data(), data.size(), 4, STRING_ASCII | STRING_UTF16LE,
+                out);
+    return out.size();
+  };
+}
+
+TEST_CASE("Signature scanning throughput", "[.][benchmark]") {
+  // 1000 PEiD-sized signatures with wildcards, over 16 MiB of noise
+  std::uint32_t x = 1;
+  auto rand = [&x]() {
+    x = x * 1103515245 + 12345;
+    return x >> 16;
+  };
+  static const char hex[] = "0123456789ABCDEF";
+  std::vector<std::string> patterns;
+  for (int i = 0; i < 1000; i++) {
+    std::string p;
+    for (int k = 0; k < 16; k++) {
+      if (k % 5 == 4) {
+        p += "?? ";
+      } else {
+        p += hex[rand() & 0xF];
+        p += hex[rand() & 0xF];
+        p += ' ';
+      }
+    }
+    patterns.push_back(p);
+  }
+  signature_set *set = CompileSignatures(patterns);
+  REQUIRE(set != nullptr);
+
+  std::vector<std::uint8_t> data(16 << 20);
+  for (std::uint8_t &b : data) {
+    b = static_cast<std::uint8_t>(rand());
+  }
+
+  BENCHMARK("FindSignatures 1000 signatures, 16 MiB") {
+    std::vector<signature_hit> hits;
+    FindSignatures(set, data.data(), data.size(), hits);
+    return hits.size();
+  };
+
+  DestructSignatureSet(set);
+}
+
+TEST_CASE("Parse cache throughput", "[.][benchmark]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  bounded_buffer *b = readFileToFileBuffer(path.string().c_str());
+  REQUIRE(b);
+
+  fs::path dir = fs::temp_directory_path() / "pe-parse-cache-benchmark";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  parse_cache *cache = OpenParseCache(dir.string().c_str(), 1 << 20);
+  REQUIRE(cache);
+
+  BENCHMARK("GetPESummary example.exe, no cache") {
+    pe_summary s;
+    return GetPESummary(nullptr, b->buf, b->bufLen, s);
+  };
+
+  BENCHMARK("GetPESummary example.exe, cache hit") {
+    pe_summary s;
+    return GetPESummary(cache, b->buf, b->bufLen, s);
+  };
+
+  CloseParseCache(cache);
+  fs::remove_all(dir);
+  deleteBuffer(b);
+}
+
+} // namespace peparse
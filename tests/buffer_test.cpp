@@ -0,0 +1,65 @@
+#include <cstdint>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+namespace peparse {
+
+TEST_CASE("Byte order of primitive reads", "[buffer]") {
+  std::uint8_t data[] = {
+      0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09};
+  bounded_buffer *b = makeBufferFromPointer(data, sizeof(data));
+
+  REQUIRE(b);
+
+  SECTION("little-endian reads") {
+    std::uint16_t w;
+    std::uint32_t d;
+    std::uint64_t q;
+    char16_t c;
+
+    REQUIRE(readWord(b, 1, w));
+    REQUIRE(w == 0x0302);
+    REQUIRE(readDword(b, 1, d));
+    REQUIRE(d == 0x05040302);
+    REQUIRE(readQword(b, 1, q));
+    REQUIRE(q == 0x0908070605040302);
+    REQUIRE(readChar16(b, 0, c));
+    REQUIRE(c == 0x0201);
+
+    REQUIRE(readDword<byte_order::little>(b, 0, d));
+    REQUIRE(d == 0x04030201);
+  }
+
+  SECTION("big-endian reads") {
+    std::uint16_t w;
+    std::uint32_t d;
+    std::uint64_t q;
+    char16_t c;
+
+    REQUIRE(readWord<byte_order::big>(b, 1, w));
+    REQUIRE(w == 0x0203);
+    REQUIRE(readDword<byte_order::big>(b, 1, d));
+    REQUIRE(d == 0x02030405);
+    REQUIRE(readQword<byte_order::big>(b, 1, q));
+    REQUIRE(q == 0x0203040506070809);
+    REQUIRE(readChar16<byte_order::big>(b, 0, c));
+    REQUIRE(c == 0x0102);
+  }
+
+  SECTION("reads past the end fail") {
+    std::uint32_t d;
+    std::uint64_t q;
+
+    REQUIRE_FALSE(readDword(b, 6, d));
+    REQUIRE(GetPEErr() == PEERR_ADDRESS);
+    REQUIRE(GetPEErrLoc().rfind("readDword:", 0) == 0);
+    REQUIRE_FALSE(readQword<byte_order::big>(b, 2, q));
+    REQUIRE(GetPEErr() == PEERR_ADDRESS);
+  }
+
+  deleteBuffer(b);
+}
+
+} // namespace peparse
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+int collectCert(void *cbd, const certificate_entry &entry) {
+  static_cast<std::vector<certificate_entry> *>(cbd)->push_back(entry);
+  return 0;
+}
+
+// a WIN_CERTIFICATE entry with length bytes of fill, padded to 8 bytes
+void appendCert(std::vector<std::uint8_t> &table,
+                std::uint16_t type,
+                std::uint32_t length,
+                std::uint8_t fill) {
+  auto off = static_cast<std::uint32_t>(table.size());
+  table.resize(off + 8 + ((length + 7) & ~7u), 0);
+  test::put32(table, off, 8 + length);
+  test::put16(table, off + 4, WIN_CERT_REVISION_2_0);
+  test::put16(table, off + 6, type);
+  std::fill(table.begin() + off + 8, table.begin() + off + 8 + length, fill);
+}
+
+std::vector<certificate_entry>
+certificates(test::pe_builder &builder,
+             const std::vector<std::uint8_t> &table,
+             std::uint32_t dirSize,
+             std::vector<std::uint8_t> &image) {
+  builder.setOverlay(table);
+  builder.setDataDirectory(DIR_SECURITY, builder.overlayOffset(), dirSize);
+  image = builder.build();
+
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<certificate_entry> certs;
+  IterCertificates(p, collectCert, &certs);
+  DestructParsedPE(p);
+  return certs;
+}
+
+} // namespace
+
+TEST_CASE("Attribute certificate table", "[certificates]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::vector<std::uint8_t> table;
+  appendCert(table, WIN_CERT_TYPE_PKCS_SIGNED_DATA, 0x35, 0xAA);
+  appendCert(table, WIN_CERT_TYPE_X509, 0x10, 0xBB);
+  std::vector<std::uint8_t> image;
+
+  SECTION("entries are views into the file") {
+    auto size = static_cast<std::uint32_t>(table.size());
+    std::vector<certificate_entry> certs =
+        certificates(builder, table, size, image);
+    REQUIRE(certs.size() == 2);
+
+    std::uint32_t base = builder.overlayOffset();
+    REQUIRE(certs[0].offset == base);
+    REQUIRE(certs[0].revision == WIN_CERT_REVISION_2_0);
+    REQUIRE(certs[0].type == WIN_CERT_TYPE_PKCS_SIGNED_DATA);
+    REQUIRE(certs[0].length == 0x35);
+
+    // the second entry starts on the next 8-byte boundary
+    REQUIRE(certs[1].offset == base + 0x40);
+    REQUIRE(certs[1].type == WIN_CERT_TYPE_X509);
+    REQUIRE(certs[1].length == 0x10);
+    REQUIRE(certs[1].data[0] == 0xBB);
+  }
+
+  SECTION("the walk stops at a malformed entry") {
+    test::put32(table, 0x40, 4);
+    auto size = static_cast<std::uint32_t>(table.size());
+    REQUIRE(certificates(builder, table, size, image).size() == 1);
+  }
+
+  SECTION("entries past the table are not returned") {
+    REQUIRE(certificates(builder, table, 0x50, image).size() == 1);
+  }
+
+  SECTION("GetDataDirectoryEntry returns the whole table") {
+    auto size = static_cast<std::uint32_t>(table.size());
+    certificates(builder, table, size, image);
+    parsed_pe *p = ParsePEFromPointer(image.data(),
+                                      static_cast<std::uint32_t>(image.size()));
+    REQUIRE(p);
+
+    std::vector<std::uint8_t> raw;
+    REQUIRE(GetDataDirectoryEntry(p, DIR_SECURITY, raw));
+    REQUIRE(raw == table);
+    DestructParsedPE(p);
+  }
+}
+
+TEST_CASE("Images without certificates", "[certificates]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<certificate_entry> certs;
+  IterCertificates(p, collectCert, &certs);
+  REQUIRE(certs.empty());
+
+  DestructParsedPE(p);
+
+  IterCertificates(nullptr, collectCert, &certs);
+  REQUIRE(certs.empty());
+}
+
+} // namespace peparse
@@ -0,0 +1,95 @@
+#include <cstdint>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+// the checksum, one word at a time, with the field at checkSumOff zeroed
+std::uint32_t referenceChecksum(std::vector<std::uint8_t> image,
+                                std::size_t checkSumOff) {
+  std::size_t size = image.size();
+  test::put32(image, checkSumOff, 0);
+  image.push_back(0);
+
+  std::uint32_t sum = 0;
+  for (std::size_t i = 0; i < size; i += 2) {
+    sum += static_cast<std::uint32_t>(image[i] | image[i + 1] << 8);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  return sum + static_cast<std::uint32_t>(size);
+}
+
+std::uint32_t checksum(std::vector<std::uint8_t> &image) {
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+  std::uint32_t sum = ComputePEChecksum(p);
+  DestructParsedPE(p);
+  return sum;
+}
+
+} // namespace
+
+TEST_CASE("PE checksum", "[checksum]") {
+  SECTION("example.exe") {
+    fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+    parsed_pe *p = ParsePEFromFile(path.string().c_str());
+    REQUIRE(p);
+    REQUIRE(ComputePEChecksum(p) == 0x2457C);
+    DestructParsedPE(p);
+  }
+
+  SECTION("without an image") {
+    REQUIRE(ComputePEChecksum(nullptr) == 0);
+  }
+
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x300, 0xCC));
+  const std::size_t checkSumOff = 0x40 + 4 + 20 + 64;
+
+  SECTION("vector loops and their tails") {
+    // overlays of odd and even lengths around the vector widths, and one
+    // long enough to widen the vector accumulators
+    for (std::size_t len : {0, 1, 2, 15, 31, 33, 63, 1001, 2100000}) {
+      INFO("overlay: " << len);
+      std::vector<std::uint8_t> overlay(len);
+      for (std::size_t i = 0; i < len; i++) {
+        overlay[i] = static_cast<std::uint8_t>(0xFF - (i * 7 & 0x3F));
+      }
+      builder.setOverlay(overlay);
+      std::vector<std::uint8_t> image = builder.build();
+      REQUIRE(checksum(image) == referenceChecksum(image, checkSumOff));
+    }
+  }
+
+  SECTION("the stored checksum is ignored") {
+    std::vector<std::uint8_t> image = builder.build();
+    std::uint32_t sum = checksum(image);
+    test::put32(image, checkSumOff, sum);
+    REQUIRE(checksum(image) == sum);
+
+    image[0x500] ^= 0x10;
+    REQUIRE(checksum(image) != sum);
+  }
+
+  SECTION("an unaligned CheckSum field") {
+    // move the NT headers to an odd offset, taking the byte from the
+    // padding at the end of the headers
+    std::vector<std::uint8_t> image = builder.build();
+    image.insert(image.begin() + 0x40, 0);
+    image.erase(image.begin() + 0x3FF);
+    test::put32(image, 0x3C, 0x41);
+    test::put32(image, checkSumOff + 1, 0xDEADBEEF);
+    REQUIRE(checksum(image) == referenceChecksum(image, checkSumOff + 1));
+  }
+}
+
+} // namespace peparse
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+std::string sha256Hex(const std::string &msg,
+                      bool accelerated,
+                      std::size_t chunk = 0) {
+  sha256_ctx ctx;
+  Sha256Init(ctx);
+  ctx.accelerated = accelerated;
+
+  const auto *data = reinterpret_cast<const std::uint8_t *>(msg.data());
+  if (chunk == 0) {
+    chunk = msg.size() + 1;
+  }
+  for (std::size_t i = 0; i < msg.size(); i += chunk) {
+    Sha256Update(ctx, data + i, std::min(chunk, msg.size() - i));
+  }
+
+  sha256_digest out;
+  Sha256Final(ctx, out);
+  return DigestToHex(out);
+}
+
+std::string authenticode(std::vector<std::uint8_t> &image) {
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  sha256_digest d;
+  REQUIRE(GetAuthenticodeDigest(p, d));
+  DestructParsedPE(p);
+  return DigestToHex(d);
+}
+
+} // namespace
+
+TEST_CASE("SHA-256 test vectors", "[digest]") {
+  std::vector<bool> paths = {false};
+  if (Sha256Accelerated()) {
+    paths.push_back(true);
+  }
+
+  for (bool accelerated : paths) {
+    INFO("accelerated: " << accelerated);
+    REQUIRE(sha256Hex("", accelerated) ==
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    REQUIRE(sha256Hex("abc", accelerated) ==
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    REQUIRE(
+        sha256Hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+                  accelerated) ==
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    std::string million(1000000, 'a');
+    REQUIRE(sha256Hex(million, accelerated) ==
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+  }
+}
+
+TEST_CASE("SHA-256 incremental updates", "[digest]") {
+  std::string msg;
+  for (std::size_t i = 0; i < 1000; i++) {
+    msg.push_back(static_cast<char>(i * 31 + 7));
+  }
+
+  std::string whole = sha256Hex(msg, false);
+  for (std::size_t chunk : {1, 3, 55, 63, 64, 65, 127, 500}) {
+    INFO("chunk: " << chunk);
+    REQUIRE(sha256Hex(msg, false, chunk) == whole);
+    if (Sha256Accelerated()) {
+      REQUIRE(sha256Hex(msg, true, chunk) == whole);
+    }
+  }
+}
+
+TEST_CASE("MD5 test vectors", "[digest]") {
+  auto md5Hex = [](const std::string &msg, std::size_t chunk) {
+    md5_ctx ctx;
+    Md5Init(ctx);
+    const auto *data = reinterpret_cast<const std::uint8_t *>(msg.data());
+    for (std::size_t i = 0; i < msg.size(); i += chunk) {
+      Md5Update(ctx, data + i, std::min(chunk, msg.size() - i));
+    }
+    md5_digest out;
+    Md5Final(ctx, out);
+    return DigestToHex(out);
+  };
+
+  for (std::size_t chunk : {1, 63, 64, 1000000}) {
+    INFO("chunk: " << chunk);
+    REQUIRE(md5Hex("", chunk) == "d41d8cd98f00b204e9800998ecf8427e");
+    REQUIRE(md5Hex("abc", chunk) == "900150983cd24fb0d6963f7d28e17f72");
+    REQUIRE(md5Hex("1234567890123456789012345678901234567890"
+                   "1234567890123456789012345678901234567890",
+                   chunk) == "57edf4a22be3c955ac49da2e2107b67a");
+    REQUIRE(md5Hex(std::string(1000000, 'a'), chunk) ==
+            "7707d6ae4e027c70eea2a935c2296f21");
+  }
+}
+
+TEST_CASE("XXH64 test vectors", "[digest]") {
+  auto xxh64 = [](const std::string &msg, std::uint64_t seed) {
+    return Xxh64(
+        reinterpret_cast<const std::uint8_t *>(msg.data()), msg.size(), seed);
+  };
+
+  REQUIRE(xxh64("", 0) == 0xEF46DB3751D8E999);
+  REQUIRE(xxh64("a", 0) == 0xD24EC4F1A98C6E5B);
+  REQUIRE(xxh64("abc", 0) == 0x44BC2CF5AD770999);
+  REQUIRE(xxh64("abc", 1) == 0xBEA9CA8199328908);
+
+  // the 32-byte stripes and every kind of tail
+  std::string bytes;
+  for (int i = 0; i < 5; i++) {
+    for (int c = 0; c < 256; c++) {
+      bytes.push_back(static_cast<char>(c));
+    }
+  }
+  bytes += "xyz";
+  REQUIRE(xxh64(bytes, 0) == 0xAFD18A3957D3670A);
+
+  // the pair is the same two hashes, for every length of tail
+  const auto *data = reinterpret_cast<const std::uint8_t *>(bytes.data());
+  for (std::size_t len = 0; len < 100; len++) {
+    xxh64_pair pair = Xxh64Pair(data, len, 0, 0x1234);
+    REQUIRE(pair.first == Xxh64(data, len, 0));
+    REQUIRE(pair.second == Xxh64(data, len, 0x1234));
+  }
+  xxh64_pair pair = Xxh64Pair(data, bytes.size(), 1, 2);
+  REQUIRE(pair.first == Xxh64(data, bytes.size(), 1));
+  REQUIRE(pair.second == Xxh64(data, bytes.size(), 2));
+}
+
+TEST_CASE("Authenticode digest", "[digest]") {
+  SECTION("example.exe") {
+    fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+    parsed_pe *p = ParsePEFromFile(path.string().c_str());
+    REQUIRE(p);
+
+    sha256_digest d;
+    REQUIRE(GetAuthenticodeDigest(p, d));
+    REQUIRE(DigestToHex(d) ==
+            "bba410e3df5815759cb2b3bd9de3c842d8e81c246c254308dd7361a865d9620a");
+
+    DestructParsedPE(p);
+  }
+
+  SECTION("the checksum and certificate table are excluded") {
+    test::pe_builder builder;
+    builder.addSection(".text", std::vector<std::uint8_t>(0x300, 0xCC));
+    builder.addSection(".data", std::vector<std::uint8_t>(0x80, 0x11));
+    std::vector<std::uint8_t> image = builder.build();
+    std::string unsigned_ = authenticode(image);
+
+    // a stamped checksum
+    std::vector<std::uint8_t> stamped = image;
+    test::put32(stamped, 0x40 + 4 + 20 + 64, 0x12345678);
+    REQUIRE(authenticode(stamped) == unsigned_);
+
+    // a certificate table appended, and its data directory entry
+    std::vector<std::uint8_t> certs(0x40, 0xEE);
+    builder.setOverlay(certs);
+    builder.setDataDirectory(DIR_SECURITY, builder.overlayOffset(), 0x40);
+    std::vector<std::uint8_t> signed_ = builder.build();
+    REQUIRE(authenticode(signed_) == unsigned_);
+
+    // other data after the sections is covered
+    std::vector<std::uint8_t> overlay = image;
+    overlay.push_back(0);
+    REQUIRE(authenticode(overlay) != unsigned_);
+
+    // as are the sections
+    std::vector<std::uint8_t> patched = image;
+    patched[0x400] ^= 1;
+    REQUIRE(authenticode(patched) != unsigned_);
+  }
+
+  SECTION("nothing past SizeOfHeaders is hashed as a header") {
+    test::pe_builder builder;
+    builder.addSection(".text", std::vector<std::uint8_t>(0x200, 0xCC));
+    std::vector<std::uint8_t> image = builder.build();
+
+    // SizeOfHeaders ends the headers in the middle of the optional header,
+    // before the CheckSum
+    const std::size_t opt = 0x40 + 4 + 20;
+    test::put32(image, opt + 60, 0x90);
+
+    sha256_ctx ctx;
+    Sha256Init(ctx);
+    Sha256Update(ctx, image.data(), 0x90);
+    Sha256Update(ctx, image.data() + 0x400, image.size() - 0x400);
+    sha256_digest want;
+    Sha256Final(ctx, want);
+
+    REQUIRE(authenticode(image) == DigestToHex(want));
+  }
+
+  SECTION("without an image") {
+    sha256_digest d;
+    REQUIRE_FALSE(GetAuthenticodeDigest(nullptr, d));
+  }
+}
+
+} // namespace peparse
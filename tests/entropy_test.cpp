@@ -0,0 +1,201 @@
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+byte_histogram naiveHistogram(const std::uint8_t *data, std::size_t len) {
+  byte_histogram h = {};
+  for (std::size_t i = 0; i < len; i++) {
+    h[data[i]]++;
+  }
+  return h;
+}
+
+// a mix of noise and single-value runs of various lengths and alignments
+std::vector<std::uint8_t> mixedData(std::size_t len) {
+  std::vector<std::uint8_t> data(len);
+  std::uint32_t x = 12345;
+  for (std::size_t i = 0; i < len; i++) {
+    x = x * 1103515245 + 12345;
+    if ((i / 100) % 3 == 1) {
+      data[i] = static_cast<std::uint8_t>(i / 300);
+    } else {
+      data[i] = static_cast<std::uint8_t>(x >> 24);
+    }
+  }
+  return data;
+}
+
+} // namespace
+
+TEST_CASE("Byte histograms", "[entropy]") {
+  std::vector<std::uint8_t> data = mixedData(10000);
+  for (std::size_t off : {0, 1, 7}) {
+    for (std::size_t len : {0, 1, 63, 64, 65, 200, 4099, 9990}) {
+      INFO("offset " << off << ", length " << len);
+      byte_histogram h = {};
+      AddByteHistogram(h, data.data() + off, len);
+      REQUIRE(h == naiveHistogram(data.data() + off, len));
+    }
+  }
+
+  SECTION("counts accumulate") {
+    byte_histogram h = {};
+    AddByteHistogram(h, data.data(), 5000);
+    AddByteHistogram(h, data.data() + 5000, 5000);
+    REQUIRE(h == naiveHistogram(data.data(), data.size()));
+  }
+}
+
+TEST_CASE("Entropy and chi-square", "[entropy]") {
+  byte_histogram h = {};
+  REQUIRE(ShannonEntropy(h) == 0.0);
+  REQUIRE(ChiSquare(h) == 0.0);
+
+  h[0x90] = 1000;
+  REQUIRE(ShannonEntropy(h) == 0.0);
+  // 1000 bytes expected to spread as 1000/256 per value
+  REQUIRE(ChiSquare(h) == Approx(255000.0));
+
+  h.fill(3);
+  REQUIRE(ShannonEntropy(h) == Approx(8.0));
+  REQUIRE(ChiSquare(h) == Approx(0.0).margin(1e-9));
+
+  h = {};
+  h['A'] = 1;
+  h['B'] = 1;
+  h['C'] = 2;
+  REQUIRE(ShannonEntropy(h) == Approx(1.5));
+}
+
+TEST_CASE("Entropy profiles", "[entropy]") {
+  std::vector<std::uint8_t> data = mixedData(20000);
+
+  REQUIRE(EntropyProfile(data.data(), 100, 256, 64).empty());
+  REQUIRE(EntropyProfile(data.data(), data.size(), 0, 64).empty());
+  REQUIRE(EntropyProfile(data.data(), data.size(), 256, 0).empty());
+
+  for (std::uint32_t step : {1, 100, 256, 1000}) {
+    INFO("step " << step);
+    std::vector<double> profile =
+        EntropyProfile(data.data(), data.size(), 256, step);
+    REQUIRE(profile.size() == (data.size() - 256) / step + 1);
+    for (std::size_t i = 0; i < profile.size(); i++) {
+      byte_histogram h = naiveHistogram(data.data() + i * step, 256);
+      REQUIRE(profile[i] == Approx(ShannonEntropy(h)).margin(1e-9));
+    }
+  }
+}
+
+TEST_CASE("Section entropy", "[entropy]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x800, 0xCC));
+  std::vector<std::uint8_t> flat(0x30000);
+  for (std::size_t i = 0; i < flat.size(); i++) {
+    flat[i] = static_cast<std::uint8_t>(i);
+  }
+  builder.addSection(".data", flat);
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  entropy_options opts;
+  opts.profileThreshold = 0x10000;
+  std::vector<section_entropy> out;
+  REQUIRE(GetSectionEntropy(p, opts, out));
+  REQUIRE(out.size() == 2);
+
+  REQUIRE(out[0].name == ".text");
+  REQUIRE(out[0].histogram[0xCC] == 0x800);
+  REQUIRE(out[0].entropy == 0.0);
+  REQUIRE(out[0].profile.empty());
+
+  REQUIRE(out[1].name == ".data");
+  REQUIRE(out[1].histogram == naiveHistogram(flat.data(), flat.size()));
+  REQUIRE(out[1].entropy == Approx(8.0));
+  REQUIRE(out[1].chiSquare == Approx(0.0).margin(1e-9));
+  REQUIRE(out[1].profile.size() == flat.size() / 4096);
+
+  SECTION("large sections split across threads") {
+    opts.threads = 3;
+    opts.parallelThreshold = 0;
+    std::vector<section_entropy> split;
+    REQUIRE(GetSectionEntropy(p, opts, split));
+    REQUIRE(split.size() == 2);
+    REQUIRE(split[1].histogram == out[1].histogram);
+  }
+
+  DestructParsedPE(p);
+
+  REQUIRE_FALSE(GetSectionEntropy(nullptr, opts, out));
+}
+
+TEST_CASE("Sections reported in table order", "[entropy]") {
+  test::pe_builder builder;
+  builder.addSection(".a", std::vector<std::uint8_t>(0x200, 0x11));
+  builder.addSection(".b", std::vector<std::uint8_t>(0x200, 0x22));
+  builder.addSection(".c", std::vector<std::uint8_t>(0x200, 0x33));
+  std::vector<std::uint8_t> image = builder.build();
+
+  // swap the VirtualAddress and PointerToRawData of the first and last
+  // headers, so the table is in neither address nor file order
+  const std::size_t table = 0x40 + 4 + 20 + 0xF0;
+  for (std::size_t i = 0; i < 4; i++) {
+    std::swap(image[table + 12 + i], image[table + 80 + 12 + i]);
+    std::swap(image[table + 20 + i], image[table + 80 + 20 + i]);
+  }
+
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  entropy_options opts;
+  std::vector<section_entropy> out;
+  REQUIRE(GetSectionEntropy(p, opts, out));
+  REQUIRE(out.size() == 3);
+  REQUIRE(out[0].name == ".a");
+  REQUIRE(out[0].histogram[0x33] == 0x200);
+  REQUIRE(out[1].name == ".b");
+  REQUIRE(out[2].name == ".c");
+  REQUIRE(out[2].histogram[0x11] == 0x200);
+
+  pe_fingerprints fp;
+  REQUIRE(GetFingerprints(p, FINGERPRINT_SECTION_MD5, fp));
+  REQUIRE(fp.sections.size() == 3);
+  REQUIRE(fp.sections[0].name == ".a");
+  REQUIRE(fp.sections[2].name == ".c");
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("example.exe section entropy", "[entropy]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  parsed_pe *p = ParsePEFromFile(path.string().c_str());
+  REQUIRE(p);
+
+  std::vector<section_entropy> out;
+  REQUIRE(GetSectionEntropy(p, entropy_options(), out));
+  REQUIRE(out.size() == 5);
+  REQUIRE(out[0].name == ".text");
+  for (const section_entropy &e : out) {
+    REQUIRE(e.entropy > 0.0);
+    REQUIRE(e.entropy < 8.0);
+  }
+
+  DestructParsedPE(p);
+}
+
+} // namespace peparse
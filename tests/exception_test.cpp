@@ -0,0 +1,136 @@
+#include <cstdint>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+parsed_pe *parse(const std::vector<std::uint8_t> &image) {
+  return ParsePEFromPointer(const_cast<std::uint8_t *>(image.data()),
+                            static_cast<std::uint32_t>(image.size()));
+}
+
+} // namespace
+
+TEST_CASE("x64 exception directory", "[exception]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x400, 0xCC));
+
+  // deliberately out of order, plus an empty entry that is dropped
+  std::vector<std::uint8_t> pdata;
+  const std::uint32_t entries[][3] = {
+      {0x1100, 0x1180, 0x3000},
+      {0x1000, 0x1040, 0x3010},
+      {0x1040, 0x1090, 0x3020},
+      {0x1200, 0x1200, 0x3030},
+  };
+  for (const auto &e : entries) {
+    std::size_t off = pdata.size();
+    test::put32(pdata, off, e[0]);
+    test::put32(pdata, off + 4, e[1]);
+    test::put32(pdata, off + 8, e[2]);
+  }
+  std::uint32_t rva = builder.addSection(".pdata", pdata);
+  builder.setDataDirectory(
+      DIR_EXCEPTION, rva, static_cast<std::uint32_t>(pdata.size()));
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  const runtime_function *f = FindFunctionForRva(p, 0x1044);
+  REQUIRE(f);
+  REQUIRE(f->begin == 0x1040);
+  REQUIRE(f->end == 0x1090);
+  REQUIRE(f->unwindData == 0x3020);
+
+  REQUIRE(FindFunctionForRva(p, 0x1000));
+  REQUIRE_FALSE(FindFunctionForRva(p, 0x1090));
+  REQUIRE_FALSE(FindFunctionForRva(p, 0xFFF));
+  REQUIRE_FALSE(FindFunctionForRva(p, 0x1200));
+
+  std::vector<const runtime_function *> out;
+  SECTION("sorted batch") {
+    REQUIRE(FindFunctionsForRvas(
+                p, {0x1000, 0x1010, 0x1095, 0x1100, 0x117F, 0x2000}, out) ==
+            4);
+    REQUIRE(out[1]->begin == 0x1000);
+    REQUIRE_FALSE(out[2]);
+    REQUIRE(out[3]->begin == 0x1100);
+    REQUIRE(out[4] == out[3]);
+    REQUIRE_FALSE(out[5]);
+  }
+
+  SECTION("unsorted batch") {
+    REQUIRE(FindFunctionsForRvas(p, {0x1150, 0x1001, 0x1041}, out) == 3);
+    REQUIRE(out[0]->begin == 0x1100);
+    REQUIRE(out[1]->begin == 0x1000);
+    REQUIRE(out[2]->begin == 0x1040);
+  }
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("ARM64 exception directory", "[exception]") {
+  test::pe_builder builder(true, IMAGE_FILE_MACHINE_ARM64);
+  builder.addSection(".text", std::vector<std::uint8_t>(0x400, 0));
+
+  // .xdata header with a function length of 0x20 instructions
+  std::vector<std::uint8_t> xdata;
+  test::put32(xdata, 0, 0x20);
+  std::uint32_t xrva = builder.addSection(".xdata", xdata);
+
+  std::vector<std::uint8_t> pdata;
+  // packed unwind data: flag 1, 0x10 instructions
+  test::put32(pdata, 0, 0x1000);
+  test::put32(pdata, 4, (0x10 << 2) | 1);
+  test::put32(pdata, 8, 0x1100);
+  test::put32(pdata, 12, xrva);
+  std::uint32_t rva = builder.addSection(".pdata", pdata);
+  builder.setDataDirectory(
+      DIR_EXCEPTION, rva, static_cast<std::uint32_t>(pdata.size()));
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  const runtime_function *f = FindFunctionForRva(p, 0x103C);
+  REQUIRE(f);
+  REQUIRE(f->end == 0x1040);
+  REQUIRE_FALSE(FindFunctionForRva(p, 0x1040));
+
+  f = FindFunctionForRva(p, 0x117C);
+  REQUIRE(f);
+  REQUIRE(f->begin == 0x1100);
+  REQUIRE(f->end == 0x1180);
+  REQUIRE(f->unwindData == xrva);
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("No exception directory", "[exception]") {
+  test::pe_builder builder(false, IMAGE_FILE_MACHINE_I386);
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  REQUIRE_FALSE(FindFunctionForRva(p, 0x1000));
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Function lookups without an image", "[exception]") {
+  std::vector<const runtime_function *> out(1);
+  REQUIRE_FALSE(FindFunctionForRva(nullptr, 0x1000));
+  REQUIRE(FindFunctionsForRvas(nullptr, {0x1000}, out) == 0);
+  REQUIRE(out.empty());
+}
+
+} // namespace peparse
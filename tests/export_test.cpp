@@ -0,0 +1,256 @@
+#include <string>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+std::vector<std::uint8_t> buildDll(std::uint32_t numFunctions = 0) {
+  test::pe_builder builder;
+  std::uint32_t text = builder.addSection(
+      ".text", std::vector<std::uint8_t>(0x100, 0xCC), 0x60000020);
+
+  std::vector<test::export_spec> exports = {
+      {5, "Zeta", text + 0x10, ""},
+      {6, "Alpha", text + 0x20, ""},
+      {7, "", text + 0x30, ""},
+      {9, "Forwarded", 0, "OTHER.Target"},
+      {10, "Middle", text + 0x40, ""},
+      {10, "MiddleAlias", text + 0x40, ""},
+  };
+
+  std::uint32_t edata = builder.nextSectionRva();
+  std::vector<std::uint8_t> sec =
+      test::buildExportSection(edata, "test.dll", exports);
+  if (numFunctions != 0) {
+    test::put32(sec, 20, numFunctions);
+  }
+  builder.addSection(".edata", sec);
+  builder.setDataDirectory(
+      DIR_EXPORT, edata, static_cast<std::uint32_t>(sec.size()));
+
+  return builder.build();
+}
+
+struct exp {
+  VA addr;
+  std::uint16_t index;
+  std::string name;
+  std::string forward;
+};
+
+int collectExports(void *cbd,
+                   const VA &addr,
+                   std::uint16_t index,
+                   const std::string &,
+                   const std::string &name,
+                   const std::string &forward) {
+  static_cast<std::vector<exp> *>(cbd)->push_back({addr, index, name, forward});
+  return 0;
+}
+
+} // namespace
+
+TEST_CASE("Export lookup", "[exports]") {
+  std::vector<std::uint8_t> image = buildDll();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  const VA base = 0x140000000;
+  export_ref e;
+
+  SECTION("by name") {
+    REQUIRE(FindExportByName(p, "Alpha", e));
+    REQUIRE(e.addr == base + 0x1020);
+    REQUIRE(e.ordinal == 6);
+    REQUIRE(e.symbolName == "Alpha");
+    REQUIRE(e.moduleName == "test.dll");
+
+    REQUIRE(FindExportByName(p, "Zeta", e));
+    REQUIRE(e.ordinal == 5);
+    REQUIRE(FindExportByName(p, "Middle", e));
+    REQUIRE(e.ordinal == 10);
+
+    REQUIRE_FALSE(FindExportByName(p, "Alph", e));
+    REQUIRE_FALSE(FindExportByName(p, "Alphaa", e));
+    REQUIRE_FALSE(FindExportByName(p, "", e));
+  }
+
+  SECTION("forwarded") {
+    REQUIRE(FindExportByName(p, "Forwarded", e));
+    REQUIRE(e.addr == 0);
+    REQUIRE(e.forwardName == "OTHER.Target");
+  }
+
+  SECTION("by ordinal") {
+    REQUIRE(FindExportByOrdinal(p, 10, e));
+    REQUIRE(e.addr == base + 0x1040);
+    REQUIRE(e.symbolName == "Middle");
+
+    REQUIRE(FindExportByOrdinal(p, 7, e));
+    REQUIRE(e.addr == base + 0x1030);
+    REQUIRE(e.symbolName.empty());
+
+    // Below the ordinal base, an empty EAT slot, and past the end
+    REQUIRE_FALSE(FindExportByOrdinal(p, 4, e));
+    REQUIRE_FALSE(FindExportByOrdinal(p, 8, e));
+    REQUIRE_FALSE(FindExportByOrdinal(p, 11, e));
+  }
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Export table walk", "[exports]") {
+  SECTION("unnamed exports and aliases are included, in EAT order") {
+    std::vector<std::uint8_t> image = buildDll();
+    parsed_pe *p = ParsePEFromPointer(
+        image.data(), static_cast<std::uint32_t>(image.size()));
+    REQUIRE(p);
+
+    std::vector<exp> exps;
+    IterExpFull(p, collectExports, &exps);
+
+    REQUIRE(exps.size() == 6);
+    REQUIRE(exps[0].name == "Zeta");
+    REQUIRE(exps[1].name == "Alpha");
+    REQUIRE(exps[2].name.empty());
+    REQUIRE(exps[2].index == 2);
+    REQUIRE(exps[2].addr == 0x140001030);
+    REQUIRE(exps[3].name == "Forwarded");
+    REQUIRE(exps[3].forward == "OTHER.Target");
+    REQUIRE(exps[4].name == "Middle");
+    REQUIRE(exps[5].name == "MiddleAlias");
+    REQUIRE(exps[4].addr == exps[5].addr);
+
+    // IterExpFull reports EAT indexes, export_ref the biased ordinals
+    std::vector<export_ref> refs;
+    IterExpRefs(
+        p,
+        [](void *cbd, const export_ref &r) {
+          static_cast<std::vector<export_ref> *>(cbd)->push_back(r);
+          return 0;
+        },
+        &refs);
+    REQUIRE(refs.size() == exps.size());
+    for (std::size_t i = 0; i < refs.size(); i++) {
+      REQUIRE(refs[i].symbolName == exps[i].name);
+      REQUIRE(refs[i].ordinal == exps[i].index + 5U);
+    }
+    REQUIRE(exps[2].index == 2);
+    REQUIRE(refs[2].ordinal == 7);
+
+    export_ref e;
+    REQUIRE(FindExportByOrdinal(p, refs[2].ordinal, e));
+    REQUIRE(e.addr == exps[2].addr);
+
+    DestructParsedPE(p);
+  }
+
+  SECTION("a huge AddressTableEntries is clamped to the section") {
+    std::vector<std::uint8_t> image = buildDll(0xFFFFFFFF);
+    parsed_pe *p = ParsePEFromPointer(
+        image.data(), static_cast<std::uint32_t>(image.size()));
+    REQUIRE(p);
+
+    std::vector<exp> exps;
+    IterExpFull(p, collectExports, &exps);
+    REQUIRE(exps.size() >= 6);
+
+    export_ref e;
+    REQUIRE(FindExportByName(p, "Middle", e));
+    REQUIRE_FALSE(FindExportByOrdinal(p, 0xFFFFFF00, e));
+
+    DestructParsedPE(p);
+  }
+
+  SECTION("names past AddressTableEntries are found by lookups too") {
+    std::vector<std::uint8_t> image = buildDll(2);
+    parsed_pe *p = ParsePEFromPointer(
+        image.data(), static_cast<std::uint32_t>(image.size()));
+    REQUIRE(p);
+
+    std::vector<exp> exps;
+    IterExpFull(p, collectExports, &exps);
+    REQUIRE(exps.size() == 6);
+    REQUIRE(exps[4].name == "Middle");
+
+    export_ref e;
+    REQUIRE(FindExportByName(p, "Middle", e));
+    REQUIRE(e.ordinal == 10);
+    REQUIRE(FindExportByOrdinal(p, 10, e));
+    REQUIRE(e.symbolName == "Middle");
+    REQUIRE(FindExportByOrdinal(p, 7, e));
+    REQUIRE_FALSE(FindExportByOrdinal(p, 11, e));
+
+    DestructParsedPE(p);
+  }
+
+  SECTION("the walk stops at the 16-bit ordinal limit") {
+    // a full 64K-entry EAT with its last entry named, followed by enough
+    // nonzero bytes for millions of entries
+    test::pe_builder builder;
+    std::uint32_t edata = builder.nextSectionRva();
+    std::vector<std::uint8_t> sec = test::buildExportSection(
+        edata,
+        "test.dll",
+        {{1, "Low", 0x1010, ""}, {0x10000, "High", 0x1020, ""}});
+    test::put32(sec, 20, 0x01000000);
+    sec.resize(sec.size() + 0x100000, 0x01);
+    builder.addSection(".edata", sec);
+    builder.setDataDirectory(
+        DIR_EXPORT, edata, static_cast<std::uint32_t>(sec.size()));
+    std::vector<std::uint8_t> image = builder.build();
+    parsed_pe *p = ParsePEFromPointer(
+        image.data(), static_cast<std::uint32_t>(image.size()));
+    REQUIRE(p);
+
+    std::vector<exp> exps;
+    IterExpFull(p, collectExports, &exps);
+    REQUIRE(exps.size() == 2);
+    REQUIRE(exps[0].name == "Low");
+    REQUIRE(exps[0].index == 0);
+    REQUIRE(exps[1].name == "High");
+    REQUIRE(exps[1].index == 0xFFFF);
+
+    export_ref e;
+    REQUIRE(FindExportByOrdinal(p, 0x10000, e));
+    REQUIRE(e.symbolName == "High");
+    REQUIRE_FALSE(FindExportByOrdinal(p, 0x10001, e));
+
+    DestructParsedPE(p);
+  }
+}
+
+TEST_CASE("Export lookup without exports", "[exports]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  parsed_pe *p = ParsePEFromFile(path.string().c_str());
+  REQUIRE(p);
+
+  export_ref e;
+  REQUIRE_FALSE(FindExportByName(p, "main", e));
+  REQUIRE_FALSE(FindExportByOrdinal(p, 1, e));
+  REQUIRE_FALSE(FindExportByName(nullptr, "main", e));
+  REQUIRE_FALSE(FindExportByOrdinal(nullptr, 1, e));
+
+  int calls = 0;
+  IterExpRefs(
+      nullptr,
+      [](void *cbd, const export_ref &) {
+        ++*static_cast<int *>(cbd);
+        return 0;
+      },
+      &calls);
+  REQUIRE(calls == 0);
+
+  DestructParsedPE(p);
+}
+
+} // namespace peparse
@@ -0,0 +1,135 @@
+#include <cstdint>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+TEST_CASE("Import and export hashes", "[fingerprint]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> imp = test::buildImportSection(
+      idata,
+      true,
+      {
+          {"KERNEL32.DLL", {"CreateFileW", "#17"}},
+          {"WS2_32.dll", {"#115", "#9999"}},
+          {"wsock32.dll", {"#3"}},
+          {"COMCTL32.dll", {"InitCommonControls"}},
+          {"driver.SYS", {"IoCreateDevice"}},
+          {"mod.tar.gz", {"x"}},
+      });
+  builder.addSection(".idata", imp);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(imp.size()));
+
+  // delay-load imports are not part of the import hash
+  std::uint32_t didat = builder.nextSectionRva();
+  std::vector<std::uint8_t> delay = test::buildImportSection(
+      didat, true, {{"shell32.dll", {"ShellExecuteW"}}}, true);
+  builder.addSection(".didat", delay);
+  builder.setDataDirectory(
+      DIR_DELAY_IMPORT, didat, static_cast<std::uint32_t>(delay.size()));
+
+  std::uint32_t edata = builder.nextSectionRva();
+  std::vector<std::uint8_t> exp =
+      test::buildExportSection(edata,
+                               "test.dll",
+                               {{1, "Zeta", 0x1000, ""},
+                                {2, "alpha", 0x1010, ""},
+                                {3, "Beta", 0x1020, ""},
+                                {4, "", 0x1030, ""}});
+  builder.addSection(".edata", exp);
+  builder.setDataDirectory(
+      DIR_EXPORT, edata, static_cast<std::uint32_t>(exp.size()));
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  pe_fingerprints fp;
+  REQUIRE(
+      GetFingerprints(p, FINGERPRINT_IMPORT_HASH | FINGERPRINT_EXPHASH, fp));
+  REQUIRE(fp.computed == (FINGERPRINT_IMPORT_HASH | FINGERPRINT_EXPHASH));
+
+  // md5("kernel32.createfilew,kernel32.ord17,ws2_32.wsastartup,"
+  //     "ws2_32.ord9999,wsock32.closesocket,comctl32.initcommoncontrols,"
+  //     "driver.iocreatedevice,mod.tar.gz.x")
+  REQUIRE(DigestToHex(fp.importHash) == "63852da7a571662f8755269421789336");
+  // md5("beta,zeta,alpha")
+  REQUIRE(DigestToHex(fp.exphash) == "042652a4b6830680a8ec38873807686d");
+  REQUIRE(fp.sections.empty());
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Import hash leaves oleaut32 ordinals unnamed", "[fingerprint]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> imp = test::buildImportSection(
+      idata, true, {{"OLEAUT32.dll", {"#2", "SysFreeString"}}});
+  builder.addSection(".idata", imp);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(imp.size()));
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  pe_fingerprints fp;
+  REQUIRE(GetFingerprints(p, FINGERPRINT_IMPORT_HASH, fp));
+
+  // md5("oleaut32.ord2,oleaut32.sysfreestring"); pefile's imphash would
+  // name ordinal 2 SysAllocString
+  REQUIRE(DigestToHex(fp.importHash) == "ae24a97edb8c3764329128f937e6be27");
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("example.exe fingerprints", "[fingerprint]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  parsed_pe *p = ParsePEFromFile(path.string().c_str());
+  REQUIRE(p);
+
+  pe_fingerprints fp;
+  REQUIRE(GetFingerprints(p, FINGERPRINT_ALL, fp));
+
+  // no exports
+  REQUIRE(fp.computed == (FINGERPRINT_ALL & ~FINGERPRINT_EXPHASH));
+  REQUIRE(DigestToHex(fp.importHash) == "0bb06bfc0849c071a51289e42bb16868");
+  REQUIRE(DigestToHex(fp.richHash) == "927334c9e53474643fad4e5c0d1747c9");
+
+  REQUIRE(fp.sections.size() == 5);
+  REQUIRE(fp.sections[0].name == ".text");
+  REQUIRE(DigestToHex(fp.sections[0].md5) ==
+          "34ae04553306abad7e1d2849e9ac7999");
+  REQUIRE(DigestToHex(fp.sections[0].sha256) ==
+          "5712ffa9dcf1fa659e8842b8327176d86fef93cf8b26b699ff5ae2320baf3f87");
+  REQUIRE(fp.sections[4].name == ".reloc");
+
+  SECTION("only the requested fingerprints are computed") {
+    REQUIRE(GetFingerprints(p, FINGERPRINT_SECTION_MD5, fp));
+    REQUIRE(fp.computed == FINGERPRINT_SECTION_MD5);
+    REQUIRE(DigestToHex(fp.sections[0].md5) ==
+            "34ae04553306abad7e1d2849e9ac7999");
+    REQUIRE(fp.sections[0].sha256 == sha256_digest{});
+
+    REQUIRE_FALSE(GetFingerprints(p, FINGERPRINT_EXPHASH, fp));
+    REQUIRE(fp.computed == 0);
+  }
+
+  DestructParsedPE(p);
+}
+
+} // namespace peparse
@@ -0,0 +1,277 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+std::vector<std::uint8_t> buildExe(bool pe64) {
+  test::pe_builder builder(pe64, pe64 ? 0x8664 : 0x14c);
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> sec = test::buildImportSection(
+      idata,
+      pe64,
+      {
+          {"kernel32.dll", {"CreateFileW", "#17", "ReadFile"}},
+          {"user32.dll", {"MessageBoxW"}},
+      });
+  builder.addSection(".idata", sec);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(sec.size()));
+  return builder.build();
+}
+
+int collectImport(void *cbd, const import_ref &r) {
+  static_cast<std::vector<import_ref> *>(cbd)->push_back(r);
+  return 0;
+}
+
+} // namespace
+
+TEST_CASE("Import lookup by IAT slot", "[import]") {
+  bool pe64 = GENERATE(true, false);
+  std::vector<std::uint8_t> image = buildExe(pe64);
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<import_ref> imports;
+  IterImpRefs(p, collectImport, &imports);
+  REQUIRE(imports.size() == 4);
+  REQUIRE(imports[1].byOrdinal);
+  REQUIRE(imports[1].ordinal == 17);
+
+  for (const import_ref &r : imports) {
+    const import_ref *found = FindImportByIAT(p, r.addr);
+    REQUIRE(found);
+    REQUIRE(found->moduleName == r.moduleName);
+    REQUIRE(found->symbolName == r.symbolName);
+  }
+
+  REQUIRE_FALSE(FindImportByIAT(p, imports[0].addr + 1));
+  REQUIRE_FALSE(FindImportByIAT(p, imports[0].addr - 4));
+  REQUIRE_FALSE(FindImportByIAT(p, 0));
+
+  std::vector<const import_ref *> out;
+  std::vector<VA> slots = {
+      imports[3].addr, imports[0].addr + 2, imports[2].addr};
+  REQUIRE(FindImportsByIAT(p, slots, out) == 2);
+  REQUIRE(out[0]->symbolName == "MessageBoxW");
+  REQUIRE_FALSE(out[1]);
+  REQUIRE(out[2]->symbolName == "ReadFile");
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Lookup tables of every length around the vector width",
+          "[import]") {
+  bool pe64 = GENERATE(true, false);
+
+  // each module's table ends in a different lane of the 16-byte vectors
+  // the terminator is searched with, or in the scalar tail
+  std::vector<test::import_spec> modules;
+  std::size_t total = 0;
+  for (std::size_t n = 1; n <= 9; n++) {
+    test::import_spec spec;
+    spec.module = "module" + std::to_string(n) + ".dll";
+    for (std::size_t i = 0; i < n; i++) {
+      spec.symbols.push_back(i % 3 == 2 ? "#" + std::to_string(i + 1)
+                                        : "Function" + std::to_string(i));
+    }
+    modules.push_back(spec);
+    total += n;
+  }
+  // a 64-bit ordinal thunk whose low half is zero isn't a terminator
+  modules.push_back({"ordinal.dll", {"#0", "Last"}});
+  total += 2;
+
+  test::pe_builder builder(pe64, pe64 ? 0x8664 : 0x14c);
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> sec =
+      test::buildImportSection(idata, pe64, modules);
+  builder.addSection(".idata", sec);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(sec.size()));
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<import_ref> imports;
+  IterImpRefs(p, collectImport, &imports);
+  REQUIRE(imports.size() == total);
+
+  std::size_t at = 0;
+  for (const test::import_spec &spec : modules) {
+    for (const std::string &sym : spec.symbols) {
+      const import_ref &r = imports[at++];
+      if (sym[0] == '#') {
+        REQUIRE(r.byOrdinal);
+        REQUIRE(r.ordinal == std::stoul(sym.substr(1)));
+      } else {
+        REQUIRE_FALSE(r.byOrdinal);
+        REQUIRE(r.symbolName == sym);
+      }
+    }
+  }
+  REQUIRE(imports.back().moduleName == "ORDINAL.DLL");
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Concurrent IAT lookups", "[import]") {
+  std::vector<std::uint8_t> image = buildExe(true);
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<import_ref> imports;
+  IterImpRefs(p, collectImport, &imports);
+  REQUIRE(imports.size() == 4);
+
+  // The index is built by whichever thread gets there first
+  std::vector<std::thread> threads;
+  std::vector<int> hits(4, 0);
+  for (std::size_t t = 0; t < hits.size(); t++) {
+    threads.emplace_back([&, t] {
+      for (const import_ref &r : imports) {
+        if (FindImportByIAT(p, r.addr) != nullptr) {
+          hits[t]++;
+        }
+      }
+    });
+  }
+  for (std::thread &t : threads) {
+    t.join();
+  }
+
+  for (int h : hits) {
+    REQUIRE(h == 4);
+  }
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Import lookups without an image", "[import]") {
+  std::vector<const import_ref *> out(1);
+  REQUIRE_FALSE(FindImportByIAT(nullptr, 0x1000));
+  REQUIRE(FindImportsByIAT(nullptr, {0x1000}, out) == 0);
+  REQUIRE(out.empty());
+
+  std::vector<import_ref> imports;
+  IterImpRefs(nullptr, collectImport, &imports);
+  REQUIRE(imports.empty());
+}
+
+TEST_CASE("Import module names are upper-cased", "[import]") {
+  test::pe_builder builder;
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> sec = test::buildImportSection(
+      idata,
+      true,
+      {
+          {"api-ms-win-core-synch-l1-2-0.dll", {"WaitOnAddress"}},
+          {"caf\xe9_z{@}.dll", {"#1"}},
+      });
+  builder.addSection(".idata", sec);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(sec.size()));
+  std::vector<std::uint8_t> image = builder.build();
+
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<import_ref> imports;
+  IterImpRefs(p, collectImport, &imports);
+  REQUIRE(imports.size() == 2);
+  REQUIRE(imports[0].moduleName == "API-MS-WIN-CORE-SYNCH-L1-2-0.DLL");
+  REQUIRE(imports[0].symbolName == "WaitOnAddress");
+  REQUIRE(imports[1].moduleName == "CAF\xe9_Z{@}.DLL");
+  REQUIRE(imports[1].symbolName == "ORDINAL_CAF\xe9_Z{@}.DLL_1");
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Delay-load imports", "[import]") {
+  bool pe64 = GENERATE(true, false);
+  test::pe_builder builder(pe64, pe64 ? 0x8664 : 0x14c);
+
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> imp = test::buildImportSection(
+      idata, pe64, {{"kernel32.dll", {"LoadLibraryA"}}});
+  builder.addSection(".idata", imp);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(imp.size()));
+
+  std::uint32_t didat = builder.nextSectionRva();
+  std::vector<std::uint8_t> delay = test::buildImportSection(
+      didat, pe64, {{"shell32.dll", {"ShellExecuteW", "#680"}}}, true);
+  builder.addSection(".didat", delay);
+  builder.setDataDirectory(
+      DIR_DELAY_IMPORT, didat, static_cast<std::uint32_t>(delay.size()));
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<import_ref> imports;
+  IterImpRefs(p, collectImport, &imports);
+  REQUIRE(imports.size() == 3);
+
+  REQUIRE_FALSE(imports[0].delayLoad);
+  REQUIRE(imports[1].delayLoad);
+  REQUIRE(imports[1].moduleName == "SHELL32.DLL");
+  REQUIRE(imports[1].symbolName == "ShellExecuteW");
+  REQUIRE(imports[2].delayLoad);
+  REQUIRE(imports[2].byOrdinal);
+  REQUIRE(imports[2].ordinal == 680);
+  REQUIRE(imports[2].addr == imports[1].addr + (pe64 ? 8 : 4));
+
+  const import_ref *r = FindImportByIAT(p, imports[1].addr);
+  REQUIRE(r);
+  REQUIRE(r->delayLoad);
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Malformed delay-load imports are skipped", "[import]") {
+  test::pe_builder builder;
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> imp = test::buildImportSection(
+      idata, true, {{"kernel32.dll", {"LoadLibraryA"}}});
+  builder.addSection(".idata", imp);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(imp.size()));
+
+  // a descriptor whose name table lies outside of every section
+  std::vector<std::uint8_t> delay(64, 0);
+  test::put32(delay, 0, 1);
+  test::put32(delay, 4, idata);
+  test::put32(delay, 12, 0x100000);
+  test::put32(delay, 16, 0x100000);
+  std::uint32_t didat = builder.addSection(".didat", delay);
+  builder.setDataDirectory(DIR_DELAY_IMPORT, didat, 32);
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<import_ref> imports;
+  IterImpRefs(p, collectImport, &imports);
+  REQUIRE(imports.size() == 1);
+  REQUIRE_FALSE(imports[0].delayLoad);
+
+  DestructParsedPE(p);
+}
+
+} // namespace peparse
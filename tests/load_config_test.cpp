@@ -0,0 +1,185 @@
+#include <cstdint>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+parsed_pe *parse(const std::vector<std::uint8_t> &image) {
+  return ParsePEFromPointer(const_cast<std::uint8_t *>(image.data()),
+                            static_cast<std::uint32_t>(image.size()));
+}
+
+int collectCF(void *cbd, const RVA &rva, std::uint8_t flags) {
+  auto *out = static_cast<std::vector<std::uint64_t> *>(cbd);
+  out->push_back(static_cast<std::uint64_t>(rva) << 8 | flags);
+  return 0;
+}
+
+int collectRVA(void *cbd, const RVA &rva) {
+  static_cast<std::vector<RVA> *>(cbd)->push_back(rva);
+  return 0;
+}
+
+} // namespace
+
+TEST_CASE("PE32+ load config and GuardCF table", "[loadconfig]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::uint32_t rva = builder.nextSectionRva();
+  VA base = builder.imageBase();
+  std::vector<std::uint8_t> rdata(0x108, 0);
+  test::put32(rdata, 0, 0x108);
+  test::put64(rdata, 0x58, base + rva + 0x200);
+  test::put64(rdata, 0x80, base + rva + 0x120);
+  test::put64(rdata, 0x88, 3);
+  test::put32(rdata,
+              0x90,
+              IMAGE_GUARD_CF_INSTRUMENTED |
+                  IMAGE_GUARD_CF_FUNCTION_TABLE_PRESENT | 1u << 28);
+
+  // 5-byte entries, out of order
+  const std::uint32_t fids[][2] = {
+      {0x1040, 0},
+      {0x1000, IMAGE_GUARD_FLAG_EXPORT_SUPPRESSED},
+      {0x1080, IMAGE_GUARD_FLAG_FID_SUPPRESSED},
+  };
+  std::size_t off = 0x120;
+  for (const auto &f : fids) {
+    test::put32(rdata, off, f[0]);
+    rdata.resize(off + 5);
+    rdata[off + 4] = static_cast<std::uint8_t>(f[1]);
+    off += 5;
+  }
+  rdata.resize(0x208, 0);
+
+  builder.addSection(".rdata", rdata);
+  builder.setDataDirectory(DIR_LOAD_CONFIG, rva, 0x108);
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  image_load_config_64 cfg;
+  REQUIRE(GetLoadConfig(p, cfg));
+  REQUIRE(cfg.Size == 0x108);
+  REQUIRE(cfg.GuardCFFunctionCount == 3);
+
+  VA cookie;
+  REQUIRE(GetSecurityCookie(p, cookie));
+  REQUIRE(cookie == base + rva + 0x200);
+
+  REQUIRE(IsCFGTarget(p, 0x1000));
+  REQUIRE(IsCFGTarget(p, 0x1040));
+  REQUIRE_FALSE(IsCFGTarget(p, 0x1080));
+  REQUIRE_FALSE(IsCFGTarget(p, 0x1044));
+  REQUIRE_FALSE(IsCFGTarget(p, 0x2000));
+
+  std::uint8_t flags;
+  REQUIRE(FindGuardCFFunction(p, 0x1080, flags));
+  REQUIRE(flags == IMAGE_GUARD_FLAG_FID_SUPPRESSED);
+  REQUIRE(FindGuardCFFunction(p, 0x1000, flags));
+  REQUIRE(flags == IMAGE_GUARD_FLAG_EXPORT_SUPPRESSED);
+
+  std::vector<std::uint64_t> all;
+  IterGuardCFFunctions(p, collectCF, &all);
+  REQUIRE(all == std::vector<std::uint64_t>{0x100002, 0x104000, 0x108001});
+
+  REQUIRE_FALSE(IsSEHandler(p, 0x1000));
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("PE32 load config and SafeSEH table", "[loadconfig]") {
+  test::pe_builder builder(false, 0x14c);
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::uint32_t rva = builder.nextSectionRva();
+  auto base = static_cast<std::uint32_t>(builder.imageBase());
+  std::vector<std::uint8_t> rdata(0x100, 0);
+
+  // an old, short load config: everything past SEHandlerCount is ignored,
+  // even though the bytes after it are not zero
+  test::put32(rdata, 0, 0x48);
+  test::put32(rdata, 0x3C, base + rva + 0xF0);
+  test::put32(rdata, 0x40, base + rva + 0x80);
+  test::put32(rdata, 0x44, 2);
+  test::put32(rdata, 0x50, base + rva + 0x80);
+  test::put32(rdata, 0x54, 2);
+  test::put32(rdata, 0x58, IMAGE_GUARD_CF_INSTRUMENTED);
+  test::put32(rdata, 0x80, 0x1050);
+  test::put32(rdata, 0x84, 0x1010);
+
+  builder.addSection(".rdata", rdata);
+  builder.setDataDirectory(DIR_LOAD_CONFIG, rva, 0x40);
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  image_load_config_64 cfg;
+  REQUIRE(GetLoadConfig(p, cfg));
+  REQUIRE(cfg.SecurityCookie == base + rva + 0xF0);
+  REQUIRE(cfg.SEHandlerCount == 2);
+  REQUIRE(cfg.GuardCFFunctionTable == 0);
+  REQUIRE(cfg.GuardFlags == 0);
+
+  REQUIRE(IsSEHandler(p, 0x1010));
+  REQUIRE(IsSEHandler(p, 0x1050));
+  REQUIRE_FALSE(IsSEHandler(p, 0x1030));
+  REQUIRE_FALSE(IsCFGTarget(p, 0x1010));
+
+  std::vector<RVA> handlers;
+  IterSEHandlers(p, collectRVA, &handlers);
+  REQUIRE(handlers == std::vector<RVA>{0x1010, 0x1050});
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Load config of example.exe", "[loadconfig]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  parsed_pe *p = ParsePEFromFile(path.string().c_str());
+  REQUIRE(p);
+
+  image_load_config_64 cfg;
+  REQUIRE(GetLoadConfig(p, cfg));
+  REQUIRE(cfg.Size == 0x100);
+  REQUIRE(cfg.GuardFlags == IMAGE_GUARD_CF_INSTRUMENTED);
+
+  VA cookie;
+  REQUIRE(GetSecurityCookie(p, cookie));
+  REQUIRE(cookie == 0x14001c038);
+  REQUIRE_FALSE(IsCFGTarget(p, 0x1000));
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Images without a load config", "[loadconfig]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  image_load_config_64 cfg;
+  VA cookie;
+  REQUIRE_FALSE(GetLoadConfig(p, cfg));
+  REQUIRE_FALSE(GetSecurityCookie(p, cookie));
+  REQUIRE_FALSE(IsCFGTarget(p, 0x1000));
+  REQUIRE_FALSE(IsSEHandler(p, 0x1000));
+
+  DestructParsedPE(p);
+
+  REQUIRE_FALSE(GetLoadConfig(nullptr, cfg));
+  REQUIRE_FALSE(GetSecurityCookie(nullptr, cookie));
+  REQUIRE_FALSE(IsCFGTarget(nullptr, 0x1000));
+  REQUIRE_FALSE(IsSEHandler(nullptr, 0x1000));
+}
+
+} // namespace peparse
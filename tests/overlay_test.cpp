@@ -0,0 +1,168 @@
+#include <cstdint>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+struct overlay_image {
+  std::vector<std::uint8_t> image;
+  parsed_pe *pe;
+
+  overlay_image(const test::pe_builder &builder) : image(builder.build()) {
+    pe = ParsePEFromPointer(image.data(),
+                            static_cast<std::uint32_t>(image.size()));
+    REQUIRE(pe);
+  }
+
+  ~overlay_image() {
+    DestructParsedPE(pe);
+  }
+
+  std::uint64_t offsetOf(const file_span &span) const {
+    REQUIRE(span.data == image.data() + span.offset);
+    return span.offset;
+  }
+};
+
+} // namespace
+
+TEST_CASE("Overlay", "[overlay]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x180, 0xCC));
+  const std::uint64_t base = builder.overlayOffset();
+
+  // an installer payload, followed by a certificate table at base + 0x108
+  std::vector<std::uint8_t> overlay(0x105, 0x5A);
+  overlay.resize(0x108, 0);
+  overlay.resize(0x108 + 0x40, 0xEE);
+  pe_overlay o;
+
+  SECTION("no overlay") {
+    overlay_image img(builder);
+    REQUIRE_FALSE(GetOverlay(img.pe, o));
+    REQUIRE(o.data.length == 0);
+    REQUIRE(o.appended.length == 0);
+
+    section_entropy e;
+    REQUIRE_FALSE(GetOverlayEntropy(img.pe, entropy_options(), e));
+  }
+
+  SECTION("an unsigned overlay is a view of the end of the file") {
+    builder.setOverlay(overlay);
+    overlay_image img(builder);
+    REQUIRE(GetOverlay(img.pe, o));
+    REQUIRE(img.offsetOf(o.data) == base);
+    REQUIRE(o.data.length == overlay.size());
+    REQUIRE(o.appended.length == 0);
+  }
+
+  SECTION("the certificate table is left out") {
+    builder.setOverlay(overlay);
+    builder.setDataDirectory(
+        DIR_SECURITY, static_cast<std::uint32_t>(base + 0x108), 0x40);
+    overlay_image img(builder);
+    REQUIRE(GetOverlay(img.pe, o));
+    REQUIRE(img.offsetOf(o.data) == base);
+    REQUIRE(o.data.length == 0x108);
+    REQUIRE(o.appended.length == 0);
+
+    SECTION("and so is its entropy") {
+      section_entropy e;
+      REQUIRE(GetOverlayEntropy(img.pe, entropy_options(), e));
+      REQUIRE(e.name.empty());
+      REQUIRE(e.histogram[0x5A] == 0x105);
+      REQUIRE(e.histogram[0] == 3);
+      REQUIRE(e.histogram[0xEE] == 0);
+      REQUIRE(e.entropy > 0);
+      REQUIRE(e.entropy < 1);
+    }
+  }
+
+  SECTION("data appended after the certificate table") {
+    overlay.insert(overlay.end(), 0x30, 0x77);
+    builder.setOverlay(overlay);
+    builder.setDataDirectory(
+        DIR_SECURITY, static_cast<std::uint32_t>(base + 0x108), 0x40);
+    overlay_image img(builder);
+    REQUIRE(GetOverlay(img.pe, o));
+    REQUIRE(img.offsetOf(o.data) == base);
+    REQUIRE(o.data.length == 0x108);
+    REQUIRE(img.offsetOf(o.appended) == base + 0x148);
+    REQUIRE(o.appended.length == 0x30);
+
+    section_entropy e;
+    REQUIRE(GetOverlayEntropy(img.pe, entropy_options(), e));
+    REQUIRE(e.histogram[0x5A] == 0x105);
+    REQUIRE(e.histogram[0x77] == 0x30);
+    REQUIRE(e.histogram[0xEE] == 0);
+  }
+
+  SECTION("a signed file with nothing but the table past its sections") {
+    std::vector<std::uint8_t> table(0x40, 0xEE);
+    builder.setOverlay(table);
+    builder.setDataDirectory(
+        DIR_SECURITY, static_cast<std::uint32_t>(base), 0x40);
+    overlay_image img(builder);
+    REQUIRE_FALSE(GetOverlay(img.pe, o));
+
+    SECTION("until something is appended") {
+      table.insert(table.end(), 0x10, 0x77);
+      builder.setOverlay(table);
+      overlay_image appended(builder);
+      REQUIRE(GetOverlay(appended.pe, o));
+      REQUIRE(appended.offsetOf(o.data) == base + 0x40);
+      REQUIRE(o.data.length == 0x10);
+      REQUIRE(o.appended.length == 0);
+    }
+  }
+
+  SECTION("a table running past the end of the file") {
+    builder.setOverlay(overlay);
+    builder.setDataDirectory(
+        DIR_SECURITY, static_cast<std::uint32_t>(base + 0x108), 0x1000);
+    overlay_image img(builder);
+    REQUIRE(GetOverlay(img.pe, o));
+    REQUIRE(o.data.length == 0x108);
+    REQUIRE(o.appended.length == 0);
+  }
+
+  SECTION("profiles don't span the certificate table") {
+    overlay.assign(0x2000, 0);
+    overlay.resize(0x2000 + 0x40, 0xEE);
+    overlay.resize(0x2040 + 0x3000, 0x11);
+    builder.setOverlay(overlay);
+    builder.setDataDirectory(
+        DIR_SECURITY, static_cast<std::uint32_t>(base + 0x2000), 0x40);
+    overlay_image img(builder);
+
+    entropy_options opts;
+    opts.profileThreshold = 0x1000;
+    opts.windowSize = 0x1000;
+    opts.windowStep = 0x800;
+    section_entropy e;
+    REQUIRE(GetOverlayEntropy(img.pe, opts, e));
+    // three windows in front of the table and five behind it
+    REQUIRE(e.profile.size() == 8);
+    REQUIRE(e.histogram[0] == 0x2000);
+    REQUIRE(e.histogram[0x11] == 0x3000);
+    REQUIRE(e.entropy > 0.9);
+    REQUIRE(e.entropy < 1);
+  }
+
+  SECTION("without an image") {
+    pe_overlay o;
+    section_entropy e;
+    REQUIRE_FALSE(GetOverlay(nullptr, o));
+    REQUIRE(o.data.length == 0);
+    REQUIRE_FALSE(GetOverlayEntropy(nullptr, entropy_options(), e));
+  }
+}
+
+} // namespace peparse
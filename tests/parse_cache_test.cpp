@@ -0,0 +1,278 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+void requireSameSummary(const pe_summary &a, const pe_summary &b) {
+  REQUIRE(std::memcmp(&a.header.dos, &b.header.dos, sizeof(dos_header)) ==
+          0);
+  REQUIRE(std::memcmp(&a.header.nt, &b.header.nt, sizeof(nt_header_32)) ==
+          0);
+  REQUIRE(a.header.rich.isPresent == b.header.rich.isPresent);
+  REQUIRE(a.header.rich.Entries.size() == b.header.rich.Entries.size());
+
+  REQUIRE(a.sections.size() == b.sections.size());
+  for (std::size_t i = 0; i < a.sections.size(); i++) {
+    REQUIRE(a.sections[i].name == b.sections[i].name);
+    REQUIRE(a.sections[i].base == b.sections[i].base);
+    REQUIRE(std::memcmp(&a.sections[i].header,
+                        &b.sections[i].header,
+                        sizeof(image_section_header)) == 0);
+  }
+
+  REQUIRE(a.imports.size() == b.imports.size());
+  for (std::size_t i = 0; i < a.imports.size(); i++) {
+    REQUIRE(a.imports[i].addr == b.imports[i].addr);
+    REQUIRE(a.imports[i].moduleName == b.imports[i].moduleName);
+    REQUIRE(a.imports[i].symbolName == b.imports[i].symbolName);
+    REQUIRE(a.imports[i].ordinal == b.imports[i].ordinal);
+  }
+
+  REQUIRE(a.exports.size() == b.exports.size());
+  for (std::size_t i = 0; i < a.exports.size(); i++) {
+    REQUIRE(a.exports[i].addr == b.exports[i].addr);
+    REQUIRE(a.exports[i].ordinal == b.exports[i].ordinal);
+    REQUIRE(a.exports[i].symbolName == b.exports[i].symbolName);
+    REQUIRE(a.exports[i].forwardName == b.exports[i].forwardName);
+  }
+
+  REQUIRE(a.resources.size() == b.resources.size());
+  for (std::size_t i = 0; i < a.resources.size(); i++) {
+    REQUIRE(a.resources[i].type == b.resources[i].type);
+    REQUIRE(a.resources[i].name_str == b.resources[i].name_str);
+    REQUIRE(a.resources[i].RVA == b.resources[i].RVA);
+    REQUIRE(a.resources[i].size == b.resources[i].size);
+    REQUIRE(b.resources[i].buf == nullptr);
+  }
+}
+
+// a small DLL; seed varies the contents, but not the size of the summary
+std::vector<std::uint8_t> buildDll(std::uint8_t seed) {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, seed));
+  std::uint32_t edata = builder.nextSectionRva();
+  std::vector<std::uint8_t> exp = test::buildExportSection(
+      edata, "test.dll", {{1, "Alpha", 0x1000, ""}, {2, "Beta", 0x1010, ""}});
+  builder.addSection(".edata", exp);
+  builder.setDataDirectory(
+      DIR_EXPORT, edata, static_cast<std::uint32_t>(exp.size()));
+  return builder.build();
+}
+
+} // namespace
+
+TEST_CASE("Parse cache", "[cache]") {
+  fs::path dir = fs::temp_directory_path() / "pe-parse-cache-test";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const std::string dirName = dir.string();
+
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  parsed_pe *p = ParsePEFromFile(path.string().c_str());
+  REQUIRE(p);
+  pe_summary parsed;
+  REQUIRE(SummarizePE(p, parsed));
+  DestructParsedPE(p);
+  REQUIRE(parsed.sections.size() == 5);
+  REQUIRE(!parsed.imports.empty());
+
+  pe_summary s;
+
+  SECTION("without a cache every file is parsed") {
+    REQUIRE(GetPESummaryFromFile(nullptr, path.string().c_str(), s));
+    requireSameSummary(parsed, s);
+    REQUIRE(GetParseCacheStats(nullptr).misses == 0);
+  }
+
+  SECTION("repeat files are served from the cache") {
+    parse_cache *cache = OpenParseCache(dirName.c_str(), 1 << 20);
+    REQUIRE(cache);
+    REQUIRE(GetPESummaryFromFile(cache, path.string().c_str(), s));
+    requireSameSummary(parsed, s);
+    REQUIRE(GetPESummaryFromFile(cache, path.string().c_str(), s));
+    requireSameSummary(parsed, s);
+
+    parse_cache_stats stats = GetParseCacheStats(cache);
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.entries == 1);
+    REQUIRE(stats.bytes > 0);
+    CloseParseCache(cache);
+
+    SECTION("and across runs") {
+      cache = OpenParseCache(dirName.c_str(), 1 << 20);
+      REQUIRE(cache);
+      REQUIRE(GetParseCacheStats(cache).entries == 1);
+      REQUIRE(GetPESummaryFromFile(cache, path.string().c_str(), s));
+      requireSameSummary(parsed, s);
+      REQUIRE(GetParseCacheStats(cache).hits == 1);
+      CloseParseCache(cache);
+    }
+
+    SECTION("a damaged record is parsed again") {
+      for (const auto &entry : fs::directory_iterator(dir)) {
+        if (entry.path().extension() == ".sum") {
+          std::ofstream os(entry.path(), std::ios::binary | std::ios::trunc);
+          os << "junk";
+        }
+      }
+      cache = OpenParseCache(dirName.c_str(), 1 << 20);
+      REQUIRE(cache);
+      REQUIRE(GetPESummaryFromFile(cache, path.string().c_str(), s));
+      requireSameSummary(parsed, s);
+      REQUIRE(GetPESummaryFromFile(cache, path.string().c_str(), s));
+      stats = GetParseCacheStats(cache);
+      REQUIRE(stats.hits == 1);
+      REQUIRE(stats.misses == 1);
+      REQUIRE(stats.entries == 1);
+      CloseParseCache(cache);
+    }
+  }
+
+  SECTION("files that don't parse fail again from the cache") {
+    std::vector<std::uint8_t> junk(0x200, 0x41);
+    junk[0] = 'M';
+    junk[1] = 'Z';
+    REQUIRE_FALSE(ParsePEFromPointer(junk.data(), 0x200));
+    std::uint32_t error = GetPEErr();
+
+    parse_cache *cache = OpenParseCache(dirName.c_str(), 1 << 20);
+    REQUIRE(cache);
+    for (int i = 0; i < 2; i++) {
+      REQUIRE_FALSE(GetPESummary(cache, junk.data(), 0x200, s));
+      REQUIRE(GetPEErr() == error);
+    }
+    REQUIRE(GetParseCacheStats(cache).hits == 1);
+    CloseParseCache(cache);
+  }
+
+  SECTION("a record for a file with the same XXH64 is not used") {
+    std::vector<std::uint8_t> a = buildDll(1);
+    std::vector<std::uint8_t> b = buildDll(2);
+    REQUIRE(a.size() == b.size());
+
+    parse_cache *cache = OpenParseCache(dirName.c_str(), 1 << 20);
+    REQUIRE(cache);
+    REQUIRE(
+        GetPESummary(cache, a.data(), static_cast<std::uint32_t>(a.size()), s));
+    CloseParseCache(cache);
+
+    // pass a's record off as b's, as if the two collided: rename it, and
+    // patch the key in the record and the index
+    std::uint64_t keyA = Xxh64(a.data(), a.size());
+    std::uint64_t keyB = Xxh64(b.data(), b.size());
+    auto recordName = [](std::uint64_t key) {
+      char name[32];
+      std::snprintf(name,
+                    sizeof(name),
+                    "%08x%08x.sum",
+                    static_cast<unsigned>(key >> 32),
+                    static_cast<unsigned>(key));
+      return std::string(name);
+    };
+    auto patchKey = [keyA, keyB](const fs::path &file, std::size_t at) {
+      std::fstream f(file, std::ios::binary | std::ios::in | std::ios::out);
+      REQUIRE(f);
+      std::vector<char> key(8);
+      f.seekg(static_cast<std::streamoff>(at));
+      f.read(key.data(), 8);
+      for (std::size_t i = 0; i < 8; i++) {
+        REQUIRE(static_cast<std::uint8_t>(key[i]) ==
+                static_cast<std::uint8_t>(keyA >> (8 * i)));
+        key[i] = static_cast<char>(keyB >> (8 * i));
+      }
+      f.seekp(static_cast<std::streamoff>(at));
+      f.write(key.data(), 8);
+    };
+    fs::rename(dir / recordName(keyA), dir / recordName(keyB));
+    patchKey(dir / recordName(keyB), 12);
+    patchKey(dir / "index", 16);
+
+    cache = OpenParseCache(dirName.c_str(), 1 << 20);
+    REQUIRE(cache);
+    REQUIRE(GetParseCacheStats(cache).entries == 1);
+    REQUIRE(
+        GetPESummary(cache, b.data(), static_cast<std::uint32_t>(b.size()), s));
+    parse_cache_stats stats = GetParseCacheStats(cache);
+    REQUIRE(stats.hits == 0);
+    REQUIRE(stats.misses == 1);
+
+    // b's own record replaced the forged one
+    REQUIRE(
+        GetPESummary(cache, b.data(), static_cast<std::uint32_t>(b.size()), s));
+    REQUIRE(GetParseCacheStats(cache).hits == 1);
+    CloseParseCache(cache);
+  }
+
+  SECTION("the least recently used records are evicted") {
+    std::vector<std::vector<std::uint8_t>> images;
+    for (std::uint8_t seed = 1; seed <= 3; seed++) {
+      images.push_back(buildDll(seed));
+    }
+    auto summarize = [&s](parse_cache *cache, std::vector<std::uint8_t> &i) {
+      REQUIRE(GetPESummary(
+          cache, i.data(), static_cast<std::uint32_t>(i.size()), s));
+      REQUIRE(s.exports.size() == 2);
+    };
+
+    // room for two records
+    parse_cache *cache = OpenParseCache(dirName.c_str(), 1 << 20);
+    REQUIRE(cache);
+    summarize(cache, images[0]);
+    std::uint64_t record = GetParseCacheStats(cache).bytes;
+    CloseParseCache(cache);
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    cache = OpenParseCache(dirName.c_str(), record * 2 + record / 2);
+    REQUIRE(cache);
+    summarize(cache, images[0]);
+    summarize(cache, images[1]);
+    summarize(cache, images[0]);
+    summarize(cache, images[2]);
+
+    parse_cache_stats stats = GetParseCacheStats(cache);
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.evictions == 1);
+    REQUIRE(stats.entries == 2);
+    REQUIRE(stats.bytes == record * 2);
+
+    // images[1] was the one evicted
+    summarize(cache, images[0]);
+    summarize(cache, images[2]);
+    REQUIRE(GetParseCacheStats(cache).hits == 3);
+    summarize(cache, images[1]);
+    REQUIRE(GetParseCacheStats(cache).misses == 4);
+    CloseParseCache(cache);
+
+    SECTION("a smaller cap evicts on open") {
+      cache = OpenParseCache(dirName.c_str(), record);
+      REQUIRE(cache);
+      stats = GetParseCacheStats(cache);
+      REQUIRE(stats.entries == 1);
+      REQUIRE(stats.evictions == 1);
+      // the most recently used record is the one kept
+      summarize(cache, images[1]);
+      REQUIRE(GetParseCacheStats(cache).hits == 1);
+      CloseParseCache(cache);
+    }
+  }
+
+  fs::remove_all(dir);
+}
+
+} // namespace peparse
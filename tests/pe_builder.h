@@ -0,0 +1,350 @@
+// Builds small PE images in memory, for tests that need structures that
+// tests/assets/example.exe does not contain.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace peparse {
+namespace test {
+
+constexpr std::uint32_t kFileAlignment = 0x200;
+constexpr std::uint32_t kSectionAlignment = 0x1000;
+constexpr std::uint32_t kHeadersSize = 0x400;
+
+inline void put16(std::vector<std::uint8_t> &b,
+                  std::size_t off,
+                  std::uint16_t v) {
+  if (b.size() < off + 2) {
+    b.resize(off + 2);
+  }
+  b[off] = static_cast<std::uint8_t>(v);
+  b[off + 1] = static_cast<std::uint8_t>(v >> 8);
+}
+
+inline void put32(std::vector<std::uint8_t> &b,
+                  std::size_t off,
+                  std::uint32_t v) {
+  put16(b, off, static_cast<std::uint16_t>(v));
+  put16(b, off + 2, static_cast<std::uint16_t>(v >> 16));
+}
+
+inline void put64(std::vector<std::uint8_t> &b,
+                  std::size_t off,
+                  std::uint64_t v) {
+  put32(b, off, static_cast<std::uint32_t>(v));
+  put32(b, off + 4, static_cast<std::uint32_t>(v >> 32));
+}
+
+inline std::uint32_t alignUp(std::uint32_t v, std::uint32_t a) {
+  return (v + a - 1) & ~(a - 1);
+}
+
+class pe_builder {
+public:
+  explicit pe_builder(bool pe64 = true, std::uint16_t machine = 0x8664)
+      : pe64_(pe64),
+        machine_(machine),
+        imageBase_(pe64 ? 0x140000000 : 0x400000) {
+  }
+
+  // RVA the next section added will be placed at, so that its contents can
+  // refer to themselves
+  std::uint32_t nextSectionRva() const {
+    return nextRva_;
+  }
+
+  std::uint32_t addSection(const std::string &name,
+                           const std::vector<std::uint8_t> &data,
+                           std::uint32_t characteristics = 0x40000040) {
+    sec s;
+    s.name = name;
+    s.data = data;
+    s.rva = nextRva_;
+    s.characteristics = characteristics;
+    secs_.push_back(s);
+
+    std::uint32_t vsize =
+        data.empty() ? 1 : static_cast<std::uint32_t>(data.size());
+    nextRva_ = alignUp(nextRva_ + vsize, kSectionAlignment);
+    return s.rva;
+  }
+
+  void setDataDirectory(std::uint32_t index,
+                        std::uint32_t rva,
+                        std::uint32_t size) {
+    dirs_[index][0] = rva;
+    dirs_[index][1] = size;
+  }
+
+  void setEntryPoint(std::uint32_t rva) {
+    entryPoint_ = rva;
+  }
+
+  void setImageBase(std::uint64_t base) {
+    imageBase_ = base;
+  }
+
+  std::uint64_t imageBase() const {
+    return imageBase_;
+  }
+
+  // Points the file header at a COFF symbol table, e.g. one in the overlay
+  void setSymbolTable(std::uint32_t offset, std::uint32_t count) {
+    symbolTable_ = offset;
+    numSymbols_ = count;
+  }
+
+  void setOverlay(const std::vector<std::uint8_t> &data) {
+    overlay_ = data;
+  }
+
+  // File offset the overlay will start at
+  std::uint32_t overlayOffset() const {
+    std::uint32_t off = kHeadersSize;
+    for (const sec &s : secs_) {
+      off += alignUp(static_cast<std::uint32_t>(s.data.size()), kFileAlignment);
+    }
+    return off;
+  }
+
+  std::vector<std::uint8_t> build() const {
+    std::vector<std::uint8_t> b(kHeadersSize, 0);
+
+    // DOS header
+    put16(b, 0, 0x5a4d);
+    put32(b, 0x3c, 0x40);
+
+    // NT headers
+    const std::size_t nt = 0x40;
+    put32(b, nt, 0x00004550);
+
+    const std::size_t fh = nt + 4;
+    std::uint16_t optSize = pe64_ ? 0xF0 : 0xE0;
+    put16(b, fh + 0, machine_);
+    put16(b, fh + 2, static_cast<std::uint16_t>(secs_.size()));
+    put32(b, fh + 8, symbolTable_);
+    put32(b, fh + 12, numSymbols_);
+    put16(b, fh + 16, optSize);
+    put16(b, fh + 18, pe64_ ? 0x0022 : 0x0102);
+
+    const std::size_t oh = fh + 20;
+    put16(b, oh + 0, pe64_ ? 0x20B : 0x10B);
+    put32(b, oh + 16, entryPoint_);
+    std::size_t dd;
+    if (pe64_) {
+      put64(b, oh + 24, imageBase_);
+      dd = oh + 112;
+      put32(b, oh + 108, 16);
+    } else {
+      put32(b, oh + 28, static_cast<std::uint32_t>(imageBase_));
+      dd = oh + 96;
+      put32(b, oh + 92, 16);
+    }
+    put32(b, oh + 32, kSectionAlignment);
+    put32(b, oh + 36, kFileAlignment);
+    put16(b, oh + 40, 6);
+    put16(b, oh + 48, 6);
+    put32(b, oh + 56, nextRva_);
+    put32(b, oh + 60, kHeadersSize);
+    put16(b, oh + 68, 3);
+    for (std::uint32_t i = 0; i < 16; i++) {
+      put32(b, dd + i * 8, dirs_[i][0]);
+      put32(b, dd + i * 8 + 4, dirs_[i][1]);
+    }
+
+    // Section headers and contents
+    std::size_t sh = oh + optSize;
+    std::uint32_t rawOff = kHeadersSize;
+    for (const sec &s : secs_) {
+      std::uint32_t rawSize =
+          alignUp(static_cast<std::uint32_t>(s.data.size()), kFileAlignment);
+
+      for (std::size_t i = 0; i < s.name.size() && i < 8; i++) {
+        b[sh + i] = static_cast<std::uint8_t>(s.name[i]);
+      }
+      put32(b, sh + 8, static_cast<std::uint32_t>(s.data.size()));
+      put32(b, sh + 12, s.rva);
+      put32(b, sh + 16, rawSize);
+      put32(b, sh + 20, rawSize == 0 ? 0 : rawOff);
+      put32(b, sh + 36, s.characteristics);
+
+      b.resize(rawOff + rawSize, 0);
+      if (!s.data.empty()) {
+        std::memcpy(&b[rawOff], s.data.data(), s.data.size());
+      }
+
+      rawOff += rawSize;
+      sh += 40;
+    }
+
+    b.insert(b.end(), overlay_.begin(), overlay_.end());
+    return b;
+  }
+
+private:
+  struct sec {
+    std::string name;
+    std::vector<std::uint8_t> data;
+    std::uint32_t rva;
+    std::uint32_t characteristics;
+  };
+
+  bool pe64_;
+  std::uint16_t machine_;
+  std::uint64_t imageBase_;
+  std::uint32_t entryPoint_ = 0;
+  std::uint32_t symbolTable_ = 0;
+  std::uint32_t numSymbols_ = 0;
+  std::uint32_t nextRva_ = kSectionAlignment;
+  std::uint32_t dirs_[16][2] = {};
+  std::vector<sec> secs_;
+  std::vector<std::uint8_t> overlay_;
+};
+
+struct export_spec {
+  std::uint32_t ordinal;
+  std::string name; // empty for an ordinal-only export
+  std::uint32_t rva; // ignored for forwarders
+  std::string forward; // "DLL.Func" or "DLL.#ord" for forwarders
+};
+
+// Lays out an export directory at rva. The whole section is the export
+// directory, so forwarder strings fall inside it.
+inline std::vector<std::uint8_t>
+buildExportSection(std::uint32_t rva,
+                   const std::string &dllName,
+                   std::vector<export_spec> exports) {
+  std::uint32_t base = 0xFFFFFFFF;
+  std::uint32_t last = 0;
+  for (const export_spec &e : exports) {
+    base = std::min(base, e.ordinal);
+    last = std::max(last, e.ordinal);
+  }
+  std::uint32_t numFunctions = exports.empty() ? 0 : last - base + 1;
+
+  std::vector<const export_spec *> named;
+  for (const export_spec &e : exports) {
+    if (!e.name.empty()) {
+      named.push_back(&e);
+    }
+  }
+  std::sort(named.begin(),
+            named.end(),
+            [](const export_spec *a, const export_spec *b) {
+              return a->name < b->name;
+            });
+  auto numNames = static_cast<std::uint32_t>(named.size());
+
+  std::uint32_t eat = 40;
+  std::uint32_t namePtrs = eat + 4 * numFunctions;
+  std::uint32_t ordinals = namePtrs + 4 * numNames;
+  std::uint32_t strings = ordinals + 2 * numNames;
+
+  std::vector<std::uint8_t> b(strings, 0);
+  auto addString = [&](const std::string &str) {
+    auto off = static_cast<std::uint32_t>(b.size());
+    b.insert(b.end(), str.begin(), str.end());
+    b.push_back(0);
+    return rva + off;
+  };
+
+  put32(b, 12, addString(dllName));
+  put32(b, 16, base);
+  put32(b, 20, numFunctions);
+  put32(b, 24, numNames);
+  put32(b, 28, rva + eat);
+  put32(b, 32, rva + namePtrs);
+  put32(b, 36, rva + ordinals);
+
+  for (const export_spec &e : exports) {
+    std::uint32_t target = e.forward.empty() ? e.rva : addString(e.forward);
+    put32(b, eat + 4 * (e.ordinal - base), target);
+  }
+
+  for (std::uint32_t i = 0; i < numNames; i++) {
+    put32(b, namePtrs + 4 * i, addString(named[i]->name));
+    put16(b,
+          ordinals + 2 * i,
+          static_cast<std::uint16_t>(named[i]->ordinal - base));
+  }
+
+  return b;
+}
+
+struct import_spec {
+  std::string module;
+  std::vector<std::string> symbols; // "#<ordinal>" imports by ordinal
+};
+
+// Lays out an import directory at rva: the descriptors, then each
+// module's lookup table, IAT, name and hint/name entries. With delayLoad
+// the descriptors are RVA-based delay-load descriptors instead.
+inline std::vector<std::uint8_t>
+buildImportSection(std::uint32_t rva,
+                   bool pe64,
+                   const std::vector<import_spec> &modules,
+                   bool delayLoad = false) {
+  const std::uint32_t thunk = pe64 ? 8 : 4;
+  const std::uint32_t descSize = delayLoad ? 32 : 20;
+  std::vector<std::uint8_t> b(descSize * (modules.size() + 1), 0);
+
+  auto putThunk = [&](std::size_t off, std::uint64_t v) {
+    if (pe64) {
+      put64(b, off, v);
+    } else {
+      put32(b, off, static_cast<std::uint32_t>(v));
+    }
+  };
+
+  for (std::size_t m = 0; m < modules.size(); m++) {
+    const import_spec &spec = modules[m];
+    auto count = static_cast<std::uint32_t>(spec.symbols.size());
+
+    auto ilt = static_cast<std::uint32_t>(b.size());
+    std::uint32_t iat = ilt + thunk * (count + 1);
+    b.resize(iat + thunk * (count + 1), 0);
+
+    std::size_t desc = descSize * m;
+    auto name = rva + static_cast<std::uint32_t>(b.size());
+    if (delayLoad) {
+      put32(b, desc, 1);
+      put32(b, desc + 4, name);
+      put32(b, desc + 12, rva + iat);
+      put32(b, desc + 16, rva + ilt);
+    } else {
+      put32(b, desc, rva + ilt);
+      put32(b, desc + 12, name);
+      put32(b, desc + 16, rva + iat);
+    }
+    b.insert(b.end(), spec.module.begin(), spec.module.end());
+    b.push_back(0);
+
+    for (std::uint32_t i = 0; i < count; i++) {
+      const std::string &sym = spec.symbols[i];
+      std::uint64_t v;
+      if (!sym.empty() && sym[0] == '#') {
+        v = std::stoul(sym.substr(1)) |
+            (pe64 ? 0x8000000000000000 : 0x80000000);
+      } else {
+        b.resize(alignUp(static_cast<std::uint32_t>(b.size()), 2), 0);
+        v = rva + static_cast<std::uint32_t>(b.size());
+        b.push_back(0);
+        b.push_back(0);
+        b.insert(b.end(), sym.begin(), sym.end());
+        b.push_back(0);
+      }
+      putThunk(ilt + thunk * i, v);
+      putThunk(iat + thunk * i, v);
+    }
+  }
+
+  return b;
+}
+
+} // namespace test
+} // namespace peparse
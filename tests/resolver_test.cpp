@@ -0,0 +1,224 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <pe-parse/resolver.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+void writeDll(const fs::path &path,
+              const std::string &name,
+              const std::vector<test::export_spec> &exports) {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::uint32_t edata = builder.nextSectionRva();
+  std::vector<std::uint8_t> sec =
+      test::buildExportSection(edata, name, exports);
+  builder.addSection(".edata", sec);
+  builder.setDataDirectory(
+      DIR_EXPORT, edata, static_cast<std::uint32_t>(sec.size()));
+
+  std::vector<std::uint8_t> image = builder.build();
+  std::ofstream os(path, std::ios::binary);
+  os.write(reinterpret_cast<const char *>(image.data()),
+           static_cast<std::streamsize>(image.size()));
+}
+
+// A.DLL forwards into B.DLL and C.DLL; A and C forward to each other. Each
+// test case writes its own copy, as ctest may run them at the same time
+fs::path writeCorpus(const std::string &name) {
+  fs::path dir = fs::temp_directory_path() / name;
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  writeDll(dir / "A.DLL",
+           "A.DLL",
+           {
+               {1, "Own", 0x1010, ""},
+               {2, "ToB", 0, "B.Target"},
+               {3, "ToBOrdinal", 0, "b.#7"},
+               {4, "Loop", 0, "C.Loop"},
+               {5, "ToNowhere", 0, "NOPE.Func"},
+               {6, "ToMissing", 0, "B.Missing"},
+               {7, "TwoHops", 0, "C.ToB"},
+           });
+  writeDll(dir / "b.dll",
+           "b.dll",
+           {
+               {5, "Target", 0x1020, ""},
+               {7, "", 0x1030, ""},
+           });
+  writeDll(dir / "c.dll",
+           "c.dll",
+           {
+               {1, "Loop", 0, "a.Loop"},
+               {2, "ToB", 0, "B.Target"},
+           });
+  std::ofstream(dir / "notes.txt") << "not a dll";
+
+  return dir;
+}
+
+} // namespace
+
+TEST_CASE("Forwarder resolution", "[resolver]") {
+  fs::path dir = writeCorpus("pe-parse-resolver-forwarders");
+
+  export_db *db = CreateExportDb();
+  REQUIRE(db);
+  REQUIRE(ExportDbAddDirectory(db, dir.string().c_str()) == 3);
+
+  resolved_export r;
+
+  SECTION("non-forwarded exports") {
+    REQUIRE(ResolveExport(db, "a.dll", "Own", r));
+    REQUIRE(r.moduleName == "A.DLL");
+    REQUIRE(r.addr == 0x140001010);
+    REQUIRE(r.ordinal == 1);
+    REQUIRE(r.hops == 0);
+  }
+
+  SECTION("forwarders by name and ordinal") {
+    REQUIRE(ResolveForwarder(db, "A.ToB", r));
+    REQUIRE(r.moduleName == "b.dll");
+    REQUIRE(r.symbolName == "Target");
+    REQUIRE(r.addr == 0x140001020);
+    REQUIRE(r.hops == 1);
+
+    REQUIRE(ResolveExport(db, "A", "ToBOrdinal", r));
+    REQUIRE(r.ordinal == 7);
+    REQUIRE(r.symbolName.empty());
+
+    REQUIRE(ResolveExport(db, "A", "TwoHops", r));
+    REQUIRE(r.symbolName == "Target");
+    REQUIRE(r.hops == 2);
+  }
+
+  SECTION("failures") {
+    REQUIRE_FALSE(ResolveExport(db, "A", "Loop", r));
+    REQUIRE(r.status == resolve_status::loop);
+
+    REQUIRE_FALSE(ResolveExport(db, "A", "ToNowhere", r));
+    REQUIRE(r.status == resolve_status::missing_module);
+    REQUIRE(r.moduleName == "NOPE");
+
+    REQUIRE_FALSE(ResolveExport(db, "A", "ToMissing", r));
+    REQUIRE(r.status == resolve_status::missing_export);
+    REQUIRE(r.symbolName == "Missing");
+
+    REQUIRE_FALSE(ResolveForwarder(db, "NoDot", r));
+  }
+
+  SECTION("batch queries") {
+    std::vector<resolved_export> out;
+    REQUIRE(ResolveForwarders(db, {"A.ToB", "C.Loop", "B.#7", "A.ToB"}, out) ==
+            3);
+    REQUIRE(out.size() == 4);
+    REQUIRE(out[1].status == resolve_status::loop);
+    REQUIRE(out[2].addr == 0x140001030);
+    REQUIRE(out[3].addr == out[0].addr);
+  }
+
+  SECTION("saved indexes are reused until the file changes") {
+    REQUIRE(ResolveExport(db, "B", "Target", r));
+    fs::path saved = dir / "exports.db";
+    REQUIRE(SaveExportDb(db, saved.string().c_str()));
+
+    export_db *cached = CreateExportDb();
+    REQUIRE(LoadExportDb(cached, saved.string().c_str()));
+    REQUIRE(ResolveExport(cached, "b", "Target", r));
+    REQUIRE(r.addr == 0x140001020);
+
+    // Modules that were not saved are parsed from the directory
+    REQUIRE(ExportDbAddDirectory(cached, dir.string().c_str()) == 3);
+    REQUIRE(ResolveForwarder(cached, "A.ToB", r));
+
+    auto mtime = fs::last_write_time(dir / "b.dll");
+    writeDll(dir / "b.dll", "b.dll", {{5, "Renamed", 0x1020, ""}});
+    fs::last_write_time(dir / "b.dll", mtime + std::chrono::seconds(10));
+    export_db *stale = CreateExportDb();
+    REQUIRE(LoadExportDb(stale, saved.string().c_str()));
+    REQUIRE_FALSE(ResolveExport(stale, "b", "Target", r));
+    REQUIRE(ResolveExport(stale, "b", "Renamed", r));
+
+    DestroyExportDb(stale);
+    DestroyExportDb(cached);
+  }
+
+  SECTION("a failed save is told apart from a failed load") {
+    REQUIRE(ResolveExport(db, "B", "Target", r));
+    fs::path missing = dir / "missing" / "exports.db";
+    REQUIRE_FALSE(SaveExportDb(db, missing.string().c_str()));
+    REQUIRE(GetPEErr() == PEERR_OPEN);
+#if defined(__linux__)
+    REQUIRE_FALSE(SaveExportDb(db, "/dev/full"));
+    REQUIRE(GetPEErr() == PEERR_WRITE);
+#endif
+  }
+
+  DestroyExportDb(db);
+  fs::remove_all(dir);
+}
+
+TEST_CASE("Import binding", "[resolver]") {
+  fs::path dir = writeCorpus("pe-parse-resolver-imports");
+
+  export_db *db = CreateExportDb();
+  REQUIRE(db);
+  REQUIRE(ExportDbAddDirectory(db, dir.string().c_str()) == 3);
+
+  test::pe_builder builder;
+  std::uint32_t idata = builder.nextSectionRva();
+  std::vector<std::uint8_t> sec = test::buildImportSection(
+      idata,
+      true,
+      {
+          {"a.dll", {"Own", "ToB", "ToNowhere"}},
+          {"B.DLL", {"#7", "Target"}},
+          {"missing.dll", {"Func"}},
+      });
+  builder.addSection(".idata", sec);
+  builder.setDataDirectory(
+      DIR_IMPORT, idata, static_cast<std::uint32_t>(sec.size()));
+  std::vector<std::uint8_t> image = builder.build();
+
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<import_binding> out;
+  REQUIRE(ResolveImports(db, p, out) == 4);
+  REQUIRE(out.size() == 6);
+
+  REQUIRE(out[0].moduleName == "A.DLL");
+  REQUIRE(out[0].symbolName == "Own");
+  REQUIRE(out[0].target.addr == 0x140001010);
+
+  REQUIRE(out[1].target.moduleName == "b.dll");
+  REQUIRE(out[1].target.symbolName == "Target");
+
+  REQUIRE(out[2].target.status == resolve_status::missing_module);
+
+  REQUIRE(out[3].symbolName == "ORDINAL_B.DLL_7");
+  REQUIRE(out[3].target.addr == 0x140001030);
+  REQUIRE(out[4].target.addr == 0x140001020);
+  REQUIRE(out[4].iatAddr == out[3].iatAddr + 8);
+
+  REQUIRE(out[5].target.status == resolve_status::missing_module);
+  REQUIRE(out[5].target.moduleName == "MISSING.DLL");
+
+  DestructParsedPE(p);
+  DestroyExportDb(db);
+  fs::remove_all(dir);
+}
+
+} // namespace peparse
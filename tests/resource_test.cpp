@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "filesystem_compat.h"
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+struct rsrc_node {
+  std::uint32_t id;
+  std::u16string name;
+  std::vector<rsrc_node> children;
+  std::vector<std::uint8_t> data;
+};
+
+// Serializes a resource tree the way rc.exe lays it out: every directory
+// table first, then the name strings, then the data entries and data.
+class rsrc_writer {
+public:
+  explicit rsrc_writer(std::uint32_t rva) : rva_(rva) {
+  }
+
+  std::vector<std::uint8_t> write(const std::vector<rsrc_node> &root) {
+    table(root);
+
+    for (auto &p : strings_) {
+      test::put32(
+          out_, p.first, 0x80000000 | static_cast<std::uint32_t>(out_.size()));
+      std::size_t off = out_.size();
+      test::put16(out_, off, static_cast<std::uint16_t>(p.second.size()));
+      for (std::size_t i = 0; i < p.second.size(); i++) {
+        test::put16(out_, off + 2 + i * 2, p.second[i]);
+      }
+      out_.resize(test::alignUp(static_cast<std::uint32_t>(out_.size()), 4));
+    }
+
+    std::vector<std::size_t> entries;
+    for (auto &p : data_) {
+      test::put32(out_, p.first, static_cast<std::uint32_t>(out_.size()));
+      entries.push_back(out_.size());
+      out_.resize(out_.size() + 16);
+    }
+
+    for (std::size_t i = 0; i < data_.size(); i++) {
+      const std::vector<std::uint8_t> &d = data_[i].second->data;
+      test::put32(out_,
+                  entries[i],
+                  rva_ + static_cast<std::uint32_t>(out_.size()));
+      test::put32(out_, entries[i] + 4, static_cast<std::uint32_t>(d.size()));
+      out_.insert(out_.end(), d.begin(), d.end());
+      out_.resize(test::alignUp(static_cast<std::uint32_t>(out_.size()), 4));
+    }
+
+    return out_;
+  }
+
+private:
+  std::uint32_t table(const std::vector<rsrc_node> &nodes) {
+    // Named entries come before ID entries
+    std::vector<const rsrc_node *> sorted;
+    for (const rsrc_node &n : nodes) {
+      if (!n.name.empty()) {
+        sorted.push_back(&n);
+      }
+    }
+    std::uint16_t named = static_cast<std::uint16_t>(sorted.size());
+    for (const rsrc_node &n : nodes) {
+      if (n.name.empty()) {
+        sorted.push_back(&n);
+      }
+    }
+
+    auto at = static_cast<std::uint32_t>(out_.size());
+    out_.resize(at + 16 + 8 * sorted.size());
+    test::put16(out_, at + 12, named);
+    test::put16(out_,
+                at + 14,
+                static_cast<std::uint16_t>(sorted.size() - named));
+
+    for (std::size_t i = 0; i < sorted.size(); i++) {
+      std::size_t e = at + 16 + 8 * i;
+      if (!sorted[i]->name.empty()) {
+        strings_.emplace_back(e, sorted[i]->name);
+      } else {
+        test::put32(out_, e, sorted[i]->id);
+      }
+
+      if (!sorted[i]->children.empty()) {
+        std::uint32_t sub = table(sorted[i]->children);
+        test::put32(out_, e + 4, 0x80000000 | sub);
+      } else {
+        data_.emplace_back(e + 4, sorted[i]);
+      }
+    }
+
+    return at;
+  }
+
+  std::uint32_t rva_;
+  std::vector<std::uint8_t> out_;
+  std::vector<std::pair<std::size_t, std::u16string>> strings_;
+  std::vector<std::pair<std::size_t, const rsrc_node *>> data_;
+};
+
+int countRsrc(void *cbd, const resource &r) {
+  auto *names = static_cast<std::vector<std::string> *>(cbd);
+  names->push_back(r.type_str + "/" + r.name_str);
+  return 0;
+}
+
+} // namespace
+
+TEST_CASE("Resource lookup", "[resource]") {
+  std::vector<rsrc_node> root = {
+      {24, u"", {{1, u"", {{0x409, u"", {}, {'<', 'x', '/', '>'}}}, {}}}, {}},
+      {16,
+       u"",
+       {{1,
+         u"",
+         {{0x407, u"", {}, {'d', 'e'}}, {0x409, u"", {}, {'e', 'n'}}},
+         {}}},
+       {}},
+      {10,
+       u"",
+       {{0, u"CONFIG", {{0x409, u"", {}, {'c', 'f', 'g'}}}, {}},
+        {7, u"", {{0x409, u"", {}, {'7'}}}, {}}},
+       {}},
+      {0, u"TYPELIB", {{1, u"", {{0, u"", {}, {'t', 'l', 'b'}}}, {}}}, {}},
+      {0,
+       u"BLOBS",
+       {{0, u"FIRST", {{0x409, u"", {}, {'1'}}}, {}},
+        {2, u"", {{0x409, u"", {}, {'2'}}}, {}}},
+       {}},
+  };
+
+  test::pe_builder builder;
+  rsrc_writer writer(builder.nextSectionRva());
+  builder.addSection(".rsrc", writer.write(root));
+  std::vector<std::uint8_t> image = builder.build();
+
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  SECTION("lookup by ID") {
+    const resource *r = FindRsrc(p, RT_MANIFEST, 1, 0x409);
+    REQUIRE(r);
+    REQUIRE(r->size == 4);
+    REQUIRE(std::string(r->buf->buf, r->buf->buf + r->size) == "<x/>");
+
+    REQUIRE_FALSE(FindRsrc(p, RT_MANIFEST, 1, 0x407));
+    REQUIRE_FALSE(FindRsrc(p, RT_MANIFEST, 2));
+    REQUIRE_FALSE(FindRsrc(p, RT_ICON, 1));
+  }
+
+  SECTION("any language picks the lowest ID") {
+    const resource *r = FindRsrc(p, RT_VERSION, 1);
+    REQUIRE(r);
+    REQUIRE(r->lang == 0x407);
+
+    r = FindRsrc(p, RT_VERSION, 1, 0x409);
+    REQUIRE(r);
+    REQUIRE(std::string(r->buf->buf, r->buf->buf + r->size) == "en");
+  }
+
+  SECTION("lookup by name string") {
+    const resource *r = FindRsrc(p, RT_RCDATA, "CONFIG");
+    REQUIRE(r);
+    REQUIRE(r->name_str == "CONFIG");
+    REQUIRE(r->size == 3);
+
+    REQUIRE(FindRsrc(p, RT_RCDATA, 7));
+    REQUIRE_FALSE(FindRsrc(p, RT_RCDATA, "OTHER"));
+    REQUIRE_FALSE(FindRsrc(p, RT_RCDATA, "CONFIG", 0x407));
+  }
+
+  SECTION("lookup by type string") {
+    const resource *r = FindRsrc(p, "TYPELIB", 1);
+    REQUIRE(r);
+    REQUIRE(std::string(r->buf->buf, r->buf->buf + r->size) == "tlb");
+
+    r = FindRsrc(p, "BLOBS", "FIRST", 0x409);
+    REQUIRE(r);
+    REQUIRE(std::string(r->buf->buf, r->buf->buf + r->size) == "1");
+
+    r = FindRsrc(p, "BLOBS", 2);
+    REQUIRE(r);
+    REQUIRE(std::string(r->buf->buf, r->buf->buf + r->size) == "2");
+    REQUIRE(r->type_str == "BLOBS");
+
+    // the raw ID of a named entry is not an ID
+    REQUIRE_FALSE(FindRsrc(p, r->type, 2));
+
+    REQUIRE_FALSE(FindRsrc(p, "BLOBS", 1));
+    REQUIRE_FALSE(FindRsrc(p, "BLOBS", "SECOND"));
+    REQUIRE_FALSE(FindRsrc(p, "TYPELIB", "FIRST"));
+    REQUIRE_FALSE(FindRsrc(p, "RCDATA", 7));
+  }
+
+  SECTION("concurrent lookups decode names once") {
+    std::vector<std::thread> threads;
+    std::vector<int> hits(4, 0);
+    for (std::size_t t = 0; t < hits.size(); t++) {
+      threads.emplace_back([&, t] {
+        std::vector<std::string> names;
+        IterRsrc(p, countRsrc, &names);
+        if (std::find(names.begin(), names.end(), "BLOBS/FIRST") !=
+                names.end() &&
+            FindRsrc(p, RT_RCDATA, "CONFIG") != nullptr) {
+          hits[t]++;
+        }
+      });
+    }
+    for (std::thread &t : threads) {
+      t.join();
+    }
+
+    for (int h : hits) {
+      REQUIRE(h == 1);
+    }
+  }
+
+  SECTION("names are decoded for iteration") {
+    std::vector<std::string> names;
+    IterRsrc(p, countRsrc, &names);
+    REQUIRE(names.size() == 8);
+    REQUIRE(std::find(names.begin(), names.end(), "TYPELIB/") != names.end());
+    REQUIRE(std::find(names.begin(), names.end(), "/CONFIG") != names.end());
+  }
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Resource lookup without resources", "[resource]") {
+  fs::path path = fs::path(ASSETS_DIR) / "example.exe";
+  parsed_pe *p = ParsePEFromFile(path.string().c_str());
+  REQUIRE(p);
+
+  REQUIRE_FALSE(FindRsrc(p, RT_MANIFEST, 1));
+  REQUIRE_FALSE(FindRsrc(p, RT_RCDATA, "CONFIG"));
+  REQUIRE_FALSE(FindRsrc(p, "TYPELIB", 1));
+  REQUIRE_FALSE(FindRsrc(nullptr, RT_MANIFEST, 1));
+
+  DestructParsedPE(p);
+}
+
+} // namespace peparse
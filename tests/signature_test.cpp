@@ -0,0 +1,317 @@
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+// every offset of every pattern, one byte at a time; patterns are given as
+// (value, mask) pairs
+std::vector<signature_hit> referenceHits(
+    const std::vector<std::vector<std::pair<int, int>>> &patterns,
+    const std::vector<std::uint8_t> &data) {
+  std::vector<signature_hit> out;
+  for (std::size_t off = 0; off < data.size(); off++) {
+    for (std::size_t p = 0; p < patterns.size(); p++) {
+      const auto &pat = patterns[p];
+      if (off + pat.size() > data.size()) {
+        continue;
+      }
+      bool match = true;
+      for (std::size_t k = 0; k < pat.size() && match; k++) {
+        match = (data[off + k] & pat[k].second) == pat[k].first;
+      }
+      if (match) {
+        out.push_back({p, off});
+      }
+    }
+  }
+  return out;
+}
+
+std::vector<signature_hit> find(const signature_set *set,
+                                const std::vector<std::uint8_t> &data) {
+  std::vector<signature_hit> hits;
+  FindSignatures(set, data.data(), data.size(), hits);
+  return hits;
+}
+
+bool sameHits(const std::vector<signature_hit> &a,
+              const std::vector<signature_hit> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.size(); i++) {
+    if (a[i].pattern != b[i].pattern || a[i].offset != b[i].offset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("Compiling signatures", "[signature]") {
+  for (const char *bad : {"",
+                          "?? ??",
+                          "4? ?1",
+                          "E",
+                          "E8 0",
+                          "E 80",
+                          "G0",
+                          "E8-00"}) {
+    INFO("pattern: " << bad);
+    REQUIRE(CompileSignatures({"90", bad}) == nullptr);
+    REQUIRE(GetPEErr() == PEERR_PATTERN);
+  }
+
+  signature_set *set = CompileSignatures({});
+  REQUIRE(set != nullptr);
+  REQUIRE(find(set, {1, 2, 3}).empty());
+  DestructSignatureSet(set);
+}
+
+TEST_CASE("Finding signatures in a buffer", "[signature]") {
+  signature_set *set = CompileSignatures({
+      "60 E8 00 00 00 00 5D",  // 0
+      "E800000000",            // 1: a suffix of 0's anchor
+      "?? 00 5D",              // 2: leading wildcard
+      "5D ?? ?? 4? ?F",        // 3: nibble wildcards
+      "00 00",                 // 4: overlaps itself
+  });
+  REQUIRE(set != nullptr);
+
+  std::vector<std::uint8_t> data = {
+      0x60, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x5D, 0x11, 0x22, 0x43, 0x2F};
+  std::vector<signature_hit> hits = find(set, data);
+  // sorted by offset, then pattern
+  REQUIRE(sameHits(hits,
+                   {{0, 0},
+                    {1, 1},
+                    {4, 2},
+                    {4, 3},
+                    {2, 4},
+                    {4, 4},
+                    {3, 6}}));
+
+  // a match cut short by the end of the data
+  data.resize(9);
+  hits = find(set, data);
+  REQUIRE(hits.size() == 6);
+  REQUIRE(hits.back().pattern == 4);
+
+  DestructSignatureSet(set);
+}
+
+TEST_CASE("Signatures against a byte-at-a-time scan", "[signature]") {
+  // a small alphabet, so that patterns share prefixes and suffixes and
+  // occur often
+  std::uint32_t x = 99;
+  auto rand = [&x]() {
+    x = x * 1103515245 + 12345;
+    return x >> 16;
+  };
+
+  std::vector<std::uint8_t> data(20000);
+  for (std::uint8_t &b : data) {
+    b = static_cast<std::uint8_t>(0x40 | (rand() & 3));
+  }
+
+  std::vector<std::string> text;
+  std::vector<std::vector<std::pair<int, int>>> patterns;
+  static const char hex[] = "0123456789ABCDEF";
+  // enough of them that the deepest states are past the dense table
+  for (int i = 0; i < 500; i++) {
+    std::string t;
+    std::vector<std::pair<int, int>> p;
+    std::size_t len = 1 + rand() % 24;
+    std::size_t literal = rand() % len;
+    for (std::size_t k = 0; k < len; k++) {
+      int v = 0x40 | static_cast<int>(rand() & 3);
+      unsigned kind = k == literal ? 0 : rand() % 8;
+      if (kind == 6) {
+        t += "?? ";
+        p.push_back({0, 0});
+      } else if (kind == 7) {
+        t += hex[v >> 4];
+        t += "? ";
+        p.push_back({v & 0xF0, 0xF0});
+      } else {
+        t += hex[v >> 4];
+        t += hex[v & 0xF];
+        t += ' ';
+        p.push_back({v, 0xFF});
+      }
+    }
+    text.push_back(t);
+    patterns.push_back(p);
+  }
+
+  signature_set *set = CompileSignatures(text);
+  REQUIRE(set != nullptr);
+  std::vector<signature_hit> expected = referenceHits(patterns, data);
+  REQUIRE(!expected.empty());
+  REQUIRE(sameHits(find(set, data), expected));
+
+  SECTION("one set scanned by several threads at once") {
+    std::vector<std::vector<signature_hit>> results(4);
+    std::vector<std::thread> threads;
+    for (auto &r : results) {
+      threads.emplace_back([&r, set, &data]() {
+        FindSignatures(set, data.data(), data.size(), r);
+      });
+    }
+    for (std::thread &t : threads) {
+      t.join();
+    }
+    for (const auto &r : results) {
+      REQUIRE(sameHits(r, expected));
+    }
+  }
+
+  DestructSignatureSet(set);
+}
+
+TEST_CASE("Long buffers scanned in stretches", "[signature]") {
+  // signatures over the whole byte range, so the scan doesn't skip ahead at
+  // the root and splits a long buffer into stretches; copies of them are
+  // planted across the stretch boundaries
+  std::uint32_t x = 5;
+  auto rand = [&x]() {
+    x = x * 1103515245 + 12345;
+    return x >> 16;
+  };
+
+  std::vector<std::uint8_t> data(100003);
+  for (std::uint8_t &b : data) {
+    b = static_cast<std::uint8_t>(rand());
+  }
+
+  std::vector<std::string> text;
+  std::vector<std::vector<std::pair<int, int>>> patterns;
+  static const char hex[] = "0123456789ABCDEF";
+  for (int i = 0; i < 300; i++) {
+    std::string t;
+    std::vector<std::pair<int, int>> p;
+    std::size_t len = 2 + rand() % 12;
+    for (std::size_t k = 0; k < len; k++) {
+      int v = static_cast<int>(rand() & 0xFF);
+      if (k == 1 && i % 2 == 0) {
+        t += "?? ";
+        p.push_back({0, 0});
+      } else {
+        t += hex[v >> 4];
+        t += hex[v & 0xF];
+        t += ' ';
+        p.push_back({v, 0xFF});
+      }
+    }
+    text.push_back(t);
+    patterns.push_back(p);
+  }
+
+  signature_set *set = CompileSignatures(text);
+  REQUIRE(set != nullptr);
+
+  // a different length each time moves the boundaries, and a pattern
+  // planted just before each straddles it by a different amount
+  for (std::size_t trial = 0; trial < 6; trial++) {
+    std::vector<std::uint8_t> copy(
+        data.begin(), data.end() - static_cast<std::ptrdiff_t>(trial * 997));
+    for (std::size_t boundary = 1; boundary < 4; boundary++) {
+      const auto &p = patterns[rand() % patterns.size()];
+      std::size_t at = boundary * (copy.size() / 4) - 1 - trial * 2;
+      for (std::size_t k = 0; k < p.size(); k++) {
+        copy[at + k] = static_cast<std::uint8_t>(p[k].first);
+      }
+    }
+    INFO("trial " << trial);
+    REQUIRE(sameHits(find(set, copy), referenceHits(patterns, copy)));
+  }
+
+  DestructSignatureSet(set);
+}
+
+namespace {
+
+int collect(void *cbd, const signature_match &m) {
+  static_cast<std::vector<signature_match> *>(cbd)->push_back(m);
+  return 0;
+}
+
+} // namespace
+
+TEST_CASE("Signatures in sections and at the entry point", "[signature]") {
+  test::pe_builder builder;
+  std::vector<std::uint8_t> text(0x200, 0xCC);
+  const std::vector<std::uint8_t> stub = {
+      0x60, 0xBE, 0x00, 0x10, 0x40, 0x00, 0x8D, 0xBE};
+  std::copy(stub.begin(), stub.end(), text.begin() + 0x20);
+  std::copy(stub.begin(), stub.end(), text.begin() + 0x100);
+  std::uint32_t textRva = builder.addSection(".text", text);
+  std::vector<std::uint8_t> data(0x200, 0);
+  std::copy(stub.begin(), stub.end(), data.begin() + 0x40);
+  builder.addSection(".data", data);
+  builder.setEntryPoint(textRva + 0x100);
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  signature_set *set =
+      CompileSignatures({"60 BE ?? ?? ?? 00 8D BE", "CC CC CC 60"});
+  REQUIRE(set != nullptr);
+
+  std::vector<signature_match> matches;
+  IterSectionSignatures(p, set, {}, collect, &matches);
+  REQUIRE(matches.size() == 5);
+  REQUIRE(matches[0].pattern == 1);
+  REQUIRE(matches[1].pattern == 0);
+  REQUIRE(matches[1].sectionName == ".text");
+  REQUIRE(matches[1].va == builder.imageBase() + textRva + 0x20);
+  REQUIRE(matches[1].fileOffset == test::kHeadersSize + 0x20);
+  REQUIRE(matches[4].sectionName == ".data");
+  REQUIRE(matches[4].fileOffset == test::kHeadersSize + 0x240);
+
+  matches.clear();
+  IterSectionSignatures(p, set, {".data"}, collect, &matches);
+  REQUIRE(matches.size() == 1);
+  REQUIRE(matches[0].sectionName == ".data");
+
+  matches.clear();
+  IterEntryPointSignatures(p, set, 0x40, collect, &matches);
+  REQUIRE(matches.size() == 1);
+  REQUIRE(matches[0].pattern == 0);
+  REQUIRE(matches[0].va == builder.imageBase() + textRva + 0x100);
+  REQUIRE(matches[0].fileOffset == test::kHeadersSize + 0x100);
+
+  // the window stops at the end of the section's raw data
+  matches.clear();
+  IterEntryPointSignatures(p, set, 0x10000, collect, &matches);
+  REQUIRE(matches.size() == 1);
+
+  // a window too short for the whole signature
+  matches.clear();
+  IterEntryPointSignatures(p, set, 4, collect, &matches);
+  REQUIRE(matches.empty());
+
+  // no image
+  matches.clear();
+  IterSectionSignatures(nullptr, set, {}, collect, &matches);
+  IterEntryPointSignatures(nullptr, set, 0x40, collect, &matches);
+  REQUIRE(matches.empty());
+
+  DestructSignatureSet(set);
+  DestructParsedPE(p);
+}
+
+} // namespace peparse
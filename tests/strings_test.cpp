@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+// found by argument-dependent lookup, so outside the anonymous namespace
+inline bool operator==(const string_match &a, const string_match &b) {
+  return a.offset == b.offset && a.length == b.length &&
+         a.encoding == b.encoding;
+}
+
+namespace {
+
+bool printable(std::uint8_t c) {
+  return (c >= 0x20 && c <= 0x7E) || c == '\t';
+}
+
+// one character at a time
+std::vector<string_match> referenceStrings(const std::vector<std::uint8_t> &d,
+                                           std::size_t minLength) {
+  std::vector<string_match> out;
+  auto scan = [&](std::size_t from,
+                  std::size_t stride,
+                  std::uint32_t encoding,
+                  bool (*valid)(const std::vector<std::uint8_t> &,
+                                std::size_t)) {
+    std::size_t start = from;
+    std::size_t n = 0;
+    std::size_t i = from;
+    for (; i + stride <= d.size(); i += stride) {
+      if (valid(d, i)) {
+        if (n++ == 0) {
+          start = i;
+        }
+        continue;
+      }
+      if (n >= minLength) {
+        out.push_back({start, n, encoding});
+      }
+      n = 0;
+    }
+    if (n >= minLength) {
+      out.push_back({start, n, encoding});
+    }
+  };
+
+  scan(0, 1, STRING_ASCII, [](const std::vector<std::uint8_t> &b, size_t i) {
+    return printable(b[i]);
+  });
+  for (std::size_t phase : {0, 1}) {
+    scan(phase,
+         2,
+         STRING_UTF16LE,
+         [](const std::vector<std::uint8_t> &b, size_t i) {
+           return printable(b[i]) && b[i + 1] == 0;
+         });
+  }
+
+  std::sort(out.begin(),
+            out.end(),
+            [](const string_match &a, const string_match &b) {
+              return a.offset != b.offset ? a.offset < b.offset
+                                          : a.encoding < b.encoding;
+            });
+  return out;
+}
+
+void putAscii(std::vector<std::uint8_t> &b,
+              std::size_t off,
+              const std::string &s) {
+  std::memcpy(&b[off], s.data(), s.size());
+}
+
+void putWide(std::vector<std::uint8_t> &b,
+             std::size_t off,
+             const std::string &s) {
+  for (std::size_t i = 0; i < s.size(); i++) {
+    b[off + 2 * i] = static_cast<std::uint8_t>(s[i]);
+    b[off + 2 * i + 1] = 0;
+  }
+}
+
+} // namespace
+
+TEST_CASE("Finding strings in a buffer", "[strings]") {
+  // noise that is mostly neither printable nor zero, with strings of both
+  // encodings placed across chunk boundaries and at both UTF-16 parities
+  std::vector<std::uint8_t> data(3000);
+  std::uint32_t x = 7;
+  for (std::uint8_t &b : data) {
+    x = x * 1103515245 + 12345;
+    b = static_cast<std::uint8_t>(x >> 24);
+  }
+  putAscii(data, 0, "starts the buffer");
+  putAscii(data, 30, "crosses\tthe first chunk boundary");
+  putWide(data, 100, "even wide");
+  putWide(data, 161, "odd wide, over a boundary");
+  putAscii(data, 500, std::string(300, 'A'));
+  putWide(data, 900, std::string(100, 'w'));
+  putAscii(data, 2990, "end of it!");
+  data[17] = 0;
+  data[2989] = 0;
+
+  for (std::size_t minLength : {0, 1, 3, 4, 8, 64}) {
+    INFO("minimum length " << minLength);
+    std::vector<string_match> expected = referenceStrings(
+        data, std::max<std::size_t>(minLength, 1));
+    std::vector<string_match> found;
+    FindStrings(data.data(),
+                data.size(),
+                minLength,
+                STRING_ASCII | STRING_UTF16LE,
+                found);
+    REQUIRE(found.size() == expected.size());
+    REQUIRE(std::equal(found.begin(), found.end(), expected.begin()));
+  }
+
+  std::vector<string_match> found;
+  FindStrings(data.data(), data.size(), 8, STRING_UTF16LE, found);
+  REQUIRE(found.size() == 3);
+  REQUIRE(found[0] == string_match{100, 9, STRING_UTF16LE});
+  REQUIRE(found[1] == string_match{161, 25, STRING_UTF16LE});
+  REQUIRE(found[2] == string_match{900, 100, STRING_UTF16LE});
+
+  FindStrings(data.data(), data.size(), 8, STRING_ASCII, found);
+  REQUIRE(found.front() == string_match{0, 17, STRING_ASCII});
+  REQUIRE(found.back() == string_match{2990, 10, STRING_ASCII});
+
+  FindStrings(data.data(), 0, 4, STRING_ASCII, found);
+  REQUIRE(found.empty());
+}
+
+namespace {
+
+int collect(void *cbd, const string_entry &s) {
+  static_cast<std::vector<string_entry> *>(cbd)->push_back(s);
+  return 0;
+}
+
+int stopAtFirst(void *cbd, const string_entry &) {
+  (*static_cast<int *>(cbd))++;
+  return 1;
+}
+
+} // namespace
+
+TEST_CASE("Strings in sections and the overlay", "[strings]") {
+  test::pe_builder builder;
+  std::vector<std::uint8_t> text(0x200, 0xCC);
+  putAscii(text, 0x10, "in the code");
+  builder.addSection(".text", text);
+  std::vector<std::uint8_t> data(0x200, 0xFF);
+  putWide(data, 0x41, "Wide string");
+  builder.addSection(".data", data);
+  std::vector<std::uint8_t> overlay(0x40, 0);
+  putAscii(overlay, 0x8, "appended");
+  builder.setOverlay(overlay);
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<string_entry> strings;
+  IterStrings(p, 6, STRING_ASCII | STRING_UTF16LE, collect, &strings);
+  REQUIRE(strings.size() == 3);
+
+  REQUIRE(strings[0].value == "in the code");
+  REQUIRE(strings[0].encoding == STRING_ASCII);
+  REQUIRE(strings[0].sectionName == ".text");
+  REQUIRE(strings[0].rva == 0x1010);
+  REQUIRE(strings[0].va == builder.imageBase() + 0x1010);
+  REQUIRE(strings[0].fileOffset == test::kHeadersSize + 0x10);
+
+  REQUIRE(strings[1].value == "Wide string");
+  REQUIRE(strings[1].encoding == STRING_UTF16LE);
+  REQUIRE(strings[1].sectionName == ".data");
+  REQUIRE(strings[1].rva == 0x2041);
+  REQUIRE(strings[1].fileOffset == test::kHeadersSize + 0x241);
+
+  REQUIRE(strings[2].value == "appended");
+  REQUIRE(strings[2].sectionName.empty());
+  REQUIRE(strings[2].rva == 0);
+  REQUIRE(strings[2].va == 0);
+  REQUIRE(strings[2].fileOffset == builder.overlayOffset() + 0x8);
+
+  strings.clear();
+  IterStrings(p, 6, STRING_UTF16LE, collect, &strings);
+  REQUIRE(strings.size() == 1);
+  REQUIRE(strings[0].value == "Wide string");
+
+  int calls = 0;
+  IterStrings(p, 6, STRING_ASCII, stopAtFirst, &calls);
+  REQUIRE(calls == 1);
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Strings in an overlay with a certificate table", "[strings]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x200, 0xCC));
+  std::vector<std::uint8_t> overlay(0xA0, 0);
+  putAscii(overlay, 0x8, "appended");
+  putAscii(overlay, 0x48, "certificate");
+  putAscii(overlay, 0x88, "trailer");
+  builder.setOverlay(overlay);
+  builder.setDataDirectory(DIR_SECURITY, builder.overlayOffset() + 0x40, 0x40);
+
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  std::vector<string_entry> strings;
+  IterStrings(p, 6, STRING_ASCII, collect, &strings);
+  REQUIRE(strings.size() == 2);
+  REQUIRE(strings[0].value == "appended");
+  REQUIRE(strings[0].fileOffset == builder.overlayOffset() + 0x8);
+  REQUIRE(strings[1].value == "trailer");
+  REQUIRE(strings[1].fileOffset == builder.overlayOffset() + 0x88);
+
+  DestructParsedPE(p);
+
+  strings.clear();
+  IterStrings(nullptr, 6, STRING_ASCII, collect, &strings);
+  REQUIRE(strings.empty());
+}
+
+} // namespace peparse
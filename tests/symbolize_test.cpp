@@ -0,0 +1,191 @@
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+void putSymbol(std::vector<std::uint8_t> &b,
+               const std::string &name,
+               std::uint32_t value,
+               std::uint16_t section,
+               std::uint8_t storageClass,
+               std::uint8_t numAux = 0) {
+  std::size_t off = b.size();
+  b.resize(off + 18 * (1u + numAux), 0);
+  for (std::size_t i = 0; i < name.size() && i < 8; i++) {
+    b[off + i] = static_cast<std::uint8_t>(name[i]);
+  }
+  test::put32(b, off + 8, value);
+  test::put16(b, off + 12, section);
+  b[off + 16] = storageClass;
+  b[off + 17] = numAux;
+}
+
+// .text at 0x1000 with three .pdata functions, two exports, an entry point
+// and a COFF symbol table
+std::vector<std::uint8_t> buildImage() {
+  test::pe_builder builder;
+  std::uint32_t text =
+      builder.addSection(".text", std::vector<std::uint8_t>(0x400, 0xCC));
+
+  std::uint32_t edata = builder.nextSectionRva();
+  std::vector<std::uint8_t> exports = test::buildExportSection(
+      edata,
+      "sym.dll",
+      {{1, "Exported", text + 0x100, ""}, {2, "", text + 0x300, ""}});
+  builder.addSection(".edata", exports);
+  builder.setDataDirectory(
+      DIR_EXPORT, edata, static_cast<std::uint32_t>(exports.size()));
+
+  std::vector<std::uint8_t> pdata;
+  const std::uint32_t funcs[][2] = {
+      {0x1000, 0x1080}, {0x1100, 0x1180}, {0x1200, 0x1240}};
+  for (const auto &f : funcs) {
+    std::size_t off = pdata.size();
+    test::put32(pdata, off, f[0]);
+    test::put32(pdata, off + 4, f[1]);
+    test::put32(pdata, off + 8, 0);
+  }
+  std::uint32_t rva = builder.addSection(".pdata", pdata);
+  builder.setDataDirectory(
+      DIR_EXCEPTION, rva, static_cast<std::uint32_t>(pdata.size()));
+
+  builder.setEntryPoint(text + 0x200);
+
+  std::vector<std::uint8_t> symtab;
+  putSymbol(symtab, ".text", 0, 1, IMAGE_SYM_CLASS_STATIC, 1);
+  putSymbol(symtab, "helper", 0, 1, IMAGE_SYM_CLASS_EXTERNAL);
+  putSymbol(symtab, "lbl", 0x50, 1, IMAGE_SYM_CLASS_LABEL);
+  putSymbol(symtab, "absolute", 0x1234, 0xFFFF, IMAGE_SYM_CLASS_EXTERNAL);
+  // empty string table
+  test::put32(symtab, symtab.size(), 4);
+
+  builder.setSymbolTable(builder.overlayOffset(), 5);
+  builder.setOverlay(symtab);
+
+  return builder.build();
+}
+
+} // namespace
+
+TEST_CASE("Address symbolization", "[symbolize]") {
+  std::vector<std::uint8_t> image = buildImage();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  const VA base = 0x140000000;
+  VA offset = 0;
+
+  SECTION("nearest symbol and offset") {
+    const symbol_entry *s = Symbolize(p, base + 0x1010, offset);
+    REQUIRE(s);
+    REQUIRE(s->name == "helper");
+    REQUIRE(s->source == symbol_source::coff);
+    REQUIRE(s->size == 0x80);
+    REQUIRE(offset == 0x10);
+
+    s = Symbolize(p, base + 0x1060, offset);
+    REQUIRE(s);
+    REQUIRE(s->name == "lbl");
+    REQUIRE(offset == 0x10);
+
+    s = Symbolize(p, base + 0x117F, offset);
+    REQUIRE(s);
+    REQUIRE(s->name == "Exported");
+    REQUIRE(s->source == symbol_source::exports);
+    REQUIRE(offset == 0x7F);
+
+    s = Symbolize(p, base + 0x1210, offset);
+    REQUIRE(s);
+    REQUIRE(s->name == "EntryPoint");
+
+    s = Symbolize(p, base + 0x1300, offset);
+    REQUIRE(s);
+    REQUIRE(s->name == "#2");
+    REQUIRE(offset == 0);
+  }
+
+  SECTION("addresses outside of any symbol") {
+    REQUIRE_FALSE(Symbolize(p, base + 0xFFF, offset));
+    REQUIRE_FALSE(Symbolize(p, base + 0x1180, offset));
+    REQUIRE_FALSE(Symbolize(p, base + 0x1240, offset));
+
+    // absolute symbols are not addresses
+    const symbol_entry *s = Symbolize(p, base + 0x1234, offset);
+    REQUIRE(s);
+    REQUIRE(s->name == "EntryPoint");
+  }
+
+  SECTION("batch") {
+    std::vector<const symbol_entry *> out;
+    std::vector<VA> offsets;
+    REQUIRE(SymbolizeSorted(
+                p,
+                {base + 0x1000, base + 0x1001, base + 0x1190, base + 0x1300},
+                out,
+                offsets) == 3);
+    REQUIRE(out[0] == out[1]);
+    REQUIRE(offsets[1] == 1);
+    REQUIRE_FALSE(out[2]);
+    REQUIRE(out[3]->name == "#2");
+
+    REQUIRE(SymbolizeSorted(p, {base + 0x1300, base + 0x1005}, out, offsets) ==
+            2);
+    REQUIRE(out[1]->name == "helper");
+    REQUIRE(offsets[1] == 5);
+  }
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Concurrent symbolization", "[symbolize]") {
+  std::vector<std::uint8_t> image = buildImage();
+  parsed_pe *p = ParsePEFromPointer(image.data(),
+                                    static_cast<std::uint32_t>(image.size()));
+  REQUIRE(p);
+
+  // The index is built by whichever thread gets there first
+  std::vector<std::thread> threads;
+  std::vector<int> hits(4, 0);
+  for (std::size_t t = 0; t < hits.size(); t++) {
+    threads.emplace_back([&, t] {
+      VA offset;
+      for (VA va = 0x140001000; va < 0x140001400; va++) {
+        if (Symbolize(p, va, offset) != nullptr) {
+          hits[t]++;
+        }
+      }
+    });
+  }
+  for (std::thread &t : threads) {
+    t.join();
+  }
+
+  for (int h : hits) {
+    REQUIRE(h == hits[0]);
+  }
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("Symbolization without an image", "[symbolize]") {
+  VA offset;
+  std::vector<const symbol_entry *> out(1);
+  std::vector<VA> offsets(1);
+  REQUIRE_FALSE(Symbolize(nullptr, 0x140001000, offset));
+  REQUIRE(SymbolizeSorted(nullptr, {0x140001000}, out, offsets) == 0);
+  REQUIRE(out.empty());
+  REQUIRE(offsets.empty());
+}
+
+} // namespace peparse
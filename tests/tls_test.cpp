@@ -0,0 +1,154 @@
+#include <cstdint>
+#include <vector>
+
+#include <pe-parse/parse.h>
+
+#include <catch2/catch.hpp>
+
+#include "pe_builder.h"
+
+namespace peparse {
+
+namespace {
+
+parsed_pe *parse(const std::vector<std::uint8_t> &image) {
+  return ParsePEFromPointer(const_cast<std::uint8_t *>(image.data()),
+                            static_cast<std::uint32_t>(image.size()));
+}
+
+int collectVA(void *cbd, const VA &va) {
+  static_cast<std::vector<VA> *>(cbd)->push_back(va);
+  return 0;
+}
+
+int stopAfterFirst(void *cbd, const VA &va) {
+  static_cast<std::vector<VA> *>(cbd)->push_back(va);
+  return 1;
+}
+
+} // namespace
+
+TEST_CASE("PE32+ TLS callbacks", "[tls]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::uint32_t rva = builder.nextSectionRva();
+  VA base = builder.imageBase();
+  std::vector<std::uint8_t> rdata(0x100, 0);
+  test::put64(rdata, 0x00, base + rva + 0x80);
+  test::put64(rdata, 0x08, base + rva + 0x90);
+  test::put64(rdata, 0x10, base + rva + 0xA0);
+  test::put64(rdata, 0x18, base + rva + 0x40);
+  test::put32(rdata, 0x20, 0x10);
+  test::put64(rdata, 0x40, base + 0x1000);
+  test::put64(rdata, 0x48, base + 0x1010);
+  test::put64(rdata, 0x58, base + 0x1020); // after the terminator
+
+  builder.addSection(".rdata", rdata);
+  builder.setDataDirectory(DIR_TLS, rva, 0x28);
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  image_tls_directory_64 tls;
+  REQUIRE(GetTlsDirectory(p, tls));
+  REQUIRE(tls.StartAddressOfRawData == base + rva + 0x80);
+  REQUIRE(tls.AddressOfIndex == base + rva + 0xA0);
+  REQUIRE(tls.SizeOfZeroFill == 0x10);
+
+  std::vector<VA> callbacks;
+  IterTlsCallbacks(p, collectVA, &callbacks);
+  REQUIRE(callbacks == std::vector<VA>{base + 0x1000, base + 0x1010});
+
+  callbacks.clear();
+  IterTlsCallbacks(p, stopAfterFirst, &callbacks);
+  REQUIRE(callbacks.size() == 1);
+
+  DestructParsedPE(p);
+}
+
+TEST_CASE("PE32 TLS callbacks", "[tls]") {
+  test::pe_builder builder(false, 0x14c);
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+
+  std::uint32_t rva = builder.nextSectionRva();
+  auto base = static_cast<std::uint32_t>(builder.imageBase());
+
+  SECTION("terminated array") {
+    std::vector<std::uint8_t> rdata(0x100, 0);
+    test::put32(rdata, 0x0C, base + rva + 0x40);
+    test::put32(rdata, 0x40, base + 0x1004);
+    builder.addSection(".rdata", rdata);
+    builder.setDataDirectory(DIR_TLS, rva, 0x18);
+    std::vector<std::uint8_t> image = builder.build();
+    parsed_pe *p = parse(image);
+    REQUIRE(p);
+
+    image_tls_directory_64 tls;
+    REQUIRE(GetTlsDirectory(p, tls));
+    REQUIRE(tls.AddressOfCallBacks == base + rva + 0x40);
+
+    std::vector<VA> callbacks;
+    IterTlsCallbacks(p, collectVA, &callbacks);
+    REQUIRE(callbacks == std::vector<VA>{base + 0x1004});
+
+    DestructParsedPE(p);
+  }
+
+  SECTION("pathological arrays are capped") {
+    std::vector<std::uint8_t> rdata(0x10000 * 4, 0x41);
+    test::put32(rdata, 0x0C, base + rva + 0x40);
+    builder.addSection(".rdata", rdata);
+    builder.setDataDirectory(DIR_TLS, rva, 0x18);
+    std::vector<std::uint8_t> image = builder.build();
+    parsed_pe *p = parse(image);
+    REQUIRE(p);
+
+    std::vector<VA> callbacks;
+    IterTlsCallbacks(p, collectVA, &callbacks);
+    REQUIRE(callbacks.size() == TLS_MAX_CALLBACKS);
+
+    DestructParsedPE(p);
+  }
+
+  SECTION("unterminated array at the end of its section") {
+    std::vector<std::uint8_t> rdata(0x200, 0);
+    test::put32(rdata, 0x0C, base + rva + 0x1F8);
+    test::put32(rdata, 0x1F8, base + 0x1000);
+    test::put32(rdata, 0x1FC, base + 0x1008);
+    builder.addSection(".rdata", rdata);
+    builder.setDataDirectory(DIR_TLS, rva, 0x18);
+    std::vector<std::uint8_t> image = builder.build();
+    parsed_pe *p = parse(image);
+    REQUIRE(p);
+
+    std::vector<VA> callbacks;
+    IterTlsCallbacks(p, collectVA, &callbacks);
+    REQUIRE(callbacks.size() == 2);
+
+    DestructParsedPE(p);
+  }
+}
+
+TEST_CASE("Images without TLS", "[tls]") {
+  test::pe_builder builder;
+  builder.addSection(".text", std::vector<std::uint8_t>(0x100, 0xCC));
+  std::vector<std::uint8_t> image = builder.build();
+  parsed_pe *p = parse(image);
+  REQUIRE(p);
+
+  image_tls_directory_64 tls;
+  REQUIRE_FALSE(GetTlsDirectory(p, tls));
+
+  std::vector<VA> callbacks;
+  IterTlsCallbacks(p, collectVA, &callbacks);
+  REQUIRE(callbacks.empty());
+
+  DestructParsedPE(p);
+
+  REQUIRE_FALSE(GetTlsDirectory(nullptr, tls));
+  IterTlsCallbacks(nullptr, collectVA, &callbacks);
+  REQUIRE(callbacks.empty());
+}
+
+} // namespace peparse
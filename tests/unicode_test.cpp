@@ -0,0 +1,52 @@
+#include <string>
+
+#include <pe-parse/to_string.h>
+
+#include <catch2/catch.hpp>
+
+namespace peparse {
+
+TEST_CASE("UTF-16 to UTF-8 conversion", "[unicode]") {
+  SECTION("empty and ASCII strings") {
+    REQUIRE(from_utf16(UCharString()).empty());
+    REQUIRE(from_utf16(UCharString{'R', 'T'}) == "RT");
+
+    // Long enough to cover the vectorized ASCII path and its tail
+    std::string ascii = "VS_VERSION_INFO_and_some_more_text";
+    UCharString wide(ascii.begin(), ascii.end());
+    REQUIRE(from_utf16(wide) == ascii);
+  }
+
+  SECTION("multi-byte sequences") {
+    // U+00E9, U+4E2D, U+20AC
+    REQUIRE(from_utf16(UCharString{0x00E9}) == "\xC3\xA9");
+    REQUIRE(from_utf16(UCharString{0x4E2D}) == "\xE4\xB8\xAD");
+    REQUIRE(from_utf16(UCharString{'a', 0x20AC, 'b'}) == "a\xE2\x82\xAC"
+                                                         "b");
+
+    // Non-ASCII code unit right after a block of eight ASCII ones
+    UCharString mixed{'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 0x00E9, 'i'};
+    REQUIRE(from_utf16(mixed) == "abcdefgh\xC3\xA9i");
+  }
+
+  SECTION("surrogate pairs") {
+    // U+1F600
+    REQUIRE(from_utf16(UCharString{0xD83D, 0xDE00}) == "\xF0\x9F\x98\x80");
+    REQUIRE(from_utf16(UCharString{'x', 0xD800, 0xDC00, 'y'}) ==
+            "x\xF0\x90\x80\x80y");
+  }
+
+  SECTION("unpaired surrogates convert to an empty string") {
+    REQUIRE(from_utf16(UCharString{0xD83D}).empty());
+    REQUIRE(from_utf16(UCharString{0xDE00, 'a'}).empty());
+    REQUIRE(from_utf16(UCharString{'a', 0xD83D, 'b'}).empty());
+  }
+
+  SECTION("embedded NULs are preserved") {
+    std::string out = from_utf16(UCharString{'a', 0, 'b'});
+    REQUIRE(out.size() == 3);
+    REQUIRE(out == std::string("a\0b", 3));
+  }
+}
+
+} // namespace peparse